@@ -12,6 +12,7 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include <zephyr.h>
 
 #include "deca_types.h"
@@ -19,6 +20,14 @@
 #include "deca_regs.h"
 #include "deca_device_api.h"
 
+#ifdef DECA_SPI_TRACE
+#include "deca_spi.h"
+// Tags the SPI transactions done until the end of the enclosing function with the function name (see deca_spi.h)
+#define DWT_TRACE_FN() const char *_dwt_trace_prev __attribute__((cleanup(deca_spi_trace_exit))) = deca_spi_trace_enter(__func__)
+#else
+#define DWT_TRACE_FN()
+#endif
+
 // Defines for enable_clocks function
 #define FORCE_SYS_XTI  0
 #define ENABLE_ALL_SEQ 1
@@ -55,12 +64,45 @@ uint32 _dwt_otpread(uint16 address);
 uint32 _dwt_otpprogword32(uint32 data, uint16 address);
 // Upload the device configuration into always on memory
 void _dwt_aonarrayupload(void);
+// Compose the SPI header for a register access
+static int _dwt_buildheader(uint16 recordNumber, uint16 index, uint8 rw, uint8 *header);
+// Queue a register access in the open batch
+static void _dwt_batchqueue(uint16 recordNumber, uint16 index, uint32 length, uint8 *buffer, uint8 read);
+// Issue the register accesses queued in the open batch
+static int _dwt_batchflush(void);
+// Serve a register read from the shadow register cache
+static int _dwt_cacheread(uint16 recordNumber, uint16 index, uint32 length, uint8 *buffer);
+// Update the shadow register cache with a register write
+static void _dwt_cachewrite(uint16 recordNumber, uint16 index, uint32 length, const uint8 *buffer);
 // -------------------------------------------------------------------------------------------------------------------
 
 /*!
  * Static data for DW1000 DecaWave Transceiver control
  */
 
+// -------------------------------------------------------------------------------------------------------------------
+// Shadow register cache
+// The configuration registers below are only ever modified by this driver, so their content is kept in the local data
+// and the read of a read-modify-write sequence does not need an SPI access. The cache is write-through: all the writes
+// still go to the device. It is invalidated by dwt_initialise(), dwt_softreset() and around sleep (see dwt_invalidatecache()).
+#define DWT_REG_CACHE_NUM   (5)         // Number of cached registers
+#define DWT_REG_CACHE_LEN   (4)         // Size of a cached register
+
+typedef struct
+{
+    uint8       regFileID ;         // ID of the register file
+    uint8       offset ;            // Index of the register in the register file
+} dwt_reg_cache_desc_t ;
+
+static const dwt_reg_cache_desc_t reg_cache_desc[DWT_REG_CACHE_NUM] =
+{
+    { SYS_CFG_ID,   0x00 },
+    { SYS_MASK_ID,  0x00 },
+    { GPIO_CTRL_ID, GPIO_MODE_OFFSET },
+    { PMSC_ID,      PMSC_CTRL0_OFFSET },
+    { PMSC_ID,      PMSC_CTRL1_OFFSET }
+};
+
 // -------------------------------------------------------------------------------------------------------------------
 // Structure to hold device data
 typedef struct
@@ -75,9 +117,20 @@ typedef struct
     uint32      sysCFGreg ;         // Local copy of system config register
     uint8       dblbuffon;          // Double RX buffer mode flag
     uint8       wait4resp ;         // wait4response was set with last TX start command
+    uint8       rxArmed ;           // Receiver enabled (dwt_rxenable() or wait4resp) and no RX event handled since
+    uint8       txPending ;         // Transmission started and its TXFRS not handled yet
     uint16      sleep_mode;         // Used for automatic reloading of LDO tune and microcode at wake-up
     uint16      otp_mask ;          // Local copy of the OTP mask used in dwt_initialise call
+    uint8       asyncAccRead ;      // Pending asynchronous read is an accumulator read (clocks to revert on completion)
+    uint8       regCache[DWT_REG_CACHE_NUM][DWT_REG_CACHE_LEN] ; // Shadow copies of the registers listed in reg_cache_desc
+    uint8       regCacheValid ;     // Bit n set when regCache[n] holds the register content
+    uint32      regCacheHits ;      // Number of register reads served from regCache
+    uint32      regCacheMisses ;    // Number of reads of cached registers that needed an SPI access
+    uint8       txLateCause ;       // Cause of the last failed delayed transmission, DWT_TXLATE_xxx
+    uint32      txLateCount[DWT_TXLATE_NUM] ; // Failed delayed transmissions, per cause
     dwt_cb_data_t cbData;           // Callback data structure
+    uint8      *cbRxBuffer;         // Buffer the ISR reads the received frame into, if any
+    uint16      cbRxBufferLen;      // Size of cbRxBuffer
     dwt_cb_t    cbTxDone;           // Callback for TX confirmation event
     dwt_cb_t    cbRxOk;             // Callback for RX good frame event
     dwt_cb_t    cbRxTo;             // Callback for RX timeout events
@@ -87,6 +140,28 @@ typedef struct
 static dwt_local_data_t dw1000local[DWT_NUM_DW_DEV] ; // Static local device data, can be an array to support multiple DW1000 testing applications/platforms
 static dwt_local_data_t *pdw1000local = dw1000local ; // Static local data structure pointer
 
+// -------------------------------------------------------------------------------------------------------------------
+// Batched register accesses (see dwt_batchbegin())
+#ifndef DWT_BATCH_MAX_XFER
+#define DWT_BATCH_MAX_XFER  (24)        // Max number of register accesses queued before the batch is issued
+#endif
+#ifndef DWT_BATCH_DATA_SIZE
+#define DWT_BATCH_DATA_SIZE (96)        // Size of the area holding the copies of the queued write data
+#endif
+
+typedef struct
+{
+    deca_spi_xfer_t xfer[DWT_BATCH_MAX_XFER] ;  // Queued register accesses
+    uint8       header[DWT_BATCH_MAX_XFER][3] ; // SPI headers of the queued register accesses
+    uint8       data[DWT_BATCH_DATA_SIZE] ;     // Copies of the queued write data (the caller's buffer may be on the stack)
+    uint16      count ;                         // Number of queued register accesses
+    uint16      datalen ;                       // Number of bytes used in data[]
+    uint8       depth ;                         // Nesting level of dwt_batchbegin() calls, 0 when no batch is open
+    decaIrqStatus_t stat ;                      // IRQ state saved by decamutexon() in the outermost dwt_batchbegin()
+} dwt_batch_t ;
+
+static dwt_batch_t dw1000batch ; // Register accesses queued between dwt_batchbegin() and dwt_batchcommit()
+
 
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_apiversion()
@@ -178,17 +253,30 @@ LOG_MODULE_REGISTER(deca_device);
 
 int dwt_initialise(int config)
 {
+    DWT_TRACE_FN();
+
     uint16 otp_xtaltrim_and_rev = 0;
     uint32 ldo_tune = 0;
 
     pdw1000local->dblbuffon = 0; // - set to 0 - meaning double buffer mode is off by default
     pdw1000local->wait4resp = 0; // - set to 0 - meaning wait for response not active
+    pdw1000local->rxArmed = 0;
+    pdw1000local->txPending = 0;
     pdw1000local->sleep_mode = 0; // - set to 0 - meaning sleep mode has not been configured
+    pdw1000local->asyncAccRead = 0; // - set to 0 - meaning no asynchronous accumulator read is pending
+    pdw1000local->regCacheValid = 0; // - set to 0 - meaning the register content is not known yet
+    pdw1000local->regCacheHits = 0;
+    pdw1000local->regCacheMisses = 0;
+    pdw1000local->txLateCause = DWT_TXLATE_NONE;
+    memset(pdw1000local->txLateCount, 0, sizeof(pdw1000local->txLateCount));
 
     pdw1000local->cbTxDone = NULL;
     pdw1000local->cbRxOk = NULL;
     pdw1000local->cbRxTo = NULL;
     pdw1000local->cbRxErr = NULL;
+    pdw1000local->cbRxBuffer = NULL;
+    pdw1000local->cbRxBufferLen = 0;
+    pdw1000local->cbData.rx_data = NULL;
 
 #if DWT_API_ERROR_CHECK
     pdw1000local->otp_mask = config ; // Save the READ_OTP config mask
@@ -366,6 +454,8 @@ uint8 dwt_otprevision(void)
  */
 void dwt_setfinegraintxseq(int enable)
 {
+    DWT_TRACE_FN();
+
     if (enable)
     {
         dwt_write16bitoffsetreg(PMSC_ID, PMSC_TXFINESEQ_OFFSET, PMSC_TXFINESEQ_ENABLE);
@@ -394,6 +484,8 @@ void dwt_setfinegraintxseq(int enable)
  */
 void dwt_setlnapamode(int lna_pa)
 {
+    DWT_TRACE_FN();
+
     uint32 gpio_mode = dwt_read32bitoffsetreg(GPIO_CTRL_ID, GPIO_MODE_OFFSET);
     gpio_mode &= ~(GPIO_MSGP4_MASK | GPIO_MSGP5_MASK | GPIO_MSGP6_MASK);
     if (lna_pa & DWT_LNA_ENABLE)
@@ -420,6 +512,8 @@ void dwt_setlnapamode(int lna_pa)
  */
 void dwt_enablegpioclocks(void)
 {
+    DWT_TRACE_FN();
+
     uint32 pmsc_clock_ctrl = dwt_read32bitreg(PMSC_ID);
     dwt_write32bitreg(PMSC_ID, pmsc_clock_ctrl | PMSC_CTRL0_GPCE | PMSC_CTRL0_GPRN) ;
 }
@@ -439,6 +533,8 @@ void dwt_enablegpioclocks(void)
  */
 void dwt_setgpiodirection(uint32 gpioNum, uint32 direction)
 {
+    DWT_TRACE_FN();
+
     uint8 buf[GPIO_DIR_LEN];
     uint32 command = direction | gpioNum;
 
@@ -464,6 +560,8 @@ void dwt_setgpiodirection(uint32 gpioNum, uint32 direction)
  */
 void dwt_setgpiovalue(uint32 gpioNum, uint32 value)
 {
+    DWT_TRACE_FN();
+
     uint8 buf[GPIO_DOUT_LEN];
     uint32 command = value | gpioNum;
 
@@ -489,6 +587,8 @@ void dwt_setgpiovalue(uint32 gpioNum, uint32 value)
  */
 int dwt_getgpiovalue(uint32 gpioNum)
 {
+    DWT_TRACE_FN();
+
     return ((dwt_read32bitoffsetreg(GPIO_CTRL_ID, GPIO_RAW_OFFSET) & gpioNum)? 1 : 0);
 }
 
@@ -592,6 +692,8 @@ uint32 dwt_getlotid(void)
  */
 uint32 dwt_readdevid(void)
 {
+    DWT_TRACE_FN();
+
     return dwt_read32bitoffsetreg(DEV_ID_ID,0);
 }
 
@@ -611,6 +713,8 @@ uint32 dwt_readdevid(void)
  */
 void dwt_configuretxrf(dwt_txconfig_t *config)
 {
+    DWT_TRACE_FN();
+
 
     // Configure RF TX PG_DELAY
     dwt_write8bitoffsetreg(TX_CAL_ID, TC_PGDELAY_OFFSET, config->PGdly);
@@ -637,6 +741,8 @@ void dwt_configuretxrf(dwt_txconfig_t *config)
  */
 void dwt_configurefor64plen(int prf)
 {
+    DWT_TRACE_FN();
+
     dwt_write8bitoffsetreg(CRTR_ID, CRTR_GEAR_OFFSET, DEMOD_GEAR_64L);
 
     if(prf == DWT_PRF_16M)
@@ -667,6 +773,8 @@ void dwt_configurefor64plen(int prf)
  */
 void dwt_configure(dwt_config_t *config)
 {
+    DWT_TRACE_FN();
+
     uint8 nsSfd_result  = 0;
     uint8 useDWnsSFD = 0;
     uint8 chan = config->chan ;
@@ -689,6 +797,9 @@ void dwt_configure(dwt_config_t *config)
     assert((config->phrMode == DWT_PHRMODE_STD) || (config->phrMode == DWT_PHRMODE_EXT));
 #endif
 
+    // All the register writes below are issued as a single batch
+    dwt_batchbegin();
+
     // For 110 kbps we need a special setup
     if(DWT_BR_110K == config->dataRate)
     {
@@ -790,6 +901,8 @@ void dwt_configure(dwt_config_t *config)
     // after its configuration or reconfiguration.
     // This issue is not documented at the time of writing this code. It should be in next release of DW1000 User Manual (v2.09, from July 2016).
     dwt_write8bitoffsetreg(SYS_CTRL_ID, SYS_CTRL_OFFSET, SYS_CTRL_TXSTRT | SYS_CTRL_TRXOFF); // Request TX start and TRX off at the same time
+
+    dwt_batchcommit();
 } // end dwt_configure()
 
 /*! ------------------------------------------------------------------------------------------------------------------
@@ -807,6 +920,8 @@ void dwt_configure(dwt_config_t *config)
  */
 void dwt_setrxantennadelay(uint16 rxDelay)
 {
+    DWT_TRACE_FN();
+
     // Set the RX antenna delay for auto TX timestamp adjustment
     dwt_write16bitoffsetreg(LDE_IF_ID, LDE_RXANTD_OFFSET, rxDelay);
 }
@@ -826,6 +941,8 @@ void dwt_setrxantennadelay(uint16 rxDelay)
  */
 void dwt_settxantennadelay(uint16 txDelay)
 {
+    DWT_TRACE_FN();
+
     // Set the TX antenna delay for auto TX timestamp adjustment
     dwt_write16bitoffsetreg(TX_ANTD_ID, TX_ANTD_OFFSET, txDelay);
 }
@@ -852,6 +969,8 @@ void dwt_settxantennadelay(uint16 txDelay)
  */
 int dwt_writetxdata(uint16 txFrameLength, uint8 *txFrameBytes, uint16 txBufferOffset)
 {
+    DWT_TRACE_FN();
+
 #ifdef DWT_API_ERROR_CHECK
     assert(txFrameLength >= 2);
     assert((pdw1000local->longFrames && (txFrameLength <= 1023)) || (txFrameLength <= 127));
@@ -889,6 +1008,8 @@ int dwt_writetxdata(uint16 txFrameLength, uint8 *txFrameBytes, uint16 txBufferOf
  */
 void dwt_writetxfctrl(uint16 txFrameLength, uint16 txBufferOffset, int ranging)
 {
+    DWT_TRACE_FN();
+
 
 #ifdef DWT_API_ERROR_CHECK
     assert((pdw1000local->longFrames && (txFrameLength <= 1023)) || (txFrameLength <= 127));
@@ -919,6 +1040,8 @@ void dwt_writetxfctrl(uint16 txFrameLength, uint16 txBufferOffset, int ranging)
  */
 void dwt_readrxdata(uint8 *buffer, uint16 length, uint16 rxBufferOffset)
 {
+    DWT_TRACE_FN();
+
     dwt_readfromdevice(RX_BUFFER_ID,rxBufferOffset,length,buffer) ;
 }
 
@@ -941,6 +1064,8 @@ void dwt_readrxdata(uint8 *buffer, uint16 length, uint16 rxBufferOffset)
  */
 void dwt_readaccdata(uint8 *buffer, uint16 len, uint16 accOffset)
 {
+    DWT_TRACE_FN();
+
     // Force on the ACC clocks if we are sequenced
     _dwt_enableclocks(READ_ACC_ON);
 
@@ -949,6 +1074,116 @@ void dwt_readaccdata(uint8 *buffer, uint16 len, uint16 accOffset)
     _dwt_enableclocks(READ_ACC_OFF); // Revert clocks back
 }
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_readrxdata_async()
+ *
+ * @brief This is the non-blocking version of dwt_readrxdata(), see dwt_asyncdone() and dwt_asyncwait()
+ *
+ * input parameters
+ * @param buffer - the buffer into which the data will be read, it must stay valid until the transfer completes
+ * @param length - the length of data to read (in bytes)
+ * @param rxBufferOffset - the offset in the rx buffer from which to read the data
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS if the transfer was started, or DWT_ERROR if another asynchronous transfer is pending
+ */
+int dwt_readrxdata_async(uint8 *buffer, uint16 length, uint16 rxBufferOffset)
+{
+    DWT_TRACE_FN();
+
+    uint8 header[3] ;
+    int   cnt = _dwt_buildheader(RX_BUFFER_ID, rxBufferOffset, 0x00, header) ;
+
+    return (readfromspi_async(cnt, header, length, buffer) == 0) ? DWT_SUCCESS : DWT_ERROR ;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_readaccdata_async()
+ *
+ * @brief This is the non-blocking version of dwt_readaccdata(). The ACC clocks are reverted when completion is
+ *        collected, see dwt_asyncdone() and dwt_asyncwait()
+ *
+ * input parameters
+ * @param buffer - the buffer into which the data will be read, it must stay valid until the transfer completes
+ * @param length - the length of data to read (in bytes)
+ * @param accOffset - the offset in the acc buffer from which to read the data
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS if the transfer was started, or DWT_ERROR if another asynchronous transfer is pending
+ */
+int dwt_readaccdata_async(uint8 *buffer, uint16 len, uint16 accOffset)
+{
+    DWT_TRACE_FN();
+
+    uint8 header[3] ;
+    int   cnt ;
+
+    if (!spi_async_done())
+    {
+        return DWT_ERROR ;
+    }
+
+    // Force on the ACC clocks if we are sequenced, they are reverted when the transfer completes
+    _dwt_enableclocks(READ_ACC_ON);
+
+    cnt = _dwt_buildheader(ACC_MEM_ID, accOffset, 0x00, header) ;
+    if (readfromspi_async(cnt, header, len, buffer) != 0)
+    {
+        _dwt_enableclocks(READ_ACC_OFF); // Revert clocks back
+        return DWT_ERROR ;
+    }
+
+    pdw1000local->asyncAccRead = 1 ;
+    return DWT_SUCCESS ;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_asyncdone()
+ *
+ * @brief This is used to poll the pending asynchronous transfer and to restore the driver state once it is complete
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * returns 1 if no transfer is pending, 0 if it is still in flight
+ */
+int dwt_asyncdone(void)
+{
+    DWT_TRACE_FN();
+
+    if (!spi_async_done())
+    {
+        return 0 ;
+    }
+
+    if (pdw1000local->asyncAccRead)
+    {
+        pdw1000local->asyncAccRead = 0 ;
+        _dwt_enableclocks(READ_ACC_OFF); // Revert clocks back
+    }
+    return 1 ;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_asyncwait()
+ *
+ * @brief This is used to block until the pending asynchronous transfer has completed
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_asyncwait(void)
+{
+    spi_async_wait() ;
+    dwt_asyncdone() ;
+}
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_readcarrierintegrator()
  *
@@ -968,6 +1203,8 @@ void dwt_readaccdata(uint8 *buffer, uint16 len, uint16 accOffset)
 
 int32 dwt_readcarrierintegrator(void)
 {
+    DWT_TRACE_FN();
+
     uint32  regval = 0 ;
     int     j ;
     uint8   buffer[DRX_CARRIER_INT_LEN] ;
@@ -1001,6 +1238,8 @@ int32 dwt_readcarrierintegrator(void)
  */
 void dwt_readdiagnostics(dwt_rxdiag_t *diagnostics)
 {
+    DWT_TRACE_FN();
+
     // Read the HW FP index
     diagnostics->firstPath = dwt_read16bitoffsetreg(RX_TIME_ID, RX_TIME_FP_INDEX_OFFSET);
 
@@ -1029,6 +1268,8 @@ void dwt_readdiagnostics(dwt_rxdiag_t *diagnostics)
  */
 void dwt_readtxtimestamp(uint8 * timestamp)
 {
+    DWT_TRACE_FN();
+
     dwt_readfromdevice(TX_TIME_ID, TX_TIME_TX_STAMP_OFFSET, TX_TIME_TX_STAMP_LEN, timestamp) ; // Read bytes directly into buffer
 }
 
@@ -1045,6 +1286,8 @@ void dwt_readtxtimestamp(uint8 * timestamp)
  */
 uint32 dwt_readtxtimestamphi32(void)
 {
+    DWT_TRACE_FN();
+
     return dwt_read32bitoffsetreg(TX_TIME_ID, 1); // Offset is 1 to get the 4 upper bytes out of 5
 }
 
@@ -1061,6 +1304,8 @@ uint32 dwt_readtxtimestamphi32(void)
  */
 uint32 dwt_readtxtimestamplo32(void)
 {
+    DWT_TRACE_FN();
+
     return dwt_read32bitreg(TX_TIME_ID); // Read TX TIME as a 32-bit register to get the 4 lower bytes out of 5
 }
 
@@ -1078,6 +1323,8 @@ uint32 dwt_readtxtimestamplo32(void)
  */
 void dwt_readrxtimestamp(uint8 * timestamp)
 {
+    DWT_TRACE_FN();
+
     dwt_readfromdevice(RX_TIME_ID, RX_TIME_RX_STAMP_OFFSET, RX_TIME_RX_STAMP_LEN, timestamp) ; // Get the adjusted time of arrival
 }
 
@@ -1094,6 +1341,8 @@ void dwt_readrxtimestamp(uint8 * timestamp)
  */
 uint32 dwt_readrxtimestamphi32(void)
 {
+    DWT_TRACE_FN();
+
     return dwt_read32bitoffsetreg(RX_TIME_ID, 1); // Offset is 1 to get the 4 upper bytes out of 5
 }
 
@@ -1110,6 +1359,8 @@ uint32 dwt_readrxtimestamphi32(void)
  */
 uint32 dwt_readrxtimestamplo32(void)
 {
+    DWT_TRACE_FN();
+
     return dwt_read32bitreg(RX_TIME_ID); // Read RX TIME as a 32-bit register to get the 4 lower bytes out of 5
 }
 
@@ -1126,6 +1377,8 @@ uint32 dwt_readrxtimestamplo32(void)
  */
 uint32 dwt_readsystimestamphi32(void)
 {
+    DWT_TRACE_FN();
+
     return dwt_read32bitoffsetreg(SYS_TIME_ID, 1); // Offset is 1 to get the 4 upper bytes out of 5
 }
 
@@ -1144,9 +1397,55 @@ uint32 dwt_readsystimestamphi32(void)
  */
 void dwt_readsystime(uint8 * timestamp)
 {
+    DWT_TRACE_FN();
+
     dwt_readfromdevice(SYS_TIME_ID, SYS_TIME_OFFSET, SYS_TIME_LEN, timestamp) ;
 }
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn _dwt_buildheader()
+ *
+ * @brief  this function is used to compose the SPI transaction header used to access the DW1000 device registers
+ *        a. check if sub index is used, if subindexing is used - set bit-6 to 1 to signify that the sub-index address follows the register index byte
+ *        b. set bit-7 (or with 0x80) for write operation
+ *        c. if extended sub address index is used (i.e. if index > 127) set bit-7 of the first sub-index byte following the first header byte
+ *
+ * input parameters:
+ * @param recordNumber  - ID of register file or buffer being accessed
+ * @param index         - byte index into register file or buffer being accessed
+ * @param rw            - 0x80 for a write operation, 0x00 for a read operation
+ * @param header        - pointer to a 3-byte buffer in which to compose the header
+ *
+ * output parameters
+ *
+ * returns the length of the header (one to three bytes)
+ */
+static int _dwt_buildheader(uint16 recordNumber, uint16 index, uint8 rw, uint8 *header)
+{
+    int cnt = 0; // Counter for length of header
+
+    if (index == 0) // For index of 0, no sub-index is required
+    {
+        header[cnt++] = rw | (uint8)recordNumber ; // Bit-7 is operation, bit-6 zero=NO sub-addressing, bits 5-0 is reg file id
+    }
+    else
+    {
+        header[cnt++] = rw | 0x40 | (uint8)recordNumber ; // Bit-7 is operation, bit-6 one=sub-address follows, bits 5-0 is reg file id
+
+        if (index <= 127) // For non-zero index < 127, just a single sub-index byte is required
+        {
+            header[cnt++] = (uint8)index ; // Bit-7 zero means no extension, bits 6-0 is index.
+        }
+        else
+        {
+            header[cnt++] = 0x80 | (uint8)(index) ; // Bit-7 one means extended index, bits 6-0 is low seven bits of index.
+            header[cnt++] =  (uint8) (index >> 7) ; // 8-bit value = high eight bits of index.
+        }
+    }
+
+    return cnt ;
+} // end _dwt_buildheader()
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_writetodevice()
  *
@@ -1178,35 +1477,38 @@ void dwt_writetodevice
     const uint8   *buffer
 )
 {
+    DWT_TRACE_FN();
+
     uint8 header[3] ; // Buffer to compose header in
-    int   cnt = 0; // Counter for length of header
+    int   cnt ; // Counter for length of header
 #ifdef DWT_API_ERROR_CHECK
     assert(recordNumber <= 0x3F); // Record number is limited to 6-bits.
+    assert((index <= 0x7FFF) && ((index + length) <= 0x7FFF)); // Index and sub-addressable area are limited to 15-bits.
 #endif
 
-    // Write message header selecting WRITE operation and addresses as appropriate (this is one to three bytes long)
-    if (index == 0) // For index of 0, no sub-index is required
-    {
-        header[cnt++] = 0x80 | recordNumber ; // Bit-7 is WRITE operation, bit-6 zero=NO sub-addressing, bits 5-0 is reg file id
-    }
-    else
-    {
-#ifdef DWT_API_ERROR_CHECK
-        assert((index <= 0x7FFF) && ((index + length) <= 0x7FFF)); // Index and sub-addressable area are limited to 15-bits.
-#endif
-        header[cnt++] = 0xC0 | recordNumber ; // Bit-7 is WRITE operation, bit-6 one=sub-address follows, bits 5-0 is reg file id
+    _dwt_cachewrite(recordNumber, index, length, buffer);
 
-        if (index <= 127) // For non-zero index < 127, just a single sub-index byte is required
+    if (dw1000batch.depth)
+    {
+        // Queue a copy of the data if it fits, otherwise issue what is queued and write directly
+        if ((dw1000batch.count == DWT_BATCH_MAX_XFER) || ((dw1000batch.datalen + length) > DWT_BATCH_DATA_SIZE))
         {
-            header[cnt++] = (uint8)index ; // Bit-7 zero means no extension, bits 6-0 is index.
+            _dwt_batchflush();
         }
-        else
+        if (length <= DWT_BATCH_DATA_SIZE)
         {
-            header[cnt++] = 0x80 | (uint8)(index) ; // Bit-7 one means extended index, bits 6-0 is low seven bits of index.
-            header[cnt++] =  (uint8) (index >> 7) ; // 8-bit value = high eight bits of index.
+            uint8 *data = &dw1000batch.data[dw1000batch.datalen] ;
+
+            memcpy(data, buffer, length);
+            dw1000batch.datalen += length ;
+            _dwt_batchqueue(recordNumber, index, length, data, 0);
+            return ;
         }
     }
 
+    // Write message header selecting WRITE operation and addresses as appropriate (this is one to three bytes long)
+    cnt = _dwt_buildheader(recordNumber, index, 0x80, header) ;
+
     // Write it to the SPI
     writetospi(cnt,header,length,buffer);
 } // end dwt_writetodevice()
@@ -1242,38 +1544,377 @@ void dwt_readfromdevice
     uint8         *buffer
 )
 {
+    DWT_TRACE_FN();
+
     uint8 header[3] ; // Buffer to compose header in
-    int   cnt = 0; // Counter for length of header
+    int   cnt ; // Counter for length of header
 #ifdef DWT_API_ERROR_CHECK
     assert(recordNumber <= 0x3F); // Record number is limited to 6-bits.
+    assert((index <= 0x7FFF) && ((index + length) <= 0x7FFF)); // Index and sub-addressable area are limited to 15-bits.
 #endif
 
+    // Cached registers already reflect the writes queued before the read
+    if (_dwt_cacheread(recordNumber, index, length, buffer))
+    {
+        return ;
+    }
+
+    // The read must observe the writes queued before it
+    if (dw1000batch.count)
+    {
+        _dwt_batchflush();
+    }
+
     // Write message header selecting READ operation and addresses as appropriate (this is one to three bytes long)
-    if (index == 0) // For index of 0, no sub-index is required
+    cnt = _dwt_buildheader(recordNumber, index, 0x00, header) ;
+
+    // Do the read from the SPI
+    readfromspi(cnt, header, length, buffer);  // result is stored in the buffer
+} // end dwt_readfromdevice()
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn _dwt_cachefind()
+ *
+ * @brief  this function looks for the cached register containing the given register file bytes
+ *
+ * input parameters:
+ * @param recordNumber  - ID of register file or buffer being accessed
+ * @param index         - byte index into register file or buffer being accessed
+ * @param length        - number of bytes being accessed
+ *
+ * output parameters
+ *
+ * returns the index of the cached register in reg_cache_desc, or -1 if the bytes are not (entirely) in a cached register
+ */
+static int _dwt_cachefind(uint16 recordNumber, uint16 index, uint32 length)
+{
+    int i ;
+
+    for (i = 0 ; i < DWT_REG_CACHE_NUM ; i++)
+    {
+        if ((reg_cache_desc[i].regFileID == recordNumber)
+            && (index >= reg_cache_desc[i].offset)
+            && ((index + length) <= (reg_cache_desc[i].offset + DWT_REG_CACHE_LEN)))
+        {
+            return i ;
+        }
+    }
+
+    return -1 ;
+} // end _dwt_cachefind()
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn _dwt_cacheread()
+ *
+ * @brief  this function serves a read of a cached register. If the cached copy is not valid, the whole register is read
+ * from the device to fill it.
+ *
+ * input parameters:
+ * @param recordNumber  - ID of register file or buffer being accessed
+ * @param index         - byte index into register file or buffer being accessed
+ * @param length        - number of bytes being read
+ * @param buffer        - pointer to buffer in which to return the read data
+ *
+ * output parameters
+ *
+ * returns 1 if the read has been served, 0 if the bytes are not in a cached register
+ */
+static int _dwt_cacheread(uint16 recordNumber, uint16 index, uint32 length, uint8 *buffer)
+{
+    int i = _dwt_cachefind(recordNumber, index, length) ;
+
+    if (i < 0)
     {
-        header[cnt++] = (uint8) recordNumber ; // Bit-7 zero is READ operation, bit-6 zero=NO sub-addressing, bits 5-0 is reg file id
+        return 0 ;
+    }
+
+    if (pdw1000local->regCacheValid & (1 << i))
+    {
+        pdw1000local->regCacheHits++ ;
     }
     else
     {
-#ifdef DWT_API_ERROR_CHECK
-        assert((index <= 0x7FFF) && ((index + length) <= 0x7FFF)); // Index and sub-addressable area are limited to 15-bits.
-#endif
-        header[cnt++] = (uint8)(0x40 | recordNumber) ; // Bit-7 zero is READ operation, bit-6 one=sub-address follows, bits 5-0 is reg file id
+        uint8 header[3] ;
+        int   cnt ;
 
-        if (index <= 127) // For non-zero index < 127, just a single sub-index byte is required
+        if (dw1000batch.count)
         {
-            header[cnt++] = (uint8) index ; // Bit-7 zero means no extension, bits 6-0 is index.
+            _dwt_batchflush();
         }
-        else
+
+        cnt = _dwt_buildheader(recordNumber, reg_cache_desc[i].offset, 0x00, header) ;
+        readfromspi(cnt, header, DWT_REG_CACHE_LEN, pdw1000local->regCache[i]);
+
+        pdw1000local->regCacheValid |= (1 << i) ;
+        pdw1000local->regCacheMisses++ ;
+    }
+
+    memcpy(buffer, &pdw1000local->regCache[i][index - reg_cache_desc[i].offset], length);
+
+    return 1 ;
+} // end _dwt_cacheread()
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn _dwt_cachewrite()
+ *
+ * @brief  this function updates the cached registers overlapped by a register write. A cached copy that is not valid only
+ * becomes valid if the write covers the whole register.
+ *
+ * input parameters:
+ * @param recordNumber  - ID of register file or buffer being accessed
+ * @param index         - byte index into register file or buffer being accessed
+ * @param length        - number of bytes being written
+ * @param buffer        - pointer to buffer containing the 'length' bytes to be written
+ *
+ * output parameters
+ *
+ * no return value
+ */
+static void _dwt_cachewrite(uint16 recordNumber, uint16 index, uint32 length, const uint8 *buffer)
+{
+    int i ;
+
+    for (i = 0 ; i < DWT_REG_CACHE_NUM ; i++)
+    {
+        uint32 start = reg_cache_desc[i].offset ;
+        uint32 end = start + DWT_REG_CACHE_LEN ;
+
+        if ((reg_cache_desc[i].regFileID != recordNumber) || (index >= end) || ((index + length) <= start))
         {
-            header[cnt++] = 0x80 | (uint8)(index) ; // Bit-7 one means extended index, bits 6-0 is low seven bits of index.
-            header[cnt++] =  (uint8) (index >> 7) ; // 8-bit value = high eight bits of index.
+            continue ;
+        }
+
+        if ((index <= start) && ((index + length) >= end))
+        {
+            memcpy(pdw1000local->regCache[i], &buffer[start - index], DWT_REG_CACHE_LEN);
+            pdw1000local->regCacheValid |= (1 << i) ;
+        }
+        else if (pdw1000local->regCacheValid & (1 << i))
+        {
+            uint32 first = (index > start) ? index : start ;
+            uint32 last = ((index + length) < end) ? (index + length) : end ;
+
+            memcpy(&pdw1000local->regCache[i][first - start], &buffer[first - index], last - first);
         }
     }
+} // end _dwt_cachewrite()
 
-    // Do the read from the SPI
-    readfromspi(cnt, header, length, buffer);  // result is stored in the buffer
-} // end dwt_readfromdevice()
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_invalidatecache()
+ *
+ * @brief  this function discards the content of the shadow register cache, the next read of each cached register is done
+ * from the device. It is called by the driver after a reset and around sleep, and must be called by the application after
+ * any other event which resets the device registers (e.g. wake-up through the WAKEUP pin or a hard reset).
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_invalidatecache(void)
+{
+    pdw1000local->regCacheValid = 0 ;
+} // end dwt_invalidatecache()
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_readcachestats()
+ *
+ * @brief  this function reads the shadow register cache counters. They are cumulative since dwt_initialise(), the number of
+ * SPI reads saved over a sequence of operations is the difference of the hit counter before and after it.
+ *
+ * input parameters
+ *
+ * output parameters
+ * @param hits      - number of register reads served from the cache
+ * @param misses    - number of reads of cached registers that needed an SPI access
+ *
+ * no return value
+ */
+void dwt_readcachestats(uint32 *hits, uint32 *misses)
+{
+    *hits = pdw1000local->regCacheHits ;
+    *misses = pdw1000local->regCacheMisses ;
+} // end dwt_readcachestats()
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_gettxlatecause()
+ *
+ * @brief  this function returns the cause of the last delayed transmission which dwt_starttx() could not start.
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * returns DWT_TXLATE_NONE if there was none since dwt_initialise(), DWT_TXLATE_SCHEDULE or DWT_TXLATE_HPW otherwise
+ */
+uint8 dwt_gettxlatecause(void)
+{
+    return pdw1000local->txLateCause ;
+} // end dwt_gettxlatecause()
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_readtxlatecounters()
+ *
+ * @brief  this function reads the counters of delayed transmissions which dwt_starttx() could not start, per cause.
+ *
+ * input parameters
+ *
+ * output parameters
+ * @param counts    - array of DWT_TXLATE_NUM counters, indexed by DWT_TXLATE_xxx, cumulative since dwt_initialise()
+ *
+ * no return value
+ */
+void dwt_readtxlatecounters(uint32 *counts)
+{
+    memcpy(counts, pdw1000local->txLateCount, sizeof(pdw1000local->txLateCount));
+} // end dwt_readtxlatecounters()
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn _dwt_batchqueue()
+ *
+ * @brief  this function appends a register access to the open batch, the caller makes sure there is room for it
+ *
+ * input parameters:
+ * @param recordNumber  - ID of register file or buffer being accessed
+ * @param index         - byte index into register file or buffer being accessed
+ * @param length        - number of bytes being written or read
+ * @param buffer        - pointer to the data to write, or to the buffer in which to return the read data
+ * @param read          - 1 for a read access, 0 for a write access
+ *
+ * output parameters
+ *
+ * no return value
+ */
+static void _dwt_batchqueue(uint16 recordNumber, uint16 index, uint32 length, uint8 *buffer, uint8 read)
+{
+    deca_spi_xfer_t *xfer ;
+
+    xfer = &dw1000batch.xfer[dw1000batch.count] ;
+    xfer->headerBuffer = dw1000batch.header[dw1000batch.count] ;
+    xfer->headerLength = _dwt_buildheader(recordNumber, index, read ? 0x00 : 0x80, dw1000batch.header[dw1000batch.count]) ;
+    xfer->bodyLength = length ;
+    xfer->bodyBuffer = buffer ;
+    xfer->read = read ;
+    dw1000batch.count++ ;
+} // end _dwt_batchqueue()
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn _dwt_batchflush()
+ *
+ * @brief  this function issues the register accesses queued in the open batch and empties it
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS for success, or DWT_ERROR for error
+ */
+static int _dwt_batchflush(void)
+{
+    int ret = DWT_SUCCESS ;
+
+    if (dw1000batch.count)
+    {
+        ret = transferspi(dw1000batch.xfer, dw1000batch.count);
+    }
+    dw1000batch.count = 0 ;
+    dw1000batch.datalen = 0 ;
+
+    return ret ;
+} // end _dwt_batchflush()
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_batchbegin()
+ *
+ * @brief  this function opens a batch of register accesses, see dwt_batchcommit()
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_batchbegin(void)
+{
+    decaIrqStatus_t stat = decamutexon() ;
+
+    if (dw1000batch.depth++ == 0)
+    {
+        dw1000batch.stat = stat ;
+    }
+    else
+    {
+        decamutexoff(stat) ;
+    }
+} // end dwt_batchbegin()
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_batchread()
+ *
+ * @brief  this function queues a register read in the open batch, the data is available once dwt_batchcommit() returns
+ *
+ * input parameters:
+ * @param recordNumber  - ID of register file or buffer being accessed
+ * @param index         - byte index into register file or buffer being accessed
+ * @param length        - number of bytes being read
+ * @param buffer        - pointer to buffer in which to return the read data
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_batchread(uint16 recordNumber, uint16 index, uint32 length, uint8 *buffer)
+{
+#ifdef DWT_API_ERROR_CHECK
+    assert(recordNumber <= 0x3F); // Record number is limited to 6-bits.
+    assert((index <= 0x7FFF) && ((index + length) <= 0x7FFF)); // Index and sub-addressable area are limited to 15-bits.
+#endif
+
+    if (dw1000batch.depth == 0)
+    {
+        dwt_readfromdevice(recordNumber, index, length, buffer);
+        return ;
+    }
+
+    if (dw1000batch.count == DWT_BATCH_MAX_XFER)
+    {
+        _dwt_batchflush();
+    }
+
+    _dwt_batchqueue(recordNumber, index, length, buffer, 1);
+} // end dwt_batchread()
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_batchcommit()
+ *
+ * @brief  this function closes the batch opened by dwt_batchbegin() and issues the queued register accesses
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS for success, or DWT_ERROR for error
+ */
+int dwt_batchcommit(void)
+{
+    DWT_TRACE_FN();
+
+    int ret = DWT_SUCCESS ;
+
+    if (dw1000batch.depth == 0)
+    {
+        return DWT_ERROR ;
+    }
+
+    if (--dw1000batch.depth == 0)
+    {
+        ret = _dwt_batchflush() ;
+        decamutexoff(dw1000batch.stat) ;
+    }
+
+    return ret ;
+} // end dwt_batchcommit()
 
 
 
@@ -1292,6 +1933,8 @@ void dwt_readfromdevice
  */
 uint32 dwt_read32bitoffsetreg(int regFileID, int regOffset)
 {
+    DWT_TRACE_FN();
+
     uint32  regval = 0 ;
     int     j ;
     uint8   buffer[4] ;
@@ -1321,6 +1964,8 @@ uint32 dwt_read32bitoffsetreg(int regFileID, int regOffset)
  */
 uint16 dwt_read16bitoffsetreg(int regFileID, int regOffset)
 {
+    DWT_TRACE_FN();
+
     uint16  regval = 0 ;
     uint8   buffer[2] ;
 
@@ -1346,6 +1991,8 @@ uint16 dwt_read16bitoffsetreg(int regFileID, int regOffset)
  */
 uint8 dwt_read8bitoffsetreg(int regFileID, int regOffset)
 {
+    DWT_TRACE_FN();
+
     uint8 regval;
 
     dwt_readfromdevice(regFileID, regOffset, 1, &regval);
@@ -1369,6 +2016,8 @@ uint8 dwt_read8bitoffsetreg(int regFileID, int regOffset)
  */
 void dwt_write8bitoffsetreg(int regFileID, int regOffset, uint8 regval)
 {
+    DWT_TRACE_FN();
+
     dwt_writetodevice(regFileID, regOffset, 1, &regval);
 }
 
@@ -1388,6 +2037,8 @@ void dwt_write8bitoffsetreg(int regFileID, int regOffset, uint8 regval)
  */
 void dwt_write16bitoffsetreg(int regFileID, int regOffset, uint16 regval)
 {
+    DWT_TRACE_FN();
+
     uint8   buffer[2] ;
 
     buffer[0] = regval & 0xFF;
@@ -1412,6 +2063,8 @@ void dwt_write16bitoffsetreg(int regFileID, int regOffset, uint16 regval)
  */
 void dwt_write32bitoffsetreg(int regFileID, int regOffset, uint32 regval)
 {
+    DWT_TRACE_FN();
+
     int     j ;
     uint8   buffer[4] ;
 
@@ -1446,6 +2099,8 @@ void dwt_write32bitoffsetreg(int regFileID, int regOffset, uint32 regval)
  */
 void dwt_enableframefilter(uint16 enable)
 {
+    DWT_TRACE_FN();
+
     uint32 sysconfig = SYS_CFG_MASK & dwt_read32bitreg(SYS_CFG_ID) ; // Read sysconfig register
 
     if(enable)
@@ -1477,6 +2132,8 @@ void dwt_enableframefilter(uint16 enable)
  */
 void dwt_setpanid(uint16 panID)
 {
+    DWT_TRACE_FN();
+
     // PAN ID is high 16 bits of register
     dwt_write16bitoffsetreg(PANADR_ID, PANADR_PAN_ID_OFFSET, panID);
 }
@@ -1495,6 +2152,8 @@ void dwt_setpanid(uint16 panID)
  */
 void dwt_setaddress16(uint16 shortAddress)
 {
+    DWT_TRACE_FN();
+
     // Short address into low 16 bits
     dwt_write16bitoffsetreg(PANADR_ID, PANADR_SHORT_ADDR_OFFSET, shortAddress);
 }
@@ -1513,6 +2172,8 @@ void dwt_setaddress16(uint16 shortAddress)
  */
 void dwt_seteui(uint8 *eui64)
 {
+    DWT_TRACE_FN();
+
     dwt_writetodevice(EUI_64_ID, EUI_64_OFFSET, EUI_64_LEN, eui64);
 }
 
@@ -1530,6 +2191,8 @@ void dwt_seteui(uint8 *eui64)
  */
 void dwt_geteui(uint8 *eui64)
 {
+    DWT_TRACE_FN();
+
     dwt_readfromdevice(EUI_64_ID, EUI_64_OFFSET, EUI_64_LEN, eui64);
 }
 
@@ -1549,6 +2212,8 @@ void dwt_geteui(uint8 *eui64)
  */
 void dwt_otpread(uint16 address, uint32 *array, uint8 length)
 {
+    DWT_TRACE_FN();
+
     int i;
 
     _dwt_enableclocks(FORCE_SYS_XTI); // NOTE: Set system clock to XTAL - this is necessary to make sure the values read by _dwt_otpread are reliable
@@ -1809,6 +2474,8 @@ uint32 _dwt_otpprogword32(uint32 data, uint16 address)
  */
 int dwt_otpwriteandverify(uint32 value, uint16 address)
 {
+    DWT_TRACE_FN();
+
     int prog_ok = DWT_SUCCESS;
     int retry = 0;
     // Firstly set the system clock to crystal
@@ -1900,8 +2567,13 @@ void _dwt_aonarrayupload(void)
  */
 void dwt_entersleep(void)
 {
+    DWT_TRACE_FN();
+
     // Copy config to AON - upload the new configuration
     _dwt_aonarrayupload();
+
+    // Registers not restored from AON lose their content while sleeping
+    dwt_invalidatecache();
 }
 
 /*! ------------------------------------------------------------------------------------------------------------------
@@ -1920,6 +2592,8 @@ void dwt_entersleep(void)
  */
 void dwt_configuresleepcnt(uint16 sleepcnt)
 {
+    DWT_TRACE_FN();
+
     // Force system clock to crystal
     _dwt_enableclocks(FORCE_SYS_XTI);
 
@@ -1958,6 +2632,8 @@ void dwt_configuresleepcnt(uint16 sleepcnt)
  */
 uint16 dwt_calibratesleepcnt(void)
 {
+    DWT_TRACE_FN();
+
     uint16 result;
 
     // Enable calibration of the sleep counter
@@ -2045,6 +2721,8 @@ uint16 dwt_calibratesleepcnt(void)
  */
 void dwt_configuresleep(uint16 mode, uint8 wake)
 {
+    DWT_TRACE_FN();
+
     // Add predefined sleep settings before writing the mode
     mode |= pdw1000local->sleep_mode;
     dwt_write16bitoffsetreg(AON_ID, AON_WCFG_OFFSET, mode);
@@ -2070,6 +2748,8 @@ void dwt_configuresleep(uint16 mode, uint8 wake)
  */
 void dwt_entersleepaftertx(int enable)
 {
+    DWT_TRACE_FN();
+
     uint32 reg = dwt_read32bitoffsetreg(PMSC_ID, PMSC_CTRL1_OFFSET);
     // Set the auto TX -> sleep bit
     if(enable)
@@ -2109,6 +2789,8 @@ void dwt_entersleepaftertx(int enable)
  */
 int dwt_spicswakeup(uint8 *buff, uint16 length)
 {
+    DWT_TRACE_FN();
+
     if(dwt_readdevid() != DWT_DEVICE_ID) // Device was in deep sleep (the first read fails)
     {
         // Need to keep chip select line low for at least 500us
@@ -2117,6 +2799,8 @@ int dwt_spicswakeup(uint8 *buff, uint16 length)
         // Need 5ms for XTAL to start and stabilise (could wait for PLL lock IRQ status bit !!!)
         // NOTE: Polling of the STATUS register is not possible unless frequency is < 3MHz
         deca_sleep(5);
+
+        dwt_invalidatecache();
     }
     else
     {
@@ -2200,6 +2884,8 @@ void _dwt_loaducodefromrom(void)
  */
 void dwt_loadopsettabfromotp(uint8 ops_sel)
 {
+    DWT_TRACE_FN();
+
     uint16 reg = ((ops_sel << OTP_SF_OPS_SEL_SHFT) & OTP_SF_OPS_SEL_MASK) | OTP_SF_OPS_KICK; // Select defined OPS table and trigger its loading
 
     // Set up clocks
@@ -2226,6 +2912,8 @@ void dwt_loadopsettabfromotp(uint8 ops_sel)
  */
 void dwt_setsmarttxpower(int enable)
 {
+    DWT_TRACE_FN();
+
     // Config system register
     pdw1000local->sysCFGreg = dwt_read32bitreg(SYS_CFG_ID) ; // Read sysconfig register
 
@@ -2259,6 +2947,8 @@ void dwt_setsmarttxpower(int enable)
  */
 void dwt_enableautoack(uint8 responseDelayTime)
 {
+    DWT_TRACE_FN();
+
     // Set auto ACK reply delay
     dwt_write8bitoffsetreg(ACK_RESP_T_ID, ACK_RESP_T_ACK_TIM_OFFSET, responseDelayTime); // In symbols
     // Enable auto ACK
@@ -2280,6 +2970,8 @@ void dwt_enableautoack(uint8 responseDelayTime)
  */
 void dwt_setdblrxbuffmode(int enable)
 {
+    DWT_TRACE_FN();
+
     if(enable)
     {
         // Enable double RX buffer mode
@@ -2310,6 +3002,8 @@ void dwt_setdblrxbuffmode(int enable)
  */
 void dwt_setrxaftertxdelay(uint32 rxDelayTime)
 {
+    DWT_TRACE_FN();
+
     uint32 val = dwt_read32bitreg(ACK_RESP_T_ID) ; // Read ACK_RESP_T_ID register
 
     val &= ~(ACK_RESP_T_W4R_TIM_MASK) ; // Clear the timer (19:0)
@@ -2345,6 +3039,25 @@ void dwt_setcallbacks(dwt_cb_t cbTxDone, dwt_cb_t cbRxOk, dwt_cb_t cbRxTo, dwt_c
     pdw1000local->cbRxErr = cbRxErr;
 }
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_setcallbackrxbuffer()
+ *
+ * @brief This function is used to give dwt_isr() a buffer to read the received frames into, see cbData.rx_data.
+ *
+ * input parameters
+ * @param buffer - the buffer (NULL to stop reading the frames in the ISR)
+ * @param length - the size of the buffer
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_setcallbackrxbuffer(uint8 *buffer, uint16 length)
+{
+    pdw1000local->cbRxBuffer = buffer;
+    pdw1000local->cbRxBufferLen = (buffer != NULL) ? length : 0;
+}
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_checkirq()
  *
@@ -2358,9 +3071,57 @@ void dwt_setcallbacks(dwt_cb_t cbTxDone, dwt_cb_t cbRxOk, dwt_cb_t cbRxTo, dwt_c
  */
 uint8 dwt_checkirq(void)
 {
+    DWT_TRACE_FN();
+
     return (dwt_read8bitoffsetreg(SYS_STATUS_ID, SYS_STATUS_OFFSET) & SYS_STATUS_IRQS); // Reading the lower byte only is enough for this operation
 }
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn _dwt_rxframelength()
+ *
+ * @brief This function returns the length of the received frame from the first two bytes of RX_FINFO.
+ *
+ * input parameters
+ * @param finfo - the first two bytes of RX_FINFO
+ *
+ * output parameters
+ *
+ * returns the frame length - standard frame length up to 127, extended frame length up to 1023 bytes
+ */
+static uint16 _dwt_rxframelength(const uint8 *finfo)
+{
+    uint16 len = (((uint16)finfo[1] << 8) | finfo[0]) & RX_FINFO_RXFL_MASK_1023;
+
+    if(pdw1000local->longFrames == 0)
+    {
+        len &= RX_FINFO_RXFLEN_MASK;
+    }
+    return len;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn _dwt_cbrxstamp()
+ *
+ * @brief Sets the RX timestamp of the callback data as a number, from the 5 bytes read into its rx_stamp field
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * no return value
+ */
+static void _dwt_cbrxstamp(void)
+{
+    uint64 ts = 0;
+    int i;
+
+    for(i = RX_TIME_RX_STAMP_LEN - 1; i >= 0; i--)
+    {
+        ts = (ts << 8) | pdw1000local->cbData.rx_stamp[i];
+    }
+    pdw1000local->cbData.rx_ts = ts;
+}
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_isr()
  *
@@ -2370,8 +3131,14 @@ uint8 dwt_checkirq(void)
  *          - RXRFTO/RXPTO (through cbRxTo callback)
  *          - RXPHE/RXFCE/RXRFSL/RXSFDTO/AFFREJ/LDEERR (through cbRxTo cbRxErr)
  *        For all events, corresponding interrupts are cleared and necessary resets are performed. In addition, in the RXFCG case,
- *        received frame information and frame control are read before calling the callback. If double buffering is activated, it
- *        will also toggle between reception buffers once the reception callback processing has ended.
+ *        received frame information, RX timestamp and frame control (and the frame itself if dwt_setcallbackrxbuffer() was called)
+ *        are read before calling the callback. If double buffering is activated, it will also toggle between reception buffers
+ *        once the reception callback processing has ended.
+ *
+ *        When an RX good frame callback is set and the receiver is on with no transmission pending (as last left by dwt_rxenable(),
+ *        dwt_starttx() and the events handled here), the frame information, RX timestamp and frame control are read speculatively in
+ *        the same batch as the status register, so that a good frame costs a single status clear write (plus the frame read, in
+ *        the same batch) afterwards. The IRQs of other events, TXFRS first, do not read them.
  *
  *        /!\ This version of the ISR supports double buffering but does not support automatic RX re-enabling!
  *
@@ -2387,28 +3154,69 @@ uint8 dwt_checkirq(void)
  */
 void dwt_isr(void)
 {
-    uint32 status = pdw1000local->cbData.status = dwt_read32bitreg(SYS_STATUS_ID); // Read status register low 32bits
+    DWT_TRACE_FN();
+
+    uint8  statusbuf[4];
+    uint8  finfo[2];
+    uint8  prefetch = (pdw1000local->cbRxOk != NULL) && pdw1000local->rxArmed && !pdw1000local->txPending;
+    uint32 status;
+
+    // Read the status register low 32bits, and if a good frame would be reported, its frame info, timestamp and frame control
+    dwt_batchbegin();
+
+    dwt_batchread(SYS_STATUS_ID, SYS_STATUS_OFFSET, sizeof(statusbuf), statusbuf);
+    if(prefetch)
+    {
+        dwt_batchread(RX_FINFO_ID, RX_FINFO_OFFSET, sizeof(finfo), finfo); // Only the first two bytes of the register are used here.
+        dwt_batchread(RX_TIME_ID, RX_TIME_RX_STAMP_OFFSET, RX_TIME_RX_STAMP_LEN, pdw1000local->cbData.rx_stamp);
+        dwt_batchread(RX_BUFFER_ID, 0, FCTRL_LEN_MAX, pdw1000local->cbData.fctrl); // First bytes of the received frame.
+    }
+
+    dwt_batchcommit();
+
+    status = ((uint32)statusbuf[3] << 24) | ((uint32)statusbuf[2] << 16) | ((uint32)statusbuf[1] << 8) | statusbuf[0];
+    pdw1000local->cbData.status = status;
+    pdw1000local->cbData.rx_data = NULL;
 
     // Handle RX good frame event
     if(status & SYS_STATUS_RXFCG)
     {
         uint16 finfo16;
-        uint16 len;
 
-        dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_GOOD); // Clear all receive status bits
+        // Clear the status, and read the frame (or what was not prefetched) in a single batch
+        dwt_batchbegin();
 
-        pdw1000local->cbData.rx_flags = 0;
+        dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_GOOD); // Clear all receive status bits
 
-        // Read frame info - Only the first two bytes of the register are used here.
-        finfo16 = dwt_read16bitoffsetreg(RX_FINFO_ID, RX_FINFO_OFFSET);
+        if(prefetch)
+        {
+            uint16 len = _dwt_rxframelength(finfo);
 
-        // Report frame length - Standard frame length up to 127, extended frame length up to 1023 bytes
-        len = finfo16 & RX_FINFO_RXFL_MASK_1023;
-        if(pdw1000local->longFrames == 0)
+            if((pdw1000local->cbRxBuffer != NULL) && (len <= pdw1000local->cbRxBufferLen))
+            {
+                dwt_batchread(RX_BUFFER_ID, 0, len, pdw1000local->cbRxBuffer);
+                pdw1000local->cbData.rx_data = pdw1000local->cbRxBuffer;
+            }
+        }
+        else
         {
-            len &= RX_FINFO_RXFLEN_MASK;
+            dwt_batchread(RX_FINFO_ID, RX_FINFO_OFFSET, sizeof(finfo), finfo);
+            dwt_batchread(RX_TIME_ID, RX_TIME_RX_STAMP_OFFSET, RX_TIME_RX_STAMP_LEN, pdw1000local->cbData.rx_stamp);
+            dwt_batchread(RX_BUFFER_ID, 0, FCTRL_LEN_MAX, pdw1000local->cbData.fctrl);
         }
-        pdw1000local->cbData.datalength = len;
+
+        dwt_batchcommit();
+
+        _dwt_cbrxstamp();
+        pdw1000local->cbData.rx_flags = 0;
+
+        // The receiver is off after a good frame: the callback may enable it again
+        pdw1000local->rxArmed = 0;
+
+        finfo16 = ((uint16)finfo[1] << 8) | finfo[0];
+
+        // Report frame length
+        pdw1000local->cbData.datalength = _dwt_rxframelength(finfo);
 
         // Report ranging bit
         if(finfo16 & RX_FINFO_RNG)
@@ -2416,9 +3224,6 @@ void dwt_isr(void)
             pdw1000local->cbData.rx_flags |= DWT_CB_DATA_RX_FLAG_RNG;
         }
 
-        // Report frame control - First bytes of the received frame.
-        dwt_readfromdevice(RX_BUFFER_ID, 0, FCTRL_LEN_MAX, pdw1000local->cbData.fctrl);
-
         // Because of a previous frame not being received properly, AAT bit can be set upon the proper reception of a frame not requesting for
         // acknowledgement (ACK frame is not actually sent though). If the AAT bit is set, check ACK request bit in frame control to confirm (this
         // implementation works only for IEEE802.15.4-2011 compliant frames).
@@ -2447,6 +3252,7 @@ void dwt_isr(void)
     if(status & SYS_STATUS_TXFRS)
     {
         dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_TX); // Clear TX event bits
+        pdw1000local->txPending = 0;
 
         // In the case where this TXFRS interrupt is due to the automatic transmission of an ACK solicited by a response (with ACK request bit set)
         // that we receive through using wait4resp to a previous TX (and assuming that the IRQ processing of that TX has already been handled), then
@@ -2524,6 +3330,8 @@ void dwt_isr(void)
  */
 void dwt_lowpowerlistenisr(void)
 {
+    DWT_TRACE_FN();
+
     uint32 status = pdw1000local->cbData.status = dwt_read32bitreg(SYS_STATUS_ID); // Read status register low 32bits
     uint16 finfo16;
     uint16 len;
@@ -2557,6 +3365,11 @@ void dwt_lowpowerlistenisr(void)
     // Report frame control - First bytes of the received frame.
     dwt_readfromdevice(RX_BUFFER_ID, 0, FCTRL_LEN_MAX, pdw1000local->cbData.fctrl);
 
+    // Report RX timestamp
+    dwt_readfromdevice(RX_TIME_ID, RX_TIME_RX_STAMP_OFFSET, RX_TIME_RX_STAMP_LEN, pdw1000local->cbData.rx_stamp);
+    _dwt_cbrxstamp();
+    pdw1000local->cbData.rx_data = NULL;
+
     // Because of a previous frame not being received properly, AAT bit can be set upon the proper reception of a frame not requesting for
     // acknowledgement (ACK frame is not actually sent though). If the AAT bit is set, check ACK request bit in frame control to confirm (this
     // implementation works only for IEEE802.15.4-2011 compliant frames).
@@ -2594,6 +3407,8 @@ void dwt_lowpowerlistenisr(void)
  */
 void dwt_setleds(uint8 mode)
 {
+    DWT_TRACE_FN();
+
     uint32 reg;
 
     if (mode & DWT_LEDS_ENABLE)
@@ -2747,6 +3562,8 @@ void _dwt_disablesequencing(void) // Disable sequencing and go to state "INIT"
  */
 void dwt_setdelayedtrxtime(uint32 starttime)
 {
+    DWT_TRACE_FN();
+
     dwt_write32bitoffsetreg(DX_TIME_ID, 1, starttime); // Write at offset 1 as the lower 9 bits of this register are ignored
 
 } // end dwt_setdelayedtrxtime()
@@ -2769,6 +3586,8 @@ void dwt_setdelayedtrxtime(uint32 starttime)
 
 int dwt_starttx(uint8 mode)
 {
+    DWT_TRACE_FN();
+
     int retval = DWT_SUCCESS ;
     uint8 temp  = 0x00;
     uint16 checkTxOK = 0 ;
@@ -2779,6 +3598,10 @@ int dwt_starttx(uint8 mode)
         pdw1000local->wait4resp = 1;
     }
 
+    // The receiver goes off for the transmission, and on again after it if a response is expected
+    pdw1000local->rxArmed = (temp != 0);
+    pdw1000local->txPending = 1;
+
     if (mode & DWT_START_TX_DELAYED)
     {
         // Both SYS_CTRL_TXSTRT and SYS_CTRL_TXDLYS to correctly enable TX
@@ -2794,6 +3617,13 @@ int dwt_starttx(uint8 mode)
             // If HPDWARN or TXPUTE are set this indicates that the TXDLYS was set too late for the specified DX_TIME.
             // remedial action is to cancel delayed send and report error
             dwt_write8bitoffsetreg(SYS_CTRL_ID, SYS_CTRL_OFFSET, (uint8)SYS_CTRL_TRXOFF);
+            pdw1000local->rxArmed = 0;
+            pdw1000local->txPending = 0;
+            // HPDWARN: DX_TIME has already passed. TXPUTE alone: it has not, but is too close to power up the transmitter.
+            pdw1000local->txLateCause = (checkTxOK & (SYS_STATUS_HPDWARN >> 24)) ? DWT_TXLATE_HPW : DWT_TXLATE_SCHEDULE;
+            pdw1000local->txLateCount[pdw1000local->txLateCause]++ ;
+            // The flags are sticky, they would fail the next delayed transmission
+            dwt_write16bitoffsetreg(SYS_STATUS_ID, 3, SYS_STATUS_TXERR);
             retval = DWT_ERROR ; // Failed !
         }
     }
@@ -2820,6 +3650,8 @@ int dwt_starttx(uint8 mode)
  */
 void dwt_forcetrxoff(void)
 {
+    DWT_TRACE_FN();
+
     decaIrqStatus_t stat ;
     uint32 mask;
 
@@ -2845,6 +3677,8 @@ void dwt_forcetrxoff(void)
     // Enable/restore interrupts again...
     decamutexoff(stat) ;
     pdw1000local->wait4resp = 0;
+    pdw1000local->rxArmed = 0;
+    pdw1000local->txPending = 0;
 
 } // end deviceforcetrxoff()
 
@@ -2862,6 +3696,8 @@ void dwt_forcetrxoff(void)
  */
 void dwt_syncrxbufptrs(void)
 {
+    DWT_TRACE_FN();
+
     uint8  buff ;
     // Need to make sure that the host/IC buffer pointers are aligned before starting RX
     buff = dwt_read8bitoffsetreg(SYS_STATUS_ID, 3); // Read 1 byte at offset 3 to get the 4th byte out of 5
@@ -2894,6 +3730,8 @@ void dwt_syncrxbufptrs(void)
  */
 void dwt_setsniffmode(int enable, uint8 timeOn, uint8 timeOff)
 {
+    DWT_TRACE_FN();
+
     uint32 pmsc_reg;
     if (enable)
     {
@@ -2946,6 +3784,8 @@ void dwt_setsniffmode(int enable, uint8 timeOn, uint8 timeOff)
  */
 void dwt_setlowpowerlistening(int enable)
 {
+    DWT_TRACE_FN();
+
     uint32 pmsc_reg = dwt_read32bitoffsetreg(PMSC_ID, PMSC_CTRL1_OFFSET);
     if (enable)
     {
@@ -2976,6 +3816,8 @@ void dwt_setlowpowerlistening(int enable)
  */
 void dwt_setsnoozetime(uint8 snooze_time)
 {
+    DWT_TRACE_FN();
+
     dwt_write8bitoffsetreg(PMSC_ID, PMSC_SNOZT_OFFSET, snooze_time);
 }
 
@@ -3000,6 +3842,8 @@ void dwt_setsnoozetime(uint8 snooze_time)
  */
 int dwt_rxenable(int mode)
 {
+    DWT_TRACE_FN();
+
     uint16 temp ;
     uint8 temp1 ;
 
@@ -3016,6 +3860,7 @@ int dwt_rxenable(int mode)
     }
 
     dwt_write16bitoffsetreg(SYS_CTRL_ID, SYS_CTRL_OFFSET, temp);
+    pdw1000local->rxArmed = 1;
 
     if (mode & DWT_START_RX_DELAYED) // check for errors
     {
@@ -3027,6 +3872,7 @@ int dwt_rxenable(int mode)
             if((mode & DWT_IDLE_ON_DLY_ERR) == 0) // if DWT_IDLE_ON_DLY_ERR not set then re-enable receiver
             {
                 dwt_write16bitoffsetreg(SYS_CTRL_ID, SYS_CTRL_OFFSET, SYS_CTRL_RXENAB);
+                pdw1000local->rxArmed = 1;
             }
             return DWT_ERROR; // return warning indication
         }
@@ -3051,6 +3897,8 @@ int dwt_rxenable(int mode)
  */
 void dwt_setrxtimeout(uint16 time)
 {
+    DWT_TRACE_FN();
+
     uint8 temp ;
 
     temp = dwt_read8bitoffsetreg(SYS_CFG_ID, 3); // Read at offset 3 to get the upper byte only
@@ -3093,6 +3941,8 @@ void dwt_setrxtimeout(uint16 time)
  */
 void dwt_setpreambledetecttimeout(uint16 timeout)
 {
+    DWT_TRACE_FN();
+
     dwt_write16bitoffsetreg(DRX_CONF_ID, DRX_PRETOC_OFFSET, timeout);
 }
 
@@ -3123,6 +3973,8 @@ void dwt_setpreambledetecttimeout(uint16 timeout)
  */
 void dwt_setinterrupt(uint32 bitmask, uint8 operation)
 {
+    DWT_TRACE_FN();
+
     decaIrqStatus_t stat ;
     uint32 mask ;
 
@@ -3163,6 +4015,8 @@ void dwt_setinterrupt(uint32 bitmask, uint8 operation)
  */
 void dwt_configeventcounters(int enable)
 {
+    DWT_TRACE_FN();
+
     // Need to clear and disable, can't just clear
     dwt_write8bitoffsetreg(DIG_DIAG_ID, EVC_CTRL_OFFSET, (uint8)(EVC_CLR));
 
@@ -3186,6 +4040,8 @@ void dwt_configeventcounters(int enable)
  */
 void dwt_readeventcounters(dwt_deviceentcnts_t *counters)
 {
+    DWT_TRACE_FN();
+
     uint32 temp;
 
     temp= dwt_read32bitoffsetreg(DIG_DIAG_ID, EVC_PHE_OFFSET); // Read sync loss (31-16), PHE (15-0)
@@ -3227,11 +4083,17 @@ void dwt_readeventcounters(dwt_deviceentcnts_t *counters)
  */
 void dwt_rxreset(void)
 {
+    DWT_TRACE_FN();
+
+    dwt_batchbegin();
+
     // Set RX reset
     dwt_write8bitoffsetreg(PMSC_ID, PMSC_CTRL0_SOFTRESET_OFFSET, PMSC_CTRL0_RESET_RX);
 
     // Clear RX reset
     dwt_write8bitoffsetreg(PMSC_ID, PMSC_CTRL0_SOFTRESET_OFFSET, PMSC_CTRL0_RESET_CLEAR);
+
+    dwt_batchcommit();
 }
 
 /*! ------------------------------------------------------------------------------------------------------------------
@@ -3247,6 +4109,8 @@ void dwt_rxreset(void)
  */
 void dwt_softreset(void)
 {
+    DWT_TRACE_FN();
+
     _dwt_disablesequencing();
 
     // Clear any AON auto download bits (as reset will trigger AON download)
@@ -3266,7 +4130,12 @@ void dwt_softreset(void)
     // Clear the reset bits
     dwt_write8bitoffsetreg(PMSC_ID, PMSC_CTRL0_SOFTRESET_OFFSET, PMSC_CTRL0_RESET_CLEAR);
 
+    // All the registers are back to their default values
+    dwt_invalidatecache();
+
     pdw1000local->wait4resp = 0;
+    pdw1000local->rxArmed = 0;
+    pdw1000local->txPending = 0;
 }
 
 /*! ------------------------------------------------------------------------------------------------------------------
@@ -3283,6 +4152,8 @@ void dwt_softreset(void)
  */
 void dwt_setxtaltrim(uint8 value)
 {
+    DWT_TRACE_FN();
+
     // The 3 MSb in this 8-bit register must be kept to 0b011 to avoid any malfunction.
     uint8 reg_val = (3 << 5) | (value & FS_XTALT_MASK);
     dwt_write8bitoffsetreg(FS_CTRL_ID, FS_XTALT_OFFSET, reg_val);
@@ -3319,6 +4190,8 @@ uint8 dwt_getxtaltrim(void)
  */
 void dwt_configcwmode(uint8 chan)
 {
+    DWT_TRACE_FN();
+
 #ifdef DWT_API_ERROR_CHECK
     assert((chan >= 1) && (chan <= 7) && (chan != 6));
 #endif
@@ -3371,6 +4244,8 @@ void dwt_configcwmode(uint8 chan)
  */
 void dwt_configcontinuousframemode(uint32 framerepetitionrate)
 {
+    DWT_TRACE_FN();
+
     //
     // Disable TX/RX RF block sequencing (needed for continuous frame mode)
     //
@@ -3420,6 +4295,8 @@ void dwt_configcontinuousframemode(uint32 framerepetitionrate)
  */
 uint16 dwt_readtempvbat(uint8 fastSPI)
 {
+    DWT_TRACE_FN();
+
     uint8 wr_buf[2];
     uint8 vbat_raw;
     uint8 temp_raw;
@@ -3599,6 +4476,8 @@ uint8 dwt_convertvoltstoraw(int32 externalmvolt)
  */
 uint8 dwt_readwakeuptemp(void)
 {
+    DWT_TRACE_FN();
+
     return dwt_read8bitoffsetreg(TX_CAL_ID, TC_SARL_SAR_LTEMP_OFFSET);
 }
 
@@ -3617,6 +4496,8 @@ uint8 dwt_readwakeuptemp(void)
  */
 uint8 dwt_readwakeupvbat(void)
 {
+    DWT_TRACE_FN();
+
     return dwt_read8bitoffsetreg(TX_CAL_ID, TC_SARL_SAR_LVBAT_OFFSET);
 }
 
@@ -17,6 +17,7 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
 
 #ifndef uint8
 #ifndef _DECA_UINT8_
@@ -60,6 +61,13 @@ typedef signed long int32;
 #endif
 #endif
 
+#ifndef uint64
+#ifndef _DECA_UINT64_
+#define _DECA_UINT64_
+typedef uint64_t uint64;
+#endif
+#endif
+
 #ifndef DWT_NUM_DW_DEV
 #define DWT_NUM_DW_DEV (1)
 #endif
@@ -110,6 +118,14 @@ typedef signed long int32;
 #define DWT_START_TX_DELAYED        1
 #define DWT_RESPONSE_EXPECTED       2
 
+// Causes of a delayed transmission not started by dwt_starttx(), see dwt_gettxlatecause(). These are the only two ways
+// dwt_starttx() fails: an immediate transmission is always started, and a transmit buffer error (TXBERR) is raised during
+// the transmission, after dwt_starttx() has returned, so it has no class here.
+#define DWT_TXLATE_NONE             0    // no failure
+#define DWT_TXLATE_SCHEDULE         1    // TXPUTE: the delayed time was too close to power up the transmitter
+#define DWT_TXLATE_HPW              2    // HPDWARN: the delayed time had passed (it is more than half a period away)
+#define DWT_TXLATE_NUM              3
+
 #define DWT_START_RX_IMMEDIATE  0
 #define DWT_START_RX_DELAYED    1    // Set up delayed RX, if "late" error triggers, then the RX will be enabled immediately
 #define DWT_IDLE_ON_DLY_ERR     2    // If delayed RX failed due to "late" error then if this
@@ -216,6 +232,9 @@ typedef struct
     uint16 datalength;  //length of frame
     uint8  fctrl[2];    //frame control bytes
     uint8  rx_flags;    //RX frame flags, see above
+    uint8  rx_stamp[5]; //RX timestamp (adjusted time of arrival, 40 bits, least significant byte first), valid for RX good frame events
+    uint64 rx_ts;       //the same RX timestamp, as a number
+    uint8 *rx_data;     //received frame (datalength bytes) when read by the ISR, see dwt_setcallbackrxbuffer(), NULL otherwise
 } dwt_cb_data_t;
 
 // Call-back type for all events
@@ -1144,6 +1163,23 @@ int dwt_spicswakeup(uint8 *buff, uint16 length);
  */
 void dwt_setcallbacks(dwt_cb_t cbTxDone, dwt_cb_t cbRxOk, dwt_cb_t cbRxTo, dwt_cb_t cbRxErr);
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_setcallbackrxbuffer()
+ *
+ * @brief This function is used to give dwt_isr() a buffer to read the received frames into. The frame is then read in the
+ * same batch as the status clear and passed to the RX good frame callback in cbData.rx_data, so that the callback does not
+ * need to call dwt_readrxdata(). A frame longer than the buffer is not read and cbData.rx_data is NULL.
+ *
+ * input parameters
+ * @param buffer - the buffer (NULL to stop reading the frames in the ISR)
+ * @param length - the size of the buffer
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_setcallbackrxbuffer(uint8 *buffer, uint16 length);
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_checkirq()
  *
@@ -1412,6 +1448,74 @@ void dwt_readrxdata(uint8 *buffer, uint16 length, uint16 rxBufferOffset);
  */
 void dwt_readaccdata(uint8 *buffer, uint16 length, uint16 rxBufferOffset);
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_readrxdata_async()
+ *
+ * @brief This is the non-blocking version of dwt_readrxdata(). It starts the read of the RX buffer and returns while
+ *        the SPI transfer is still in flight, so that the CPU can do other work (e.g. prepare the next TX frame).
+ *        Completion must be checked with dwt_asyncdone() or waited for with dwt_asyncwait() before the buffer is used
+ *        and before any other driver call is made. Completion must be collected from the calling thread.
+ *
+ * NOTE: On the DWM1001 the transfer only overlaps the CPU work if the application enables CONFIG_SPI_ASYNC=y and
+ *       CONFIG_POLL=y in its prj.conf, see readfromspi_async(). Without them this call returns once the data is read.
+ *
+ * input parameters
+ * @param buffer - the buffer into which the data will be read, it must stay valid until the transfer completes
+ * @param length - the length of data to read (in bytes)
+ * @param rxBufferOffset - the offset in the rx buffer from which to read the data
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS if the transfer was started, or DWT_ERROR if another asynchronous transfer is pending
+ */
+int dwt_readrxdata_async(uint8 *buffer, uint16 length, uint16 rxBufferOffset);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_readaccdata_async()
+ *
+ * @brief This is the non-blocking version of dwt_readaccdata(). The accumulator clocks are forced on before the
+ *        transfer is started and reverted when completion is collected by dwt_asyncdone() or dwt_asyncwait().
+ *
+ * NOTE: As for dwt_readaccdata(), the first octet output is a dummy octet that should be discarded.
+ *
+ * input parameters
+ * @param buffer - the buffer into which the data will be read, it must stay valid until the transfer completes
+ * @param length - the length of data to read (in bytes)
+ * @param accOffset - the offset in the acc buffer from which to read the data
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS if the transfer was started, or DWT_ERROR if another asynchronous transfer is pending
+ */
+int dwt_readaccdata_async(uint8 *buffer, uint16 length, uint16 accOffset);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_asyncdone()
+ *
+ * @brief This is used to poll the asynchronous transfer started by dwt_readrxdata_async() or dwt_readaccdata_async().
+ *        When the transfer has completed, the driver state is restored and the SPI bus is released.
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * returns 1 if no transfer is pending (i.e. the last one has completed), 0 if it is still in flight
+ */
+int dwt_asyncdone(void);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_asyncwait()
+ *
+ * @brief This is used to block until the pending asynchronous transfer (if any) has completed.
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_asyncwait(void);
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_readcarrierintegrator()
  *
@@ -1813,6 +1917,121 @@ void dwt_readfromdevice
     uint8   *buffer             // input parameter - pointer to buffer in which to return the read data.
 ) ;
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_batchbegin()
+ *
+ * @brief  this function opens a batch of register accesses. Until the matching dwt_batchcommit() call, writes done through
+ * dwt_writetodevice() (and so through all the dwt_writeXXbitoffsetreg() functions and the API calls using them) are queued
+ * instead of being issued, and reads may be queued with dwt_batchread(). dwt_batchcommit() then issues all the queued accesses
+ * back to back in a single call to the platform layer (see transferspi()). The order of the accesses is preserved: a plain
+ * read done while the batch is open (e.g. dwt_readfromdevice()) first issues what is already queued.
+ * The DW1000 mutex is held (see decamutexon()) from dwt_batchbegin() to dwt_batchcommit(), so a batch should be kept short.
+ * Batches can be nested, only the outermost dwt_batchcommit() issues the queued accesses.
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_batchbegin(void);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_batchread()
+ *
+ * @brief  this function queues a read of a DW1000 register in the batch opened by dwt_batchbegin(). The read data is available
+ * in the buffer once dwt_batchcommit() returns. If no batch is open, the read is done immediately.
+ *
+ * input parameters:
+ * @param recordNumber  - ID of register file or buffer being accessed
+ * @param index         - byte index into register file or buffer being accessed
+ * @param length        - number of bytes being read
+ * @param buffer        - pointer to buffer in which to return the read data, it must stay valid until dwt_batchcommit() returns
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_batchread(uint16 recordNumber, uint16 index, uint32 length, uint8 *buffer);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_batchcommit()
+ *
+ * @brief  this function closes the batch opened by dwt_batchbegin() and issues all the queued register accesses.
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS for success, or DWT_ERROR for error
+ */
+int dwt_batchcommit(void);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_invalidatecache()
+ *
+ * @brief  this function discards the content of the shadow register cache. The driver keeps a copy of the configuration
+ * registers it owns (SYS_CFG, SYS_MASK, GPIO_MODE, PMSC_CTRL0 and PMSC_CTRL1) so that read-modify-write sequences do not need
+ * to read them over SPI. The cache is invalidated by dwt_initialise(), dwt_softreset(), dwt_entersleep() and
+ * dwt_spicswakeup(); the application must call this function after any other event which resets the device registers
+ * (e.g. wake-up through the WAKEUP pin, hard reset through the RSTn pin).
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_invalidatecache(void);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_readcachestats()
+ *
+ * @brief  this function reads the shadow register cache counters, see dwt_invalidatecache(). The counters are cumulative
+ * since dwt_initialise(): the number of SPI reads saved over a sequence of operations (e.g. a ranging exchange) is the
+ * difference of the hit counter before and after it.
+ *
+ * input parameters
+ *
+ * output parameters
+ * @param hits      - number of register reads served from the cache
+ * @param misses    - number of reads of cached registers that needed an SPI access
+ *
+ * no return value
+ */
+void dwt_readcachestats(uint32 *hits, uint32 *misses);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_gettxlatecause()
+ *
+ * @brief  this function returns the cause of the last delayed transmission which dwt_starttx() could not start. When it
+ * fails, dwt_starttx() cancels the transmission and clears the HPDWARN and TXPUTE events, so that the application can
+ * program a new transmission time straight away. Errors of a transmission which did start, such as a transmit buffer
+ * error (TXBERR), are not classified: they are raised after dwt_starttx() has returned.
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * returns DWT_TXLATE_NONE if there was none since dwt_initialise(), DWT_TXLATE_SCHEDULE or DWT_TXLATE_HPW otherwise
+ */
+uint8 dwt_gettxlatecause(void);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_readtxlatecounters()
+ *
+ * @brief  this function reads the counters of delayed transmissions which dwt_starttx() could not start, per cause, see
+ * dwt_gettxlatecause(). The counters are cumulative since dwt_initialise().
+ *
+ * input parameters
+ *
+ * output parameters
+ * @param counts    - array of DWT_TXLATE_NUM counters, indexed by DWT_TXLATE_xxx (DWT_TXLATE_NONE stays 0)
+ *
+ * no return value
+ */
+void dwt_readtxlatecounters(uint32 *counts);
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_read32bitoffsetreg()
  *
@@ -1917,6 +2136,16 @@ void dwt_write8bitoffsetreg(int regFileID, int regOffset, uint8 regval);
  ****************************************************************************************************************************************************/
 
 
+// Structure describing one SPI transaction (header followed by data) of a batch, see transferspi()
+typedef struct
+{
+    uint16          headerLength;   // Number of bytes of header
+    const uint8    *headerBuffer;   // Pointer to the header bytes
+    uint32          bodyLength;     // Number of bytes of data being written or read
+    uint8          *bodyBuffer;     // Pointer to the data to write, or to the buffer in which to return the read data
+    uint8           read;           // 1 for a read transaction, 0 for a write transaction
+} deca_spi_xfer_t ;
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn writetospi()
  *
@@ -1965,6 +2194,96 @@ int writetospi(uint16 headerLength, const uint8 *headerBuffer, uint32 bodylength
  */
 int readfromspi(uint16 headerLength, const uint8 *headerBuffer, uint32 readlength, uint8 *readBuffer);
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn transferspi()
+ *
+ * @brief
+ * Low level abstract function to issue a list of SPI transactions back to back. Each transaction is a separate DW1000
+ * access (the chip select is toggled between them), but the whole list is issued under a single acquisition of the
+ * DW1000 mutex and of the SPI bus, in the given order.
+ *
+ * Note: The body of this function is defined in deca_spi.c and is platform specific
+ *
+ * input parameters:
+ * @param xfers         - pointer to the array of transactions to issue
+ * @param count         - number of transactions in the array
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS for success, or DWT_ERROR for error
+ */
+int transferspi(const deca_spi_xfer_t *xfers, uint16 count);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn readfromspi_async()
+ *
+ * @brief
+ * Non-blocking version of readfromspi(). The transfer is started and the function returns immediately, the data is
+ * available in readBuffer once spi_async_done() returns 1 or spi_async_wait() returns. The DW1000 mutex is held for
+ * the whole transfer and released when completion is collected, so completion must be collected by the caller.
+ * If the platform has no asynchronous SPI support, the transfer is performed synchronously: with Zephyr (deca_spi.c)
+ * that is unless the application sets CONFIG_SPI_ASYNC=y and CONFIG_POLL=y, which spi_transceive_async() and its
+ * completion signal need. The DW1000 model of native_posix (deca_spi_sim.c) completes it after its bus time without.
+ *
+ * Note: The body of this function is defined in deca_spi.c and is platform specific
+ *
+ * input parameters:
+ * @param headerLength  - number of bytes header to write
+ * @param headerBuffer  - pointer to buffer containing the 'headerLength' bytes of header to write
+ * @param readlength    - number of bytes data being read
+ * @param readBuffer    - pointer to buffer to return the data, it must stay valid until the transfer completes
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS for success, or DWT_ERROR for error (e.g. a transfer is already pending)
+ */
+int readfromspi_async(uint16 headerLength, const uint8 *headerBuffer, uint32 readlength, uint8 *readBuffer);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn writetospi_async()
+ *
+ * @brief
+ * Non-blocking version of writetospi(), see readfromspi_async().
+ *
+ * Note: The body of this function is defined in deca_spi.c and is platform specific
+ *
+ * input parameters:
+ * @param headerLength  - number of bytes header being written
+ * @param headerBuffer  - pointer to buffer containing the 'headerLength' bytes of header to be written
+ * @param bodylength    - number of bytes data being written
+ * @param bodyBuffer    - pointer to the data to be written, it must stay valid until the transfer completes
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS for success, or DWT_ERROR for error (e.g. a transfer is already pending)
+ */
+int writetospi_async(uint16 headerLength, const uint8 *headerBuffer, uint32 bodylength, const uint8 *bodyBuffer);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn spi_async_done()
+ *
+ * @brief
+ * Checks the completion of the transfer started by readfromspi_async()/writetospi_async(). On completion the DW1000
+ * mutex taken when the transfer was started is released.
+ *
+ * Note: The body of this function is defined in deca_spi.c and is platform specific
+ *
+ * returns 1 if no transfer is pending, 0 if it is still in flight
+ */
+int spi_async_done(void);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn spi_async_wait()
+ *
+ * @brief
+ * Blocks until the transfer started by readfromspi_async()/writetospi_async() has completed, see spi_async_done().
+ *
+ * Note: The body of this function is defined in deca_spi.c and is platform specific
+ *
+ * returns DWT_SUCCESS for success, or DWT_ERROR if the transfer failed
+ */
+int spi_async_wait(void);
+
 // ---------------------------------------------------------------------------
 //
 // NB: The purpose of the deca_mutex.c file is to provide for microprocessor interrupt enable/disable, this is used for
@@ -2015,6 +2334,25 @@ decaIrqStatus_t decamutexon(void) ;
  */
 void decamutexoff(decaIrqStatus_t s) ;
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn decamutexstats()
+ *
+ * @brief This function reads the critical section statistics: how many outermost decamutexon()/decamutexoff() pairs
+ * were completed and the longest time the DW1000 mutex was held by one of them.
+ *
+ * Note: The body of this function is defined in deca_mutex.c and is platform specific
+ *
+ * input parameters:
+ * @param reset - if non-zero, the statistics are cleared after being read
+ *
+ * output parameters
+ * @param maxHold - the maximum hold time, in microseconds
+ * @param count   - the number of critical sections
+ *
+ * no return value
+ */
+void decamutexstats(uint32 *maxHold, uint32 *count, int reset) ;
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn deca_sleep()
  *
@@ -17,6 +17,8 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
+
 #ifndef uint8
 #ifndef _DECA_UINT8_
 #define _DECA_UINT8_
@@ -59,6 +61,20 @@ typedef signed long int32;
 #endif
 #endif
 
+#ifndef uint64
+#ifndef _DECA_UINT64_
+#define _DECA_UINT64_
+typedef uint64_t uint64;
+#endif
+#endif
+
+#ifndef int64
+#ifndef _DECA_INT64_
+#define _DECA_INT64_
+typedef int64_t int64;
+#endif
+#endif
+
 #ifndef NULL
 #define NULL ((void *)0UL)
 #endif
@@ -33,6 +33,7 @@
 #include "deca_regs.h"
 #include "deca_spi.h"
 #include "port.h"
+#include "deca_timestamp.h"
 
 // zephyr includes
 #include <zephyr.h>
@@ -149,11 +150,6 @@ static double distance;
 /* String used to display measured distance on console. */
 char dist_str[16] = {0};
 
-/* Declaration of static functions. */
-static uint64 get_tx_timestamp_u64(void);
-static uint64 get_rx_timestamp_u64(void);
-static void final_msg_get_ts(const uint8 *ts_field, uint32 *ts);
-
 /*! --------------------------------------------------------------------------
  * @fn main()
  *
@@ -248,7 +244,7 @@ int dw_main(void)
                 int ret;
 
                 /* Retrieve poll reception timestamp. */
-                poll_rx_ts = get_rx_timestamp_u64();
+                poll_rx_ts = ts_read_rx();
 
                 /* Retreive frame sequence number */
                 memcpy(&frame_seq_nb_rx, &rx_buffer[2], 1);
@@ -317,33 +313,28 @@ int dw_main(void)
                     if (memcmp(rx_buffer, rx_final_msg, ALL_MSG_COMMON_LEN) == 0) {
 
                         uint32 poll_tx_ts, resp_rx_ts, final_tx_ts;
-                        uint32 poll_rx_ts_32, resp_tx_ts_32, final_rx_ts_32;
                         double Ra, Rb, Da, Db;
                         int64 tof_dtu;
 
                         /* Retrieve response transmission and final reception 
                          * timestamps.
                          */
-                        resp_tx_ts = get_tx_timestamp_u64();
-                        final_rx_ts = get_rx_timestamp_u64();
+                        resp_tx_ts = ts_read_tx();
+                        final_rx_ts = ts_read_rx();
 
                         /* Get timestamps embedded in the final message. */
-                        final_msg_get_ts(&rx_buffer[FINAL_MSG_POLL_TX_TS_IDX], &poll_tx_ts);
-                        final_msg_get_ts(&rx_buffer[FINAL_MSG_RESP_RX_TS_IDX], &resp_rx_ts);
-                        final_msg_get_ts(&rx_buffer[FINAL_MSG_FINAL_TX_TS_IDX], &final_tx_ts);
+                        poll_tx_ts = ts_get32(&rx_buffer[FINAL_MSG_POLL_TX_TS_IDX]);
+                        resp_rx_ts = ts_get32(&rx_buffer[FINAL_MSG_RESP_RX_TS_IDX]);
+                        final_tx_ts = ts_get32(&rx_buffer[FINAL_MSG_FINAL_TX_TS_IDX]);
 
                         /* Compute time of flight. 32-bit subtractions give 
                          * correct answers even if clock has wrapped. 
                          * See NOTE 12 below.
                          */
-                        poll_rx_ts_32 = (uint32)poll_rx_ts;
-                        resp_tx_ts_32 = (uint32)resp_tx_ts;
-                        final_rx_ts_32 = (uint32)final_rx_ts;
-                        
-                        Ra = (double)(resp_rx_ts - poll_tx_ts);
-                        Rb = (double)(final_rx_ts_32 - resp_tx_ts_32);
-                        Da = (double)(final_tx_ts - resp_rx_ts);
-                        Db = (double)(resp_tx_ts_32 - poll_rx_ts_32);
+                        Ra = (double)ts_interval32(resp_rx_ts, poll_tx_ts);
+                        Rb = (double)ts_interval32(final_rx_ts, resp_tx_ts);
+                        Da = (double)ts_interval32(final_tx_ts, resp_rx_ts);
+                        Db = (double)ts_interval32(resp_tx_ts, poll_rx_ts);
                         tof_dtu = (int64)((Ra * Rb - Da * Db) / (Ra + Rb + Da + Db));
 
                         tof = tof_dtu * DWT_TIME_UNITS;
@@ -382,74 +373,6 @@ int dw_main(void)
     }
 }
 
-/*! --------------------------------------------------------------------------
- * @fn get_tx_timestamp_u64()
- *
- * @brief Get the TX time-stamp in a 64-bit variable.
- *        /!\ This function assumes that length of time-stamps is 40 bits, 
- *            for both TX and RX!
- *
- * @param  none
- *
- * @return  64-bit value of the read time-stamp.
- */
-static uint64 get_tx_timestamp_u64(void)
-{
-    uint8 ts_tab[5];
-    uint64 ts = 0;
-
-    dwt_readtxtimestamp(ts_tab);
-    for (int i = 4; i >= 0; i--) {
-        ts <<= 8;
-        ts |= ts_tab[i];
-    }
-    return ts;
-}
-
-/*! --------------------------------------------------------------------------
- * @fn get_rx_timestamp_u64()
- *
- * @brief Get the RX time-stamp in a 64-bit variable.
- *        /!\ This function assumes that length of time-stamps is 40 bits, 
- *             for both TX and RX!
- *
- * @param  none
- *
- * @return  64-bit value of the read time-stamp.
- */
-static uint64 get_rx_timestamp_u64(void)
-{
-    uint8 ts_tab[5];
-    uint64 ts = 0;
-
-    dwt_readrxtimestamp(ts_tab);
-    for (int i = 4; i >= 0; i--) {
-        ts <<= 8;
-        ts |= ts_tab[i];
-    }
-    return ts;
-}
-
-/*! --------------------------------------------------------------------------
- * @fn final_msg_get_ts()
- *
- * @brief Read a given timestamp value from the final message. 
- *        In the timestamp fields of the final message, the least
- *        significant byte is at the lower address.
- *
- * @param  ts_field  pointer on the first byte of the timestamp field to read
- *         ts  timestamp value
- *
- * @return none
- */
-static void final_msg_get_ts(const uint8 *ts_field, uint32 *ts)
-{
-    *ts = 0;
-    for (int i = 0; i < FINAL_MSG_TS_LEN; i++) {
-        *ts += ts_field[i] << (i * 8);
-    }
-}
-
 /*****************************************************************************************************************************************************
  * NOTES:
  *
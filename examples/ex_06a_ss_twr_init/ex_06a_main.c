@@ -32,6 +32,7 @@
 #include "deca_regs.h"
 #include "deca_spi.h"
 #include "port.h"
+#include "deca_timestamp.h"
 
 // zephyr includes
 #include <zephyr.h>
@@ -121,9 +122,6 @@ static double distance;
 /* String used to display measured distance on console (16 characters maximum). */
 char dist_str[16] = {0};
 
-/* Declaration of static functions. */
-static void resp_msg_get_ts(uint8 *ts_field, uint32 *ts);
-
 /*! --------------------------------------------------------------------------
  * @fn main()
  *
@@ -249,14 +247,14 @@ int dw_main(void) {
                     (FREQ_OFFSET_MULTIPLIER * HERTZ_TO_PPM_MULTIPLIER_CHAN_2 / 1.0e6) ;
 
                 /* Get timestamps embedded in response message. */
-                resp_msg_get_ts(&rx_buffer[RESP_MSG_POLL_RX_TS_IDX], &poll_rx_ts);
-                resp_msg_get_ts(&rx_buffer[RESP_MSG_RESP_TX_TS_IDX], &resp_tx_ts);
+                poll_rx_ts = ts_get32(&rx_buffer[RESP_MSG_POLL_RX_TS_IDX]);
+                resp_tx_ts = ts_get32(&rx_buffer[RESP_MSG_RESP_TX_TS_IDX]);
 
                 /* Compute time of flight and distance, using clock offset ratio 
                  * to correct for differing local and remote clock rates
                  */
-                rtd_init = resp_rx_ts - poll_tx_ts;
-                rtd_resp = resp_tx_ts - poll_rx_ts;
+                rtd_init = ts_interval32(resp_rx_ts, poll_tx_ts);
+                rtd_resp = ts_interval32(resp_tx_ts, poll_rx_ts);
 
                 tof = ((rtd_init - rtd_resp * 
                        (1 - clockOffsetRatio)) / 2.0) * DWT_TIME_UNITS;
@@ -290,26 +288,6 @@ int dw_main(void) {
     }
 }
 
-/*! ---------------------------------------------------------------------------
- * @fn resp_msg_get_ts()
- *
- * @brief Read a given timestamp value from the response message. 
- *        In the timestamp fields of the response message, the
- *        least significant byte is at the lower address.
- *
- * @param  ts_field  pointer on the first byte of the timestamp field to get
- *         ts  timestamp value
- *
- * @return none
- */
-static void resp_msg_get_ts(uint8 *ts_field, uint32 *ts)
-{
-    *ts = 0;
-    for (int i = 0; i < RESP_MSG_TS_LEN; i++) {
-        *ts += ts_field[i] << (i * 8);
-    }
-}
-
 #endif  /*  EX_06A_DEF */
 
 /******************************************************************************
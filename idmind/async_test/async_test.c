@@ -0,0 +1,158 @@
+/*! ----------------------------------------------------------------------------
+ *  @file       async_test.c
+ *  @brief      Test of the asynchronous SPI reads on the DW1000 model
+ *  @author     cneves
+ *
+ *  native_posix only, run with DW1000_SIM_SPI_TIME=1 so that the transfers
+ *  take their bus time, see README.rst. Fills the RX buffer and the
+ *  accumulator memory of the model with a pattern, reads them back with
+ *  dwt_readrxdata_async() and dwt_readaccdata_async() while the CPU goes on
+ *  working, and checks:
+ *  - that the transfer is in flight after it is started, and that the
+ *    buffer is only written when its completion is collected;
+ *  - that a second asynchronous transfer is refused while one is in flight;
+ *  - that a synchronous access issued meanwhile waits for it;
+ *  - the data read.
+ *  Exits with 1 if any check fails.
+ */
+
+#include <string.h>
+
+#include "deca_device_api.h"
+#include "deca_regs.h"
+#include "deca_spi.h"
+#include "port.h"
+
+#include <zephyr.h>
+#include <sys/printk.h>
+#include "posix_board_if.h"
+
+#define APP_NAME "ASYNC TEST v1.0\n"
+
+#define RX_READ_LEN     1016
+#define ACC_READ_LEN    2000
+#define ACC_READ_OFFSET 100
+#define SENTINEL        0xA5
+
+static uint8 pattern[ACC_MEM_LEN];
+static uint8 buffer[ACC_MEM_LEN];
+static uint8 other[16];
+
+static int failures;
+
+/*! --------------------------------------------------------------------------
+ * @fn check()
+ * @brief Prints the outcome of a check, and counts the failures
+ * @param  ok  outcome
+ *         what  the check
+ * @return none
+ */
+static void check(int ok, const char *what)
+{
+    printk("%-58s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok) {
+        failures++;
+    }
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn untouched()
+ * @brief Checks that the read buffer still holds the sentinel
+ * @param  len  bytes to check
+ * @return 1 if it does
+ */
+static int untouched(uint32 len)
+{
+    for (uint32 i = 0; i < len; i++) {
+        if (buffer[i] != SENTINEL) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn test_rx()
+ * @brief Reads the RX buffer asynchronously, polling dwt_asyncdone() and
+ *          counting the work done meanwhile
+ */
+static void test_rx(void)
+{
+    uint32 work = 0;
+    uint32 sum = 0;
+    int in_flight;
+
+    dwt_writetodevice(RX_BUFFER_ID, 0, RX_READ_LEN, pattern);
+    memset(buffer, SENTINEL, sizeof(buffer));
+
+    check(dwt_readrxdata_async(buffer, RX_READ_LEN, 0) == DWT_SUCCESS, "rx: dwt_readrxdata_async() started");
+    in_flight = !dwt_asyncdone();
+    check(in_flight, "rx: in flight after the start");
+    check(!in_flight || untouched(RX_READ_LEN), "rx: buffer not written while in flight");
+    check(!in_flight || (dwt_readrxdata_async(other, sizeof(other), 0) == DWT_ERROR),
+          "rx: second transfer refused while in flight");
+
+    /* The CPU goes on with its work until the transfer completes */
+    while (!dwt_asyncdone()) {
+        sum += work * work;
+        work++;
+    }
+    printk("rx: %u bytes, %u iterations of work meanwhile (%u)\n", RX_READ_LEN, work, sum & 1);
+    check(work > 0, "rx: work done during the transfer");
+    check(memcmp(buffer, pattern, RX_READ_LEN) == 0, "rx: data");
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn test_acc()
+ * @brief Reads the accumulator asynchronously, issues a synchronous read
+ *          meanwhile, and waits for it with dwt_asyncwait()
+ */
+static void test_acc(void)
+{
+    uint32 dev_id;
+    int in_flight;
+
+    dwt_writetodevice(ACC_MEM_ID, 0, ACC_MEM_LEN, pattern);
+    memset(buffer, SENTINEL, sizeof(buffer));
+
+    check(dwt_readaccdata_async(buffer, ACC_READ_LEN, ACC_READ_OFFSET) == DWT_SUCCESS,
+          "acc: dwt_readaccdata_async() started");
+    in_flight = !dwt_asyncdone();
+    check(in_flight, "acc: in flight after the start");
+    check(!in_flight || untouched(ACC_READ_LEN), "acc: buffer not written while in flight");
+
+    /* The bus is taken: the synchronous read waits for the end of the transfer */
+    dev_id = dwt_readdevid();
+    check(dev_id == DWT_DEVICE_ID, "acc: synchronous read meanwhile");
+
+    dwt_asyncwait();
+    check(dwt_asyncdone(), "acc: completed after dwt_asyncwait()");
+    check(memcmp(buffer, &pattern[ACC_READ_OFFSET], ACC_READ_LEN) == 0, "acc: data");
+}
+
+int dw_main(void)
+{
+    printk(APP_NAME);
+
+    openspi();
+    reset_DW1000();
+
+    port_set_dw1000_slowrate();
+    if (dwt_initialise(DWT_LOADNONE) == DWT_ERROR) {
+        printk("err - init failed\n");
+        posix_exit(1);
+    }
+
+    /* Slow rate, so that the transfers are long against the work */
+    for (uint32 i = 0; i < sizeof(pattern); i++) {
+        pattern[i] = (uint8)((i * 7) ^ (i >> 8) ^ 0x5A);
+    }
+
+    test_rx();
+    test_acc();
+
+    printk("%s\n", failures ? "FAILED" : "passed");
+    posix_exit(failures ? 1 : 0);
+
+    return 0;
+}
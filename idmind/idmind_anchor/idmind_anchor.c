@@ -18,14 +18,14 @@ LOG_MODULE_REGISTER(main);
 
 /* Default communication configuration. */
 static dwt_config_t config = {
-    5,               /* Channel number. */
+    UWB_CHANNEL,     /* Channel number. */
     DWT_PRF_64M,     /* Pulse repetition frequency. */
     DWT_PLEN_128,    /* Preamble length. Used in TX only. */
     DWT_PAC8,        /* Preamble acquisition chunk size. Used in RX only. */
     9,               /* TX preamble code. Used in TX only. */
     9,               /* RX preamble code. Used in RX only. */
     1,               /* 0 to use standard SFD, 1 to use non-standard SFD. */
-    DWT_BR_6M8,      /* Data rate. */
+    UWB_DATA_RATE,   /* Data rate. */
     DWT_PHRMODE_STD, /* PHY header mode. */
     (129)            /* SFD timeout (preamble length + 1 + SFD length - PAC size).
                       * Used in RX only. */
@@ -74,17 +74,6 @@ void print_header(void)
     return;
 }
 
-/*! --------------------------------------------------------------------------
- * @fn enable_flag_interrupt()
- * @brief Activates a flag when an interrupt is detected
- * @param  none
- * @return 0 if success, error code otherwise
- */
-void enable_flag_interrupt(void){
-    printk("Interrupt detected\n");
-    flag_interrupt = true;
-}
-
 /*! --------------------------------------------------------------------------
  * @fn start_dwm()
  * @brief Opens communication with DWM, reset and initialize
@@ -95,7 +84,7 @@ int start_dwm(void)
 {
     printk("Starting DWM Communication with ");
     /* Prepare for callbacks/interrupts */
-    port_set_deca_isr(enable_flag_interrupt);
+    port_set_deca_isr(dwt_isr);
     
     /* Open SPI to communicate with DWM1001 */
     openspi();
@@ -108,7 +97,7 @@ int start_dwm(void)
         k_sleep(K_MSEC(500)); // allow logging to run.
         while (1) { };
     }
-    port_set_dw1000_fastrate();
+    port_set_dw1000_maxrate();
     printk("Success!\n");
     return 0;
 }
@@ -126,11 +115,11 @@ int config_dwm(void)
     dwt_configure(&config);
 
     /* Set callbacks for TxDone, Rx OK, Rx Timeout, Rx Err */
-    // dwt_setcallbacks(tx_done_cb, rx_ok_cb, rx_timeout_cb, rx_err_cb);
+    dwt_setcallbacks(tx_done_cb, rx_ok_cb, rx_timeout_cb, rx_err_cb);
 
-    // dwt_setinterrupt(DWT_INT_TFRS | DWT_INT_RFCG | DWT_INT_RFTO | 
-    //                  DWT_INT_RXPTO | DWT_INT_RPHE | DWT_INT_RFCE | 
-    //                  DWT_INT_RFSL | DWT_INT_SFDT, 1);
+    dwt_setinterrupt(DWT_INT_TFRS | DWT_INT_RFCG | DWT_INT_RFTO | 
+                     DWT_INT_RXPTO | DWT_INT_RPHE | DWT_INT_RFCE | 
+                     DWT_INT_RFSL | DWT_INT_SFDT, 1);
 
     /* Configure DW1000 LEDs */
     dwt_setleds(3);
@@ -140,14 +129,80 @@ int config_dwm(void)
     dwt_settxantennadelay(RX_ANT_DLY);
 
     /* Set expected response's delay and timeout. */
-    dwt_setrxaftertxdelay(TX_TO_RX_DELAY_UUS);
-    dwt_setrxtimeout(RX_RESP_TIMEOUT_UUS);
+    dwt_setrxaftertxdelay(POLL_RX_DLY_UUS(INIT_RX_TO_POLL_TX_DLY_UUS));
+    dwt_setrxtimeout(RANGING_RX_TIMEOUT_UUS);
 
     k_yield();
     printk("Success!\n");
     return 0;
 }
 
+/*! --------------------------------------------------------------------------
+ * @fn print_stats()
+ * @brief Prints the event counters and the register cache hits and misses
+ *        per exchange, and the CPU utilisation and the SPI transactions per
+ *        exchange when built with CONFIG_THREAD_RUNTIME_STATS and
+ *        DECA_SPI_TRACE, since the previous call
+ * @param  none
+ * @return none
+ */
+static void print_stats(void)
+{
+    static anchor_stats_t prev;
+    anchor_stats_t cur;
+    uint32 exchanges;
+
+    anchor_get_stats(&cur);
+    exchanges = (cur.ranges - prev.ranges) + (cur.timeouts - prev.timeouts);
+    printk("Blinks: %u | Ranges: %u | Outliers: %u | Timeouts: %u | Errors: %u | Unexpected: %u | Late: %u | Full: %u\n",
+           cur.blinks - prev.blinks, cur.ranges - prev.ranges, cur.outliers - prev.outliers, cur.timeouts - prev.timeouts,
+           cur.errors - prev.errors, cur.unexpected - prev.unexpected, cur.late - prev.late,
+           cur.full - prev.full);
+    printk("Turnaround: Response %u uus | Late Responses: %u | Retried: %u\n", cur.resp_dly,
+           cur.resp_late - prev.resp_late, cur.retries - prev.retries);
+    printk("Late Tx: schedule %u | HPW %u\n", cur.tx_late[DWT_TXLATE_SCHEDULE] - prev.tx_late[DWT_TXLATE_SCHEDULE],
+           cur.tx_late[DWT_TXLATE_HPW] - prev.tx_late[DWT_TXLATE_HPW]);
+    prev = cur;
+
+#ifdef CONFIG_THREAD_RUNTIME_STATS
+    {
+        static uint64_t prev_busy;
+        static uint32 prev_time;
+        k_thread_runtime_stats_t rt;
+        uint32 now = k_cycle_get_32();
+
+        k_thread_runtime_stats_all_get(&rt);
+        if (prev_time != 0) {
+            printk("CPU: %u%%\n", (uint32)((rt.execution_cycles - prev_busy) * 100 / (uint32)(now - prev_time)));
+        }
+        prev_busy = rt.execution_cycles;
+        prev_time = now;
+    }
+#endif
+    {
+        static uint32 prev_hits, prev_misses;
+        uint32 hits, misses;
+#ifdef DECA_SPI_TRACE
+        static uint32 prev_count;
+        uint32 count = deca_spi_trace_count();
+#endif
+
+        dwt_readcachestats(&hits, &misses);
+        if (exchanges != 0) {
+#ifdef DECA_SPI_TRACE
+            printk("SPI: %u transactions | ", (count - prev_count) / exchanges);
+#endif
+            printk("Register cache: %u hits | %u misses per exchange\n", (hits - prev_hits) / exchanges,
+                   (misses - prev_misses) / exchanges);
+        }
+#ifdef DECA_SPI_TRACE
+        prev_count = count;
+#endif
+        prev_hits = hits;
+        prev_misses = misses;
+    }
+}
+
 /**
  * Application entry point.
  */
@@ -158,147 +213,28 @@ int dw_main(void)
     start_dwm();
     config_dwm();
 
-    /* Initialization of main loop */
-    bool discovery = true;
-    // int seq_nr = 0;
-    uint64 dev_list[] = {0, 0, 0, 0, 0};
-    uint64 ranging_tx_ts = 0;
-    uint64 poll_rx_ts = 0;
-    double tof_dtu = 0;
+    /* From here on the anchor is driven by the DW1000 interrupts */
+    anchor_start();
 
-    /************************************************/
-    /*          Setup Ranging Init Message          */
-    /************************************************/
-    uint8 ranging_init[22];
-    for(int i=0; i<22; i++) ranging_init[i] = 0;
-    // Header
-    ranging_init[0] = 0x41;
-    ranging_init[1] = 0x8C;
-    // Network Name
-    ranging_init[3] = PAN_ID & 0xFF;
-    ranging_init[4] = (PAN_ID >> 8) & 0xFF;
-    // Source address
-    ranging_init[13] = (DEV_ID) & 0xFF;
-    ranging_init[14] = (DEV_ID >> 8) & 0xFF;
-    // Action code
-    ranging_init[15] = 0x20;
-    //Request a response delay
-    ranging_init[18] = (uint8)(POLL_RX_TO_RESP_TX_DLY_UUS & 0xFF);
-    ranging_init[19] = (uint8)((POLL_RX_TO_RESP_TX_DLY_UUS >> 8) & 0xFF);
-
-    /*************************************************/
-    /*          Setup Poll Response Message          */
-    /*************************************************/
-    uint8 resp_msg[16];
-    for(int i=0; i<16; i++) resp_msg[i] = 0;
-    // Header
-    resp_msg[0] = 0x41;
-    resp_msg[1] = 0x88;
-    // Network Name
-    resp_msg[3] = PAN_ID & 0xFF;
-    resp_msg[4] = (PAN_ID >> 8) & 0xFF;
-    // Source address
-    resp_msg[7] = (DEV_ID) & 0xFF;
-    resp_msg[8] = (DEV_ID >> 8) & 0xFF;
-    resp_msg[9] = 0x50;
-
-    /* Loop forever receiving frames. */
-    int iter = 0;
-    uint64 tag_id = 0;
-    uint8 seq_nr = 0;
+    /* Loop forever printing the ranging results. */
+    uint32 stats_time = k_uptime_get_32();
     while (1) {
-        iter++;
-        // printk("============ Iter %d =============\n", iter);
-
-        if(discovery){
-            tag_id = 0;
-            // Anchor waits for blink message
-            dwt_rxenable(DWT_START_RX_IMMEDIATE);
-            if (rx_message(rx_buffer) != 0){
-                // printk("Did not receive Blink message.\n");
-                Sleep(PERIOD);
-                continue;
-            }
-
-            // If message received is Blink, save TAG in dev list
-            if (rx_buffer[0] == 0xC5){
-                // HOW TO USE/SAVE SEQ NUMBER? OR JUST KEEP IN LIST AND WAIT FOR CONTACT AFTER?
-                
-                for(int i=0; i<8; i++) tag_id += (rx_buffer[2+i] << 8*i);
-                printk("Received Blink %u from Tag %llu\n", rx_buffer[1], tag_id);
-                seq_nr = rx_buffer[1];
-                for(int idx=0; idx<5; idx++){
-                    if(dev_list[idx]==0){
-                        dev_list[idx] = tag_id;
-                        printk("Tag %llu added to dev_list[%d].\n", tag_id, idx);
-                        break;
-                    }
-                    if(dev_list[idx] == tag_id){
-                        break;
-                    }
-                }
-            }
-            else{
-                printk("Expected a Blink message, received smothing else:\n");
-                print_msg(rx_buffer, dwt_read32bitreg(RX_FINFO_ID) & RX_FINFO_RXFL_MASK_1023);
-                Sleep(PERIOD);
-                continue;
-            } // end of blink handling
-
-            // THINK OF HOW TO SELECT NEXT DEVICE
-            int dev_idx = 0;
-            uint16 short_tag_id = dev_idx+1;
-
-            // Send ranging_init message
-            ranging_init[2] = seq_nr;
-            for(int idx=0; idx<8; idx++) ranging_init[5+idx] = (dev_list[dev_idx] >> 8*idx) & 0xFF;
-            for(int idx=0; idx<2; idx++) ranging_init[16+idx] = (short_tag_id >> 8*idx) & 0xFF;
-            dwt_writetxdata(22, ranging_init, 0);
-            dwt_writetxfctrl(22, 0, 0);
-            printk("Sending Ranging init.\n");
-            // print_msg(ranging_init, 22);
-            if (dwt_starttx(DWT_START_TX_IMMEDIATE | DWT_RESPONSE_EXPECTED) == DWT_ERROR){
-                printk("Error sending Ranging Init to Tag %llu.\n", dev_list[dev_idx]);
-                Sleep(PERIOD);
-                continue;
-            }
-            else{
-                ranging_tx_ts = get_tx_timestamp_u64();
-                printk("Waiting for Poll Message.\n");
-                discovery = false;
-                Sleep(PERIOD);
-            }
+        anchor_range_t range;
+
+        if (k_msgq_get(&anchor_range_q, &range, K_MSEC(STATS_PERIOD)) == 0) {
+            printk("Tag %llu (%u) slot %u seq %u\n", range.tag_id, range.short_id, range.slot, range.seq_nr);
+            printk("ToF: %d ps\n", range.tof_ps);
+            printk("Estimated Distance: %s%d.%03dm\n", (range.dist_mm < 0) ? "-" : "",
+                   labs(range.dist_mm) / 1000, labs(range.dist_mm) % 1000);
+            printk("Filtered Distance: %s%d.%03dm | Variance: %u mm2%s\n", (range.filt_mm < 0) ? "-" : "",
+                   labs(range.filt_mm) / 1000, labs(range.filt_mm) % 1000, range.filt_var,
+                   range.outlier ? " | Outlier" : "");
         }
-        if(!discovery){
-            // Anchor waits for Poll message
-            dwt_rxenable(DWT_START_RX_IMMEDIATE);
-            if (rx_message(rx_buffer) != 0){
-                printk("Did not receive Poll message.\n");
-                discovery = true;
-                Sleep(PERIOD);
-                continue;
-            }
-            // If message received is Poll, calculate ToF
-            if ((rx_buffer[0] == 0x41) & (rx_buffer[1] == 0x88) & (rx_buffer[9] == 0x61)){
-                poll_rx_ts = get_rx_timestamp_u64();
-                // ToF is calculated in DWT time units
-                tof_dtu = (poll_rx_ts-ranging_tx_ts-(uint64)(POLL_RX_TO_RESP_TX_DLY_UUS*UUS_TO_DWT_TIME)-TX_ANT_DLY-RX_ANT_DLY)/2;
-                /* 1 uus = 512 / 499.2 usec and 1 usec = 499.2 * 128 dtu. */
-                double tof_us = tof_dtu/(499.2*128);
-                printk("TxR: %llu | RxP: %llu | ToF: %fs\n", ranging_tx_ts, poll_rx_ts, (double)tof_us/1000000.0);
-                printk("Estimated Distance: %fm\n", ((double)tof_us/1000000.0)*SPEED_OF_LIGHT);
-                discovery = true;
-                Sleep(PERIOD);
-            }
-            else{
-                printk("Expected a Poll message, received smothing else:\n");
-                print_msg(rx_buffer, dwt_read32bitreg(RX_FINFO_ID) & RX_FINFO_RXFL_MASK_1023);
-                discovery = true;
-                Sleep(PERIOD);
-            } // end of Poll handling
-        }
-        Sleep(PERIOD);
 
+        if ((k_uptime_get_32() - stats_time) >= STATS_PERIOD) {
+            stats_time = k_uptime_get_32();
+            print_stats();
+        }
     }
     return 0;
-}
\ No newline at end of file
+}
@@ -1,19 +1,28 @@
 /* Do all the includes */
+#include <stdlib.h>
 #include <string.h>
 
 #include "deca_device_api.h"
 #include "deca_regs.h"
 #include "deca_spi.h"
 #include "port.h"
+#include "deca_turnaround.h"
+#include "deca_txretry.h"
+#include "deca_txframe.h"
+#include "deca_ranging.h"
+#include "deca_timestamp.h"
 // zephyr includes
 #include <zephyr.h>
 #include <sys/printk.h>
 
+#ifndef DEV_ID
 #define DEV_ID 0x00AC
+#endif
 #define PAN_ID 0x6380
-#define MAX_DEVICES 5
 #define PERIOD 10
-#define SPEED_OF_LIGHT 299702547
+// Channel and data rate of the configuration, see idmind_anchor.c
+#define UWB_CHANNEL 5
+#define UWB_DATA_RATE DWT_BR_6M8
 
 /* UWB microsecond (uus) to device time unit (dtu, around 15.65 ps) 
  * conversion factor.
@@ -22,29 +31,269 @@
 #define UUS_TO_DWT_TIME 65536
 
 /* Delay Definitions */
-// Delay after Tx to start Rx scan (UWB microseconds)
-#define TX_TO_RX_DELAY_UUS 500
-// Rx timeout (UWB microseconds)
-#define RX_RESP_TIMEOUT_UUS 50000
+/* DS-TWR turnarounds (UWB microseconds), as short as the processing of the
+ * previous frame allows: they set the length of the exchange. */
+// Delay between Ranging Init Rx and Poll Tx at the tag, sent in ranging init
+#ifndef INIT_RX_TO_POLL_TX_DLY_UUS
+#define INIT_RX_TO_POLL_TX_DLY_UUS 1500
+#endif
+// Delay between Poll Rx and Response Tx
+#ifndef POLL_RX_TO_RESP_TX_DLY_UUS
+#define POLL_RX_TO_RESP_TX_DLY_UUS 1500
+#endif
+// Delay between Response Rx and Final Tx at the tag, same as idmind_tag.h
+#ifndef RESP_RX_TO_FINAL_TX_DLY_UUS
+#define RESP_RX_TO_FINAL_TX_DLY_UUS 1500
+#endif
+/* Adaptive turnarounds: the values above are the longest, the anchor
+ * shortens its Response delay, and the tag its Poll and Final delays, down
+ * to TURNAROUND_MIN_UUS while their delayed transmissions are on time, see
+ * deca_turnaround.h. The delays in use travel in the Ranging Init and the
+ * Poll, so both sides always agree. 0 keeps the delays fixed. */
+#ifndef TURNAROUND_ADAPTIVE
+#define TURNAROUND_ADAPTIVE 1
+#endif
+// Shortest turnaround tried, above RX_GUARD_UUS (UWB microseconds), must match idmind_tag.h
+#ifndef TURNAROUND_MIN_UUS
+#define TURNAROUND_MIN_UUS 400
+#endif
+// A turnaround read from a frame, kept within the shortest and the longest
+#define TURNAROUND_CLAMP(dly_uus, max_uus) MIN(MAX((dly_uus), TURNAROUND_MIN_UUS), (max_uus))
+// A late Response is sent again if it can still be this much after its planned time
+// (UWB microseconds), see deca_txretry.h. 0 drops the exchange. The Final Rx window
+// moves with the Response, half the Rx guard keeps the Final in it.
+#ifndef TX_RETRY_SLIP_UUS
+#define TX_RETRY_SLIP_UUS (RX_GUARD_UUS / 2)
+#endif
+// Air time of a ranging frame, preamble included
+#define FRAME_AIR_UUS 250
+// Receiver on this long before the frame is expected, and after
+#define RX_GUARD_UUS 300
 
-// Delay between Poll Rx and Response Tx (UWB microseconds) sent in ranging init
-#define POLL_RX_TO_RESP_TX_DLY_UUS 3000
+/* Ranging mode, given to the tags in the Ranging Init:
+ *  - TWR_MODE_DS: double-sided TWR, Poll, Response and Final after the
+ *    Ranging Init. The clock offsets of both devices cancel out.
+ *  - TWR_MODE_SS: single-sided TWR, the Ranging Init is the anchor's poll and
+ *    the tag answers with a Poll holding its timestamps. The tag's clock offset,
+ *    from the carrier integrator of the Poll, corrects its turnaround. Two
+ *    frames instead of four, for one anchor only (TWR_RESPONDERS 1). */
+#define TWR_MODE_DS 0
+#define TWR_MODE_SS 1
+#ifndef TWR_MODE
+#define TWR_MODE TWR_MODE_DS
+#endif
+
+/* One-to-many DS-TWR: the tag broadcasts its Poll, each anchor answers in
+ * its own response slot and the tag sends a single Final, with the Response
+ * Rx timestamps of all of them. The anchor of index 0 runs the TDMA
+ * superframe, the others only listen for Polls. */
+// Anchors answering each Poll, must match idmind_tag.h
+#ifndef TWR_RESPONDERS
+#define TWR_RESPONDERS 1
+#endif
+// Anchors are numbered from their short address: DEV_ID of the anchor of index 0,
+// must match idmind_tag.h
+#define ANCHOR_FIRST_ID 0x00AC
+// Response slot of this anchor
+#define ANCHOR_INDEX (DEV_ID - ANCHOR_FIRST_ID)
+#define TDMA_COORDINATOR 0
+// Time between two response slots, a Response Rx window and the time the tag
+// needs to turn the receiver on again (UWB microseconds), must match idmind_tag.h
+#define RESP_SLOT_UUS 1200
+
+// Poll Rx to Response Tx of this anchor, Response Tx to the Final of the tag
+// given the turnarounds of the exchange, see the Poll
+#define RESP_TX_DLY_UUS(resp_dly) ((resp_dly) + ANCHOR_INDEX*RESP_SLOT_UUS)
+#define RESP_TO_FINAL_UUS(final_dly) ((TWR_RESPONDERS - 1 - ANCHOR_INDEX)*RESP_SLOT_UUS + (final_dly))
+// Poll and Final Rx scan delays after Tx, and timeouts
+#define POLL_RX_DLY_UUS(poll_dly) ((poll_dly) - RX_GUARD_UUS)
+#define FINAL_RX_DLY_UUS(final_dly) (RESP_TO_FINAL_UUS(final_dly) - RX_GUARD_UUS)
+#define RANGING_RX_TIMEOUT_UUS (2*RX_GUARD_UUS + FRAME_AIR_UUS)
+// Ranging Init Tx to Final Rx, or to Poll Rx in SS-TWR, with the longest turnarounds
+#if TWR_MODE == TWR_MODE_SS
+#define RANGING_EXCHANGE_UUS (INIT_RX_TO_POLL_TX_DLY_UUS + FRAME_AIR_UUS)
+#else
+#define RANGING_EXCHANGE_UUS (INIT_RX_TO_POLL_TX_DLY_UUS + POLL_RX_TO_RESP_TX_DLY_UUS + (TWR_RESPONDERS - 1)*RESP_SLOT_UUS + \
+                              RESP_RX_TO_FINAL_TX_DLY_UUS + 2*FRAME_AIR_UUS)
+#endif
 
 // TX and Rx Antenna delays
 #define TX_ANT_DLY 16436
 #define RX_ANT_DLY 16436
-// Delay between ranging attempts (miliseconds)
 
-static bool flag_interrupt;
-/* Rx Buffer to be used in callbacks */
+/* TDMA superframe: a discovery slot, where new tags blink and are given a
+ * slot, followed by one slot per tag. At the start of its slot the anchor
+ * sends the tag a Ranging Init, at a fixed DW1000 time, and the tag starts
+ * the DS-TWR exchange with its Poll. Every Ranging Init tells the tag when
+ * its next slot starts. */
+// Maximum number of tags, one slot each
+#ifndef TDMA_MAX_TAGS
+#define TDMA_MAX_TAGS 8
+#endif
+// Slot length (UWB microseconds), must hold a Ranging Init and the DS-TWR exchange
+#ifndef TDMA_SLOT_UUS
+#define TDMA_SLOT_UUS (RANGING_EXCHANGE_UUS + 5000)
+#endif
+// Ranging rate of each tag (Hz), lower if all the slots do not fit
+#ifndef TDMA_UPDATE_RATE_HZ
+#define TDMA_UPDATE_RATE_HZ 10
+#endif
+// Missed Polls after which a tag loses its slot
+#ifndef TDMA_MAX_MISSES
+#define TDMA_MAX_MISSES 3
+#endif
+#define TDMA_DISCOVERY_SLOT 0
+#define TDMA_RATE_PERIOD_UUS ((uint32)(1000000.0 * 499.2 / 512.0 / TDMA_UPDATE_RATE_HZ))
+#define TDMA_SUPERFRAME_UUS MAX((TDMA_MAX_TAGS + 1) * TDMA_SLOT_UUS, TDMA_RATE_PERIOD_UUS)
+
+// Delay between Blink Rx and Ranging Init Tx in the discovery slot (UWB microseconds)
+#define BLINK_RX_TO_INIT_TX_DLY_UUS 1500
+// Time kept at the end of a slot to prepare the next one (UWB microseconds)
+#define SLOT_END_MARGIN_UUS 1000
+/* Registry of the tags heard by the anchor, from their Blinks. A tag keeps
+ * its entry, and its short ID, when it loses its slot: the least recently
+ * seen tag without a slot is replaced when a new tag needs the entry. Each
+ * entry takes 48 bytes of RAM on the nRF52, 12 KB for the default 256 tags. */
+// Number of entries, a power of 2
+#ifndef TAG_REGISTRY_SIZE
+#define TAG_REGISTRY_SIZE 256
+#endif
+// Entries where a tag can be, after the hash of its long address
+#define TAG_REGISTRY_PROBES 8
+
+/* Range filter of each tag, a 1-D Kalman filter on the distance: each range
+ * is weighted by the first path quality of the Final, and the ranges too far
+ * from the prediction are rejected as outliers. */
+// Standard deviation of a range with a clear first path (mm)
+#ifndef FILTER_SIGMA_MM
+#define FILTER_SIGMA_MM 100
+#endif
+// First path amplitude over noise standard deviation of a clear first path,
+// the standard deviation of a range grows as the quality falls below it
+#define FILTER_QUALITY_REF 20
+#define FILTER_SIGMA_MAX_MM 5000
+// Fastest tag (mm/s): how much the distance can change between two ranges
+#ifndef FILTER_SPEED_MM_S
+#define FILTER_SPEED_MM_S 2000
+#endif
+// Ranges beyond this many standard deviations of the prediction are outliers
+#define FILTER_GATE 3
+// The filter starts again from the last outlier after this many in a row,
+// each within the gate of the one before
+#define FILTER_MAX_OUTLIERS 3
+
+// Blink Rx window, so that the exchange ends in the discovery slot (UWB microseconds)
+#define DISCOVERY_RX_UUS (TDMA_SLOT_UUS - BLINK_RX_TO_INIT_TX_DLY_UUS - RANGING_EXCHANGE_UUS - SLOT_END_MARGIN_UUS)
+
+// Period of the statistics printed by the main loop (miliseconds)
+#define STATS_PERIOD 10000
+
+/* Rx Buffer filled by dwt_isr(), see anchor_start() */
 #define FRAME_LEN_MAX 127
-static bool rx_received;
-static uint8 rx_buffer[FRAME_LEN_MAX];
-/* 0x41 0x8C SEQ PANID_L PANID_H 8*DEST 2*SOURCE 0x20 TAG_SHORT_L TAG_SHORT_H RESP_DELAY_L RESP_DELAY_H FCS_L FCS_H*/
-// static uint8 ranging_init[] = {0x41, 0x8C, 0x00, 0xCA, 0xDE, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
-// static uint8 ranging_init[22];
-/* 0x41 0x88 SEQ PANID_L PANID_H 2*DEST 2*SOURCE 0x50 4*TOF FCS_L FCS_H */
-// static uint8 resp_msg[] = {0x41, 0x88, 0x00, 0xCA, 0xDE, 0x00, 0x00, 0x00, 0x00, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+/* Ranging states. The anchor only runs between DW1000 events: the state is
+ * advanced by the callbacks, on the DW1000 IRQ thread, and the main loop
+ * only sleeps waiting for the results. */
+typedef enum {
+    ANCHOR_IDLE,            // interrupts not enabled yet
+    ANCHOR_DISCOVERY,       // receiver on, waiting for a Blink
+    ANCHOR_RANGING_INIT,    // Ranging Init being sent
+    ANCHOR_WAIT_POLL,       // receiver on after the Ranging Init, waiting for the Poll
+    ANCHOR_RESPONSE,        // Response being sent
+    ANCHOR_WAIT_FINAL,      // receiver on after the Response, waiting for the Final
+    ANCHOR_LISTEN,          // receiver always on, waiting for any Poll (not the coordinator)
+} anchor_state_t;
+
+/* DW1000 events, see idmind_anchor_callbacks.c */
+typedef enum {
+    ANCHOR_EV_TX_DONE,
+    ANCHOR_EV_RX_OK,
+    ANCHOR_EV_RX_TIMEOUT,
+    ANCHOR_EV_RX_ERROR,
+} anchor_event_t;
+
+/* Result of a ranging exchange, handed to the main loop */
+typedef struct {
+    uint64 tag_id;      // 0 if not known, on the anchors which are not the coordinator
+    uint16 short_id;
+    uint8 slot;
+    uint8 seq_nr;
+    int32 tof_ps;
+    int32 dist_mm;
+    int32 filt_mm;      // filtered distance, after this range
+    uint32 filt_var;    // its variance (mm^2)
+    uint8 outlier;      // 1 if this range was rejected by the filter
+} anchor_range_t;
+
+/* State of the range filter of a tag, see idmind_anchor_filter.c */
+typedef struct {
+    int32 dist_mm;      // filtered distance
+    uint32 var;         // its variance (mm^2), 0 before the first range
+    uint32 time;        // k_uptime_get_32() of the last range
+    uint8 outliers;     // ranges rejected in a row, which agree with each other
+    int32 outlier_mm;   // last of them
+    uint32 outlier_var; // its variance (mm^2)
+    uint32 outlier_time;// k_uptime_get_32() of it
+} range_filter_t;
+
+/* Entry of the tag registry, see idmind_anchor_registry.c */
+typedef struct {
+    uint64 tag_id;      // long address, 0 if the entry is free
+    uint32 last_seen;   // k_uptime_get_32() of the last Blink or range
+    uint8 seq_nr;       // of the last Blink
+    uint8 slot;         // TDMA slot, 0 if none
+    uint8 misses;       // Polls or Finals missed in a row
+    range_filter_t filter;
+} tag_entry_t;
+
+/* Event counters */
+typedef struct {
+    uint32 blinks;
+    uint32 ranges;
+    uint32 outliers;    // ranges rejected by the range filter
+    uint32 timeouts;    // Polls or Finals not received
+    uint32 errors;
+    uint32 unexpected;
+    uint32 full;        // Blinks of tags which could not be registered or given a slot
+    uint32 late;        // slots or exchanges lost because a delayed Tx or Rx was late
+    uint16 resp_dly;    // Response turnaround in use (UWB microseconds)
+    uint32 resp_late;   // Responses sent late, the turnaround was too short
+    uint32 retries;     // late Responses sent again in the same exchange
+    uint32 tx_late[DWT_TXLATE_NUM]; // late delayed Tx per cause, see dwt_gettxlatecause()
+} anchor_stats_t;
+
+extern struct k_msgq anchor_range_q;
+/* 0x41 0x8C SEQ PANID_L PANID_H 8*DEST 2*SOURCE 0x20 TAG_SHORT_L TAG_SHORT_H POLL_DELAY_L POLL_DELAY_H
+ * SLOT 2*SLOT_UUS 4*SUPERFRAME_UUS 4*NEXT_SLOT_UUS RESP_DELAY_L RESP_DELAY_H TWR_MODE FCS_L FCS_H
+ * NEXT_SLOT_UUS is the time from this frame to the start of the tag's next slot,
+ * POLL_DELAY the Init to Poll turnaround the tag asked for in its previous Poll,
+ * RESP_DELAY the Poll to Response turnaround of the anchor of index 0 and
+ * TWR_MODE the exchange which follows */
+#define RANGING_INIT_LEN 36
+#define RANGING_INIT_MODE_IDX 33
+/* 0x41 0x88 SEQ PANID_L PANID_H 2*DEST 2*SOURCE 0x61 RESP_DELAY_L RESP_DELAY_H FINAL_DELAY_L FINAL_DELAY_H
+ * NEXT_POLL_DELAY_L NEXT_POLL_DELAY_H FCS_L FCS_H
+ * RESP_DELAY is the one of the Ranging Init, FINAL_DELAY the Response to Final turnaround of
+ * the tag, after the last response slot, and NEXT_POLL_DELAY its Init to Poll turnaround for
+ * its next slot. The Poll and the Final are broadcast, DEST is 0xFFFF */
+#define POLL_MSG_LEN 18
+#define BROADCAST_ID 0xFFFF
+/* 0x41 0x88 SEQ PANID_L PANID_H 2*DEST 2*SOURCE 0x50 FCS_L FCS_H */
+#define RESP_MSG_LEN 12
+/* 0x41 0x88 SEQ PANID_L PANID_H 2*DEST 2*SOURCE 0x69 4*POLL_TX 4*FINAL_TX TWR_RESPONDERS*4*RESP_RX FCS_L FCS_H
+ * RESP_RX of each anchor at its index, 0 if its Response was not received */
+#define FINAL_MSG_LEN (18 + 4*TWR_RESPONDERS + 2)
+#define FINAL_MSG_POLL_TX_TS_IDX 10
+#define FINAL_MSG_FINAL_TX_TS_IDX 14
+#define FINAL_MSG_RESP_RX_TS_IDX(index) (18 + 4*(index))
+/* 0x41 0x88 SEQ PANID_L PANID_H 2*DEST 2*SOURCE 0x62 NEXT_POLL_DELAY_L NEXT_POLL_DELAY_H 4*INIT_RX 4*POLL_TX FCS_L FCS_H
+ * The Poll of SS-TWR, to the anchor, with the tag's timestamps of the exchange */
+#define SS_POLL_MSG_LEN 22
+#define SS_POLL_MSG_INIT_RX_TS_IDX 12
+#define SS_POLL_MSG_POLL_TX_TS_IDX 16
+/* Offsets of the frames sent by the anchor in the DW1000 TX buffer, see deca_txframe.h */
+#define RANGING_INIT_TX_OFFSET 0
+#define RESP_MSG_TX_OFFSET 64
 
 // static int ranging_tx_ts;
 // static int poll_rx_ts;
@@ -55,19 +304,42 @@ void tx_done_cb(const dwt_cb_data_t *cb_data);
 void rx_ok_cb(const dwt_cb_data_t *cb_data);
 void rx_timeout_cb(const dwt_cb_data_t *cb_data);
 void rx_err_cb(const dwt_cb_data_t *cb_data);
-int rx_message(uint8* rx_buffer);
 
 /* idmind_anchor_phases.c */
 void print_msg(char* msg, int size);
-uint64 get_tx_timestamp_u64(void);
-uint64 get_rx_timestamp_u64(void);
-void final_msg_get_ts(const uint8 *ts_field, uint32 *ts);
-int discovery_phase(int* seq_nr, uint32 dev_id, bool* dev_list, uint8* ranging_init_msg);
-int ranging_phase(int* seq_nr, uint32 dev_id, bool* dev_list, uint8* resp_msg);
+void anchor_start(void);
+void anchor_event(anchor_event_t event, const dwt_cb_data_t *cb_data);
+void anchor_get_stats(anchor_stats_t *stats);
+int discovery_phase(const dwt_cb_data_t *cb_data);
+int ranging_phase(const dwt_cb_data_t *cb_data);
+int final_phase(const dwt_cb_data_t *cb_data);
+int sstwr_phase(const dwt_cb_data_t *cb_data);
+
+/* idmind_anchor_registry.c */
+void registry_init(void);
+tag_entry_t *registry_lookup(uint64 tag_id, uint32 now);
+tag_entry_t *registry_get(uint16 short_id);
+uint16 registry_short_id(const tag_entry_t *tag);
+range_filter_t *registry_filter(uint16 short_id);
+
+/* idmind_anchor_filter.c */
+void filter_reset(range_filter_t *filter);
+uint32 filter_range_var(const dwt_rxdiag_t *diag);
+int filter_update(range_filter_t *filter, int32 dist_mm, uint32 var, uint32 now);
+
+/* idmind_anchor_tdma.c */
+void tdma_init(uint64 now);
+int tdma_assign(tag_entry_t *tag);
+tag_entry_t *tdma_tag(int slot);
+void tdma_seen(int slot);
+int tdma_missed(int slot);
+void tdma_set_poll_delay(int slot, uint16 poll_dly);
+uint16 tdma_poll_delay(int slot);
+int tdma_next(uint64 now, uint64 *start);
+uint32 tdma_next_slot_uus(int slot, uint64 from);
 
 /* idmind_anchor.c */
 void print_header(void);
 int start_dwm(void);
 int config_dwm(void);
-void enable_flag_interrupt(void);
 int dw_main(void);
@@ -0,0 +1,140 @@
+/*! ----------------------------------------------------------------------------
+ *  @file       idmind_anchor_filter.c
+ *  @brief      Code for Anchor device. Range filter of each tag
+ *  @author     cneves
+ */
+
+#include "idmind_anchor.h"
+
+// Variances are held in 32 bits, the prediction stops growing there (about 65 m)
+#define FILTER_VAR_MAX 0xFFFFFFFFUL
+#define FILTER_MOVE_MAX_MM 65535
+
+BUILD_ASSERT(FILTER_SIGMA_MM <= FILTER_SIGMA_MAX_MM, "FILTER_SIGMA_MM above FILTER_SIGMA_MAX_MM");
+BUILD_ASSERT(FILTER_SIGMA_MAX_MM <= FILTER_MOVE_MAX_MM, "range variance beyond 32 bits");
+
+/*! --------------------------------------------------------------------------
+ * @fn filter_reset()
+ * @brief Forgets the ranges of a tag
+ * @param  filter  filter of the tag
+ * @return none
+ */
+void filter_reset(range_filter_t *filter)
+{
+    memset(filter, 0, sizeof(*filter));
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn filter_range_var()
+ * @brief Variance of a range, from the first path quality of the frame
+ *          received last: its standard deviation is FILTER_SIGMA_MM for a
+ *          first path amplitude FILTER_QUALITY_REF times the noise standard
+ *          deviation or more, and grows as the ratio falls below
+ * @param  diag  diagnostics of the frame, see dwt_readdiagnostics()
+ * @return the variance (mm^2)
+ */
+uint32 filter_range_var(const dwt_rxdiag_t *diag)
+{
+    uint32 sigma = FILTER_SIGMA_MAX_MM;
+
+    if (diag->firstPathAmp2 != 0) {
+        sigma = (uint32)FILTER_SIGMA_MM * FILTER_QUALITY_REF * diag->stdNoise / diag->firstPathAmp2;
+    }
+    sigma = MIN(MAX(sigma, FILTER_SIGMA_MM), FILTER_SIGMA_MAX_MM);
+    return sigma * sigma;
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn filter_predict()
+ * @brief Variance of a distance after ms milliseconds, in which the tag may
+ *          have moved at up to FILTER_SPEED_MM_S
+ * @param  var  variance of the distance (mm^2)
+ *         ms  time since
+ * @return the variance (mm^2)
+ */
+static uint64 filter_predict(uint32 var, uint32 ms)
+{
+    uint64 move = MIN((uint64)ms * FILTER_SPEED_MM_S / 1000, FILTER_MOVE_MAX_MM);
+
+    return MIN(var + move * move, FILTER_VAR_MAX);
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn filter_gate()
+ * @brief Checks two distances against each other
+ * @param  a_mm, b_mm  the distances
+ *         sum  sum of their variances (mm^2)
+ * @return 1 if they are within FILTER_GATE standard deviations, 0 if not
+ */
+static int filter_gate(int32 a_mm, int32 b_mm, uint64 sum)
+{
+    int64 innov = (int64)a_mm - b_mm;
+    uint64 dev = (innov < 0) ? -innov : innov;
+
+    /* The deviation is checked before it is squared */
+    return (dev <= 0xFFFFFFFFULL) && (dev * dev <= (uint64)FILTER_GATE * FILTER_GATE * sum);
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn filter_update()
+ * @brief Adds a range to the filter of a tag. The distance predicted from
+ *          the previous ranges grows uncertain with the time the tag had to
+ *          move, at up to FILTER_SPEED_MM_S. A range more than FILTER_GATE
+ *          standard deviations away from it is rejected. After
+ *          FILTER_MAX_OUTLIERS in a row which agree with each other (each
+ *          within the gate of the one before), the tag has moved and the
+ *          filter starts again from the last one. Outliers which disagree,
+ *          like a burst of bad ranges, never restart it.
+ * @param  filter  filter of the tag
+ *         dist_mm  the range
+ *         var  its variance (mm^2), see filter_range_var()
+ *         now  k_uptime_get_32() of the range
+ * @return 0 if the range was used, -1 if it was rejected
+ */
+int filter_update(range_filter_t *filter, int32 dist_mm, uint32 var, uint32 now)
+{
+    uint64 pred_var, sum;
+    int64 innov;
+
+    if (filter->var == 0) {
+        filter->dist_mm = dist_mm;
+        filter->var = MAX(var, 1);
+        filter->time = now;
+        filter->outliers = 0;
+        return 0;
+    }
+
+    /* Prediction: same distance, less certain */
+    pred_var = filter_predict(filter->var, now - filter->time);
+    sum = pred_var + var;
+
+    /* Innovation gate */
+    if (!filter_gate(dist_mm, filter->dist_mm, sum)) {
+        /* A run of outliers goes on only if this one agrees with the last */
+        if ((filter->outliers == 0) ||
+            !filter_gate(dist_mm, filter->outlier_mm, filter_predict(filter->outlier_var, now - filter->outlier_time) + var)) {
+            filter->outliers = 0;
+        }
+        filter->outliers++;
+        filter->outlier_mm = dist_mm;
+        filter->outlier_var = MAX(var, 1);
+        filter->outlier_time = now;
+        if (filter->outliers < FILTER_MAX_OUTLIERS) {
+            return -1;
+        }
+        filter->dist_mm = dist_mm;
+        filter->var = MAX(var, 1);
+        filter->time = now;
+        filter->outliers = 0;
+        return 0;
+    }
+
+    /* Correction, weighted by the variances. Within the gate, the products
+     * stay within 64 bits. */
+    innov = (int64)dist_mm - filter->dist_mm;
+    filter->dist_mm += (int32)(innov * (int64)pred_var / (int64)sum);
+    filter->var = (uint32)MAX(pred_var * var / sum, 1);
+    filter->time = now;
+    filter->outliers = 0;
+    return 0;
+}
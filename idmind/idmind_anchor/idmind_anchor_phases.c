@@ -6,6 +6,49 @@
 
 #include "idmind_anchor.h"
 
+/* Ranging results, read by the main loop */
+K_MSGQ_DEFINE(anchor_range_q, sizeof(anchor_range_t), 4, 8);
+
+/* State of the exchange, only changed from the callbacks once anchor_start()
+ * has enabled the receiver. */
+static anchor_state_t state = ANCHOR_IDLE;
+static anchor_stats_t stats;
+static uint8 rx_buffer[FRAME_LEN_MAX];
+static int cur_slot;
+static uint16 cur_tag;      // short ID of the tag being ranged
+static uint8 seq_nr;
+/* DS-TWR timestamps of the anchor, and the Ranging Init's for SS-TWR */
+static uint64 poll_rx_ts;
+static uint64 resp_tx_ts;
+static uint64 init_tx_ts;
+/* Poll to Response turnaround, only tuned by the anchor of index 0: the
+ * others answer after the one it gave in the Ranging Init */
+static turnaround_t resp_dly;
+
+/* 0x41 0x8C SEQ PANID_L PANID_H 8*DEST 2*SOURCE 0x20 TAG_SHORT_L TAG_SHORT_H POLL_DELAY_L POLL_DELAY_H
+ * SLOT 2*SLOT_UUS 4*SUPERFRAME_UUS 4*NEXT_SLOT_UUS RESP_DELAY_L RESP_DELAY_H TWR_MODE FCS_L FCS_H */
+static uint8 ranging_init[RANGING_INIT_LEN] = {
+    0x41, 0x8C, 0x00, PAN_ID & 0xFF, (PAN_ID >> 8) & 0xFF,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    (DEV_ID) & 0xFF, (DEV_ID >> 8) & 0xFF, 0x20, 0x00, 0x00,
+    (uint8)(INIT_RX_TO_POLL_TX_DLY_UUS & 0xFF), (uint8)((INIT_RX_TO_POLL_TX_DLY_UUS >> 8) & 0xFF),
+    0x00, (uint8)(TDMA_SLOT_UUS & 0xFF), (uint8)((TDMA_SLOT_UUS >> 8) & 0xFF),
+    0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, TWR_MODE,
+    0x00, 0x00
+};
+
+/* 0x41 0x88 SEQ PANID_L PANID_H 2*DEST 2*SOURCE 0x50 FCS_L FCS_H */
+static uint8 resp_msg[RESP_MSG_LEN] = {
+    0x41, 0x88, 0x00, PAN_ID & 0xFF, (PAN_ID >> 8) & 0xFF,
+    0x00, 0x00, (DEV_ID) & 0xFF, (DEV_ID >> 8) & 0xFF, 0x50,
+    0x00, 0x00
+};
+/* Both frames stay in the TX buffer, only their changing bytes are written */
+static txframe_t init_frame;
+static txframe_t resp_frame;
+
 /*! --------------------------------------------------------------------------
  * @fn print_msg()
  * @brief Auxiliary function to print messages
@@ -20,93 +63,462 @@ void print_msg(char* msg, int size)
 }
 
 /*! --------------------------------------------------------------------------
- * @fn get_tx_timestamp_u64()
- *
- * @brief Get the TX time-stamp in a 64-bit variable.
- *        /!\ This function assumes that length of time-stamps is 40 bits, 
- *            for both TX and RX!
- *
+ * @fn send_ranging_init()
+ * @brief Sends the Ranging Init of a slot at a given time, the receiver then
+ *          waits for the Poll
+ * @param  slot  slot of the tag
+ *         tx_time  DW1000 time (dtu) of the transmission
+ * @return 0 if success, -1 if the time was missed
+ */
+static int send_ranging_init(int slot, uint64 tx_time)
+{
+    tag_entry_t *tag = tdma_tag(slot);
+    uint64 tag_id = tag->tag_id;
+    uint16 short_id = registry_short_id(tag);
+    uint16 poll_dly = tdma_poll_delay(slot);
+    uint32 superframe_uus = TDMA_SUPERFRAME_UUS;
+    uint32 next_slot_uus;
+
+    /* Delayed transmissions ignore the low 9 bits of the time */
+    tx_time &= ~(uint64)0x1FF;
+    init_tx_ts = ts_add(tx_time, TX_ANT_DLY);
+    next_slot_uus = tdma_next_slot_uus(slot, tx_time);
+
+    ranging_init[2] = seq_nr;
+    for (int idx = 0; idx < 8; idx++) ranging_init[5+idx] = (tag_id >> 8*idx) & 0xFF;
+    for (int idx = 0; idx < 2; idx++) ranging_init[16+idx] = (short_id >> 8*idx) & 0xFF;
+    for (int idx = 0; idx < 2; idx++) ranging_init[18+idx] = (poll_dly >> 8*idx) & 0xFF;
+    ranging_init[20] = slot;
+    for (int idx = 0; idx < 4; idx++) ranging_init[23+idx] = (superframe_uus >> 8*idx) & 0xFF;
+    for (int idx = 0; idx < 4; idx++) ranging_init[27+idx] = (next_slot_uus >> 8*idx) & 0xFF;
+    for (int idx = 0; idx < 2; idx++) ranging_init[31+idx] = (resp_dly.dly_uus >> 8*idx) & 0xFF;
+    txframe_patch(&init_frame, 2, RANGING_INIT_LEN - 3);
+    txframe_select(&init_frame, 0);
+    dwt_setrxaftertxdelay(POLL_RX_DLY_UUS(poll_dly));
+    dwt_setrxtimeout(RANGING_RX_TIMEOUT_UUS);
+    dwt_setdelayedtrxtime((uint32)(tx_time >> 8));
+
+    cur_slot = slot;
+    cur_tag = short_id;
+    state = ANCHOR_RANGING_INIT;
+    if (dwt_starttx(DWT_START_TX_DELAYED | DWT_RESPONSE_EXPECTED) == DWT_ERROR) {
+        return -1;
+    }
+    return 0;
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn stage_response()
+ * @brief Writes the sequence number and the destination of the Response in
+ *          the TX buffer, if they changed
+ * @param  seq  sequence number of the Poll
+ *         dest  short ID of the tag
+ * @return none
+ */
+static void stage_response(uint8 seq, uint16 dest)
+{
+    if ((resp_msg[2] == seq) && (resp_msg[5] == (dest & 0xFF)) && (resp_msg[6] == ((dest >> 8) & 0xFF))) {
+        return;
+    }
+    resp_msg[2] = seq;
+    resp_msg[5] = dest & 0xFF;
+    resp_msg[6] = (dest >> 8) & 0xFF;
+    txframe_patch(&resp_frame, 2, 6);
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn next_slot()
+ * @brief Prepares the next slot of the superframe: the receiver is turned on
+ *          at the start of the discovery slot, the Ranging Init of a tag slot
+ *          is sent at its start
  * @param  none
- *
- * @return  64-bit value of the read time-stamp.
+ * @return none
  */
-uint64 get_tx_timestamp_u64(void)
+static void next_slot(void)
 {
-    uint8 ts_tab[5];
-    uint64 ts = 0;
+    while (1) {
+        uint64 now = (uint64)dwt_readsystimestamphi32() << 8;
+        uint64 start;
+        int slot = tdma_next(now, &start);
 
-    dwt_readtxtimestamp(ts_tab);
-    for (int i = 4; i >= 0; i--) {
-        ts <<= 8;
-        ts |= ts_tab[i];
+        if (slot == TDMA_DISCOVERY_SLOT) {
+            state = ANCHOR_DISCOVERY;
+            dwt_setrxtimeout(MIN(DISCOVERY_RX_UUS, 0xFFFF));
+            dwt_setdelayedtrxtime((uint32)(start >> 8));
+            if (dwt_rxenable(DWT_START_RX_DELAYED | DWT_IDLE_ON_DLY_ERR) == DWT_SUCCESS) {
+                return;
+            }
+            /* The late flag is sticky after a delayed Rx, it would fail the next start.
+             * dwt_starttx() clears it itself. */
+            dwt_write16bitoffsetreg(SYS_STATUS_ID, 3, SYS_STATUS_TXERR);
+        }
+        else {
+            seq_nr++;
+            if (send_ranging_init(slot, start) == 0) {
+                return;
+            }
+        }
+        stats.late++;
     }
-    return ts;
 }
 
 /*! --------------------------------------------------------------------------
- * @fn get_rx_timestamp_u64()
- *
- * @brief Get the RX time-stamp in a 64-bit variable.
- *        /!\ This function assumes that length of time-stamps is 40 bits, 
- *             for both TX and RX!
- *
+ * @fn listen()
+ * @brief Turns the receiver on, without timeout, for the Polls of any tag.
+ *          Only used by the anchors which are not the TDMA coordinator.
  * @param  none
- *
- * @return  64-bit value of the read time-stamp.
+ * @return none
  */
-uint64 get_rx_timestamp_u64(void)
+static void listen(void)
 {
-    uint8 ts_tab[5];
-    uint64 ts = 0;
+    state = ANCHOR_LISTEN;
+    dwt_setrxtimeout(0);
+    dwt_rxenable(DWT_START_RX_IMMEDIATE);
+}
 
-    dwt_readrxtimestamp(ts_tab);
-    for (int i = 4; i >= 0; i--) {
-        ts <<= 8;
-        ts |= ts_tab[i];
+/*! --------------------------------------------------------------------------
+ * @fn anchor_start()
+ * @brief Starts the ranging state machine. The callbacks and the DW1000
+ *        interrupts must be set (see config_dwm()).
+ * @param  none
+ * @return none
+ */
+void anchor_start(void)
+{
+    /* Frames are read by dwt_isr() in the same SPI batch as the status */
+    dwt_setcallbackrxbuffer(rx_buffer, FRAME_LEN_MAX);
+    txframe_load(&init_frame, ranging_init, sizeof(ranging_init), RANGING_INIT_TX_OFFSET);
+    txframe_load(&resp_frame, resp_msg, sizeof(resp_msg), RESP_MSG_TX_OFFSET);
+    turnaround_init(&resp_dly, POLL_RX_TO_RESP_TX_DLY_UUS,
+                    (TURNAROUND_ADAPTIVE && (ANCHOR_INDEX == TDMA_COORDINATOR)) ? TURNAROUND_MIN_UUS : POLL_RX_TO_RESP_TX_DLY_UUS);
+    stats.resp_dly = resp_dly.dly_uus;
+    if (ANCHOR_INDEX != TDMA_COORDINATOR) {
+        listen();
+        return;
     }
-    return ts;
+    registry_init();
+    tdma_init((uint64)dwt_readsystimestamphi32() << 8);
+    next_slot();
 }
 
 /*! --------------------------------------------------------------------------
- * @fn final_msg_get_ts()
- *
- * @brief Read a given timestamp value from the final message. 
- *        In the timestamp fields of the final message, the least
- *        significant byte is at the lower address.
- *
- * @param  ts_field  pointer on the first byte of the timestamp field to read
- *         ts  timestamp value
- *
+ * @fn anchor_event()
+ * @brief Advances the ranging state machine, called by the callbacks
+ * @param  event  the DW1000 event
+ *         cb_data  callback data
  * @return none
  */
-void final_msg_get_ts(const uint8 *ts_field, uint32 *ts)
+void anchor_event(anchor_event_t event, const dwt_cb_data_t *cb_data)
 {
-    *ts = 0;
-    for (int i = 0; i < 4; i++) {
-        *ts += ts_field[i] << (i * 8);
+    switch (event) {
+    case ANCHOR_EV_TX_DONE:
+        /* The receiver is turned on by DWT_RESPONSE_EXPECTED. The tag
+         * answers with the sequence number of the Ranging Init, the
+         * Response is ready before its Poll arrives. */
+        if (state == ANCHOR_RANGING_INIT) {
+            state = ANCHOR_WAIT_POLL;
+            if (TWR_MODE == TWR_MODE_DS) {
+                stage_response(seq_nr, cur_tag);
+            }
+        }
+        else if (state == ANCHOR_RESPONSE) {
+            state = ANCHOR_WAIT_FINAL;
+        }
+        return;
+
+    case ANCHOR_EV_RX_OK:
+        if ((state == ANCHOR_DISCOVERY) && (discovery_phase(cb_data) == 0)) {
+            return;
+        }
+        /* In SS-TWR the Poll ends the exchange */
+        if ((state == ANCHOR_WAIT_POLL) && (TWR_MODE == TWR_MODE_SS)) {
+            sstwr_phase(cb_data);
+        }
+        else if (((state == ANCHOR_WAIT_POLL) || (state == ANCHOR_LISTEN)) && (ranging_phase(cb_data) == 0)) {
+            return;
+        }
+        if (state == ANCHOR_WAIT_FINAL) {
+            final_phase(cb_data);
+        }
+        break;
+
+    case ANCHOR_EV_RX_TIMEOUT:
+        if ((state == ANCHOR_WAIT_POLL) || (state == ANCHOR_WAIT_FINAL)) {
+            stats.timeouts++;
+            tdma_missed(cur_slot);
+        }
+        break;
+
+    case ANCHOR_EV_RX_ERROR:
+        stats.errors++;
+        if ((state == ANCHOR_WAIT_POLL) || (state == ANCHOR_WAIT_FINAL)) {
+            tdma_missed(cur_slot);
+        }
+        break;
     }
+
+    /* Slot over, the rest of the discovery slot is lost after a frame
+     * which is not a Blink */
+    if (ANCHOR_INDEX != TDMA_COORDINATOR) {
+        listen();
+        return;
+    }
+    next_slot();
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn anchor_get_stats()
+ * @brief Reads the event counters
+ * @param  s  copy of the counters
+ * @return none
+ */
+void anchor_get_stats(anchor_stats_t *s)
+{
+    unsigned int key = irq_lock();
+
+    *s = stats;
+    dwt_readtxlatecounters(s->tx_late);
+    irq_unlock(key);
 }
 
 /*! --------------------------------------------------------------------------
  * @fn discovery_phase()
  * @brief In the discovery phase, the anchor receives blink messages and replies
- *          with ranging init
- * @param  none
- * @return 0 if successful pairing, -1 otherwise
+ *          with ranging init, which gives the tag its slot
+ * @param  cb_data  callback data of the received frame
+ * @return 0 if the ranging init was sent, -1 otherwise
  */
-int discovery_phase(int* seq_nr, uint32 dev_id, bool* dev_list, uint8* ranging_init_msg)
+int discovery_phase(const dwt_cb_data_t *cb_data)
 {
+    uint64 tag_id = 0;
+    tag_entry_t *tag;
+    int slot;
+
+    // If message received is Blink, give the TAG a slot
+    if ((cb_data->rx_data == NULL) || (cb_data->datalength < 12) || (rx_buffer[0] != 0xC5)) {
+        stats.unexpected++;
+        return -1;
+    }
+    stats.blinks++;
+
+    for (int i = 0; i < 8; i++) tag_id += ((uint64)rx_buffer[2+i] << 8*i);
+    tag = (tag_id != 0) ? registry_lookup(tag_id, k_uptime_get_32()) : NULL;
+    if (tag == NULL) {
+        stats.full++;
+        return -1;
+    }
+    tag->seq_nr = rx_buffer[1];
+    slot = tdma_assign(tag);
+    if (slot < 0) {
+        stats.full++;
+        return -1;
+    }
+
+    // Send ranging_init message, the receiver waits for the Poll after it
+    seq_nr = rx_buffer[1];
+    if (send_ranging_init(slot, ts_add(cb_data->rx_ts, (int64)BLINK_RX_TO_INIT_TX_DLY_UUS*UUS_TO_DWT_TIME)) != 0) {
+        stats.late++;
+        return -1;
+    }
     return 0;
 }
 
 /*! --------------------------------------------------------------------------
  * @fn ranging_phase()
- * @brief In the ranging phase, the anchor receives poll message, sends a reply,
- *          receives final message and gets a distance estimation
- * @param  none
+ * @brief In the ranging phase, the anchor receives the poll message of the
+ *          slot's tag, or of any tag if it is not the TDMA coordinator, and
+ *          sends the response in its response slot, at a precomputed time.
+ *          The turnarounds of the exchange are the ones given in the Poll.
+ * @param  cb_data  callback data of the received frame
+ * @return 0 if the response was sent, -1 otherwise
+ */
+int ranging_phase(const dwt_cb_data_t *cb_data)
+{
+    uint64 resp_tx_time;
+    uint16 resp_dly_uus, final_dly_uus;
+    int src = rx_buffer[7] + (rx_buffer[8] << 8);
+
+    // If message received is the broadcast Poll of the slot's tag, send the Response
+    if ((cb_data->rx_data == NULL) || (cb_data->datalength < POLL_MSG_LEN) ||
+        (rx_buffer[0] != 0x41) || (rx_buffer[1] != 0x88) || (rx_buffer[9] != 0x61) ||
+        ((rx_buffer[5] + (rx_buffer[6] << 8)) != BROADCAST_ID) ||
+        ((state == ANCHOR_WAIT_POLL) && (src != cur_tag))) {
+        /* Anything can be heard while listening */
+        if (state == ANCHOR_WAIT_POLL) {
+            stats.unexpected++;
+            tdma_missed(cur_slot);
+        }
+        return -1;
+    }
+    cur_tag = src;
+    poll_rx_ts = cb_data->rx_ts;
+    resp_dly_uus = TURNAROUND_CLAMP(rx_buffer[10] + (rx_buffer[11] << 8), POLL_RX_TO_RESP_TX_DLY_UUS);
+    final_dly_uus = TURNAROUND_CLAMP(rx_buffer[12] + (rx_buffer[13] << 8), RESP_RX_TO_FINAL_TX_DLY_UUS);
+    if (state == ANCHOR_WAIT_POLL) {
+        tdma_set_poll_delay(cur_slot, rx_buffer[14] + (rx_buffer[15] << 8));
+    }
+
+    /* The Response TX timestamp is known in advance: the delayed time,
+     * whose low 9 bits are ignored, plus the antenna delay */
+    resp_tx_time = ts_add(poll_rx_ts, (int64)RESP_TX_DLY_UUS(resp_dly_uus)*UUS_TO_DWT_TIME) & ~(uint64)0x1FF;
+    resp_tx_ts = ts_add(resp_tx_time, TX_ANT_DLY);
+
+    stage_response(rx_buffer[2], src);
+    txframe_select(&resp_frame, 1);
+    dwt_setrxaftertxdelay(FINAL_RX_DLY_UUS(final_dly_uus));
+    dwt_setrxtimeout(RANGING_RX_TIMEOUT_UUS);
+    dwt_setdelayedtrxtime((uint32)(resp_tx_time >> 8));
+
+    state = ANCHOR_RESPONSE;
+    stats.resp_dly = resp_dly_uus;
+    if (dwt_starttx(DWT_START_TX_DELAYED | DWT_RESPONSE_EXPECTED) == DWT_SUCCESS) {
+        if (ANCHOR_INDEX == TDMA_COORDINATOR) {
+            turnaround_ok(&resp_dly);
+        }
+        return 0;
+    }
+    stats.resp_late++;
+    /* Only the turnaround of the coordinator is tuned, the given one is fixed for the others */
+    if (ANCHOR_INDEX == TDMA_COORDINATOR) {
+        turnaround_late(&resp_dly);
+    }
+
+    /* Still in the Rx window of the tag a little later, the Final is
+     * received after the Response actually sent */
+    if ((TX_RETRY_SLIP_UUS > 0) && (txretry_time(&resp_tx_time, TX_RETRY_SLIP_UUS) == 0)) {
+        dwt_setdelayedtrxtime((uint32)(resp_tx_time >> 8));
+        if (dwt_starttx(DWT_START_TX_DELAYED | DWT_RESPONSE_EXPECTED) == DWT_SUCCESS) {
+            resp_tx_ts = ts_add(resp_tx_time, TX_ANT_DLY);
+            stats.retries++;
+            return 0;
+        }
+    }
+    stats.late++;
+    tdma_missed(cur_slot);
+    return -1;
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn post_range()
+ * @brief Hands a range of the slot's tag to the main loop, after its range
+ *          filter, weighted by the first path quality of the frame just
+ *          received
+ * @param  tof  time of flight, see deca_ranging.h
+ *         seq  sequence number of the exchange
+ * @return none
+ */
+static void post_range(int64 tof, uint8 seq)
+{
+    anchor_range_t range;
+    tag_entry_t *tag;
+    range_filter_t *filter;
+    dwt_rxdiag_t diag;
+    uint32 var;
+
+    tag = tdma_tag(cur_slot);
+    range.tag_id = (tag != NULL) ? tag->tag_id : 0;
+    range.short_id = cur_tag;
+    range.slot = cur_slot;
+    range.seq_nr = seq;
+    range.tof_ps = ranging_tof_to_ps(tof);
+    range.dist_mm = ranging_tof_to_mm(tof);
+
+    /* The diagnostics are the frame's until the receiver is turned on again */
+    dwt_readdiagnostics(&diag);
+    var = filter_range_var(&diag);
+    filter = registry_filter(cur_tag);
+    range.outlier = (filter != NULL) && (filter_update(filter, range.dist_mm, var, k_uptime_get_32()) != 0);
+    range.filt_mm = (filter != NULL) ? filter->dist_mm : range.dist_mm;
+    range.filt_var = (filter != NULL) ? filter->var : var;
+    if (range.outlier) {
+        stats.outliers++;
+    }
+
+    /* Dropped if the main loop is late, the next exchange will do */
+    k_msgq_put(&anchor_range_q, &range, K_NO_WAIT);
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn final_phase()
+ * @brief In the final phase, the anchor receives the final message of the
+ *          slot's tag, with the tag's timestamps, and gets a double-sided
+ *          TWR distance estimation, see post_range()
+ * @param  cb_data  callback data of the received frame
+ * @return 0 if successful ranging, -1 otherwise
+ */
+int final_phase(const dwt_cb_data_t *cb_data)
+{
+    uint32 poll_tx_ts, resp_rx_ts, final_tx_ts;
+    uint64 final_rx_ts;
+    int64 tof;
+
+    // If message received is the Final of the slot's tag, calculate ToF
+    if ((cb_data->rx_data == NULL) || (cb_data->datalength < FINAL_MSG_LEN) ||
+        (rx_buffer[0] != 0x41) || (rx_buffer[1] != 0x88) || (rx_buffer[9] != 0x69) ||
+        ((rx_buffer[7] + (rx_buffer[8] << 8)) != cur_tag)) {
+        stats.unexpected++;
+        tdma_missed(cur_slot);
+        return -1;
+    }
+    tdma_seen(cur_slot);
+
+    /* The tag only sends the low 32 bits of its timestamps, the exchange is
+     * short enough for their differences to be right across a wrap. */
+    resp_rx_ts = ts_get32(&rx_buffer[FINAL_MSG_RESP_RX_TS_IDX(ANCHOR_INDEX)]);
+    if (resp_rx_ts == 0) {
+        // The tag missed our Response
+        stats.timeouts++;
+        return -1;
+    }
+    stats.ranges++;
+    poll_tx_ts = ts_get32(&rx_buffer[FINAL_MSG_POLL_TX_TS_IDX]);
+    final_tx_ts = ts_get32(&rx_buffer[FINAL_MSG_FINAL_TX_TS_IDX]);
+    final_rx_ts = cb_data->rx_ts;
+
+    /* Double-sided TWR with asymmetric delays: the clock offsets of both
+     * devices cancel out. In integers, see deca_ranging.h. */
+    tof = ranging_dstwr_tof(ts_interval32(resp_rx_ts, poll_tx_ts),
+                            ts_interval(final_rx_ts, resp_tx_ts),
+                            ts_interval32(final_tx_ts, resp_rx_ts),
+                            ts_interval(resp_tx_ts, poll_rx_ts));
+    post_range(tof, rx_buffer[2]);
+    return 0;
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn sstwr_phase()
+ * @brief In SS-TWR, the anchor receives the Poll of the slot's tag, with the
+ *          tag's Ranging Init Rx and Poll Tx timestamps, and gets a
+ *          single-sided TWR distance estimation, see post_range(). The tag's
+ *          turnaround is brought to the anchor's clock with the carrier
+ *          integrator of the Poll.
+ * @param  cb_data  callback data of the received frame
  * @return 0 if successful ranging, -1 otherwise
  */
-int ranging_phase(int* seq_nr, uint32 dev_id, bool* dev_list, uint8* resp_msg)
+int sstwr_phase(const dwt_cb_data_t *cb_data)
 {
+    uint32 init_rx_ts, poll_tx_ts;
+    int32 offset;
+    int64 tof;
+
+    // If message received is the SS-TWR Poll of the slot's tag, calculate ToF
+    if ((cb_data->rx_data == NULL) || (cb_data->datalength < SS_POLL_MSG_LEN) ||
+        (rx_buffer[0] != 0x41) || (rx_buffer[1] != 0x88) || (rx_buffer[9] != 0x62) ||
+        ((rx_buffer[7] + (rx_buffer[8] << 8)) != cur_tag)) {
+        stats.unexpected++;
+        tdma_missed(cur_slot);
+        return -1;
+    }
+    tdma_seen(cur_slot);
+    tdma_set_poll_delay(cur_slot, rx_buffer[10] + (rx_buffer[11] << 8));
+    stats.ranges++;
+
+    /* The carrier integrator is the Poll's until the receiver is turned on again */
+    offset = ranging_clock_offset(dwt_readcarrierintegrator(), UWB_CHANNEL, UWB_DATA_RATE);
+    init_rx_ts = ts_get32(&rx_buffer[SS_POLL_MSG_INIT_RX_TS_IDX]);
+    poll_tx_ts = ts_get32(&rx_buffer[SS_POLL_MSG_POLL_TX_TS_IDX]);
+    poll_rx_ts = cb_data->rx_ts;
+    tof = ranging_sstwr_offset_tof(ts_interval(poll_rx_ts, init_tx_ts), ts_interval32(poll_tx_ts, init_rx_ts), offset);
+    post_range(tof, rx_buffer[2]);
     return 0;
-}
\ No newline at end of file
+}
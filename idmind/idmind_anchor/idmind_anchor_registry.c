@@ -0,0 +1,124 @@
+/*! ----------------------------------------------------------------------------
+ *  @file       idmind_anchor_registry.c
+ *  @brief      Code for Anchor device. Registry of the tags heard by the anchor
+ *  @author     cneves
+ */
+
+#include "idmind_anchor.h"
+
+BUILD_ASSERT((TAG_REGISTRY_SIZE & (TAG_REGISTRY_SIZE - 1)) == 0, "TAG_REGISTRY_SIZE must be a power of 2");
+BUILD_ASSERT(TAG_REGISTRY_SIZE < BROADCAST_ID, "short IDs beyond the broadcast address");
+BUILD_ASSERT(TAG_REGISTRY_PROBES <= TAG_REGISTRY_SIZE, "more probes than entries");
+#ifdef CONFIG_ARM
+/* The RAM of the registry in idmind_anchor.h; the i386 ABI of native_posix
+ * aligns uint64 to 4 bytes, 44 there */
+BUILD_ASSERT(sizeof(tag_entry_t) == 48, "tag_entry_t size changed, update the registry RAM in idmind_anchor.h");
+#endif
+
+/* Open addressing: a tag is in one of the TAG_REGISTRY_PROBES entries after
+ * the hash of its long address. Entries never move, the short ID of a tag
+ * is its index plus one. */
+static tag_entry_t registry[TAG_REGISTRY_SIZE];
+
+/*! --------------------------------------------------------------------------
+ * @fn registry_hash()
+ * @brief Spreads the long addresses over the registry, they often only
+ *          differ in their low bits
+ * @param  tag_id  long address of the tag
+ * @return first index to probe
+ */
+static uint32 registry_hash(uint64 tag_id)
+{
+    return (uint32)((tag_id * 0x9E3779B97F4A7C15ULL) >> 32) & (TAG_REGISTRY_SIZE - 1);
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn registry_init()
+ * @brief Empties the registry
+ * @param  none
+ * @return none
+ */
+void registry_init(void)
+{
+    memset(registry, 0, sizeof(registry));
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn registry_lookup()
+ * @brief Finds the entry of a tag, or adds it. A new tag takes a free entry,
+ *          or the least recently seen one without a slot.
+ * @param  tag_id  long address of the tag, not 0
+ *         now  k_uptime_get_32() of the frame
+ * @return the entry, NULL if all the probed entries hold a slot
+ */
+tag_entry_t *registry_lookup(uint64 tag_id, uint32 now)
+{
+    uint32 index = registry_hash(tag_id);
+    tag_entry_t *victim = NULL;
+
+    for (int probe = 0; probe < TAG_REGISTRY_PROBES; probe++) {
+        tag_entry_t *tag = &registry[(index + probe) & (TAG_REGISTRY_SIZE - 1)];
+
+        if (tag->tag_id == tag_id) {
+            tag->last_seen = now;
+            return tag;
+        }
+        if (tag->slot != 0) {
+            continue;
+        }
+        if ((victim == NULL) || (victim->tag_id != 0 && (tag->tag_id == 0 ||
+            (uint32)(now - tag->last_seen) > (uint32)(now - victim->last_seen)))) {
+            victim = tag;
+        }
+    }
+    if (victim != NULL) {
+        victim->tag_id = tag_id;
+        victim->last_seen = now;
+        victim->seq_nr = 0;
+        victim->slot = 0;
+        victim->misses = 0;
+        filter_reset(&victim->filter);
+    }
+    return victim;
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn registry_get()
+ * @brief Finds the entry of a tag from its short ID
+ * @param  short_id  short ID of the tag
+ * @return the entry, NULL if there is none
+ */
+tag_entry_t *registry_get(uint16 short_id)
+{
+    if ((short_id == 0) || (short_id > TAG_REGISTRY_SIZE) || (registry[short_id - 1].tag_id == 0)) {
+        return NULL;
+    }
+    return &registry[short_id - 1];
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn registry_short_id()
+ * @brief Gets the short ID of a tag, given in its Ranging Init
+ * @param  tag  entry of the tag
+ * @return the short ID
+ */
+uint16 registry_short_id(const tag_entry_t *tag)
+{
+    return (uint16)(tag - registry) + 1;
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn registry_filter()
+ * @brief Gets the range filter of a tag from its short ID. On the anchors
+ *          which are not the coordinator, the entries have no long address,
+ *          but the short IDs are the ones given by the coordinator.
+ * @param  short_id  short ID of the tag
+ * @return the filter, NULL if the short ID is not one of the registry
+ */
+range_filter_t *registry_filter(uint16 short_id)
+{
+    if ((short_id == 0) || (short_id > TAG_REGISTRY_SIZE)) {
+        return NULL;
+    }
+    return &registry[short_id - 1].filter;
+}
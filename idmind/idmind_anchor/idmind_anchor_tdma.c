@@ -0,0 +1,177 @@
+/*! ----------------------------------------------------------------------------
+ *  @file       idmind_anchor_tdma.c
+ *  @brief      Code for Anchor device. TDMA superframe: slot table and timing
+ *  @author     cneves
+ */
+
+#include "idmind_anchor.h"
+
+#define SLOT_DTU ((uint64)TDMA_SLOT_UUS * UUS_TO_DWT_TIME)
+#define SUPERFRAME_DTU ((uint64)TDMA_SUPERFRAME_UUS * UUS_TO_DWT_TIME)
+// A slot starting sooner than this is skipped (UWB microseconds)
+#define SLOT_MIN_LEAD_UUS 300
+
+BUILD_ASSERT(DISCOVERY_RX_UUS > 0, "TDMA_SLOT_UUS too short for the discovery exchange");
+BUILD_ASSERT(TDMA_SUPERFRAME_UUS < (1UL << 23), "superframe beyond the DW1000 delayed Tx range");
+BUILD_ASSERT(TURNAROUND_MIN_UUS > RX_GUARD_UUS, "TURNAROUND_MIN_UUS within the Rx guard");
+BUILD_ASSERT((DEV_ID >= ANCHOR_FIRST_ID) && (ANCHOR_INDEX < TWR_RESPONDERS), "DEV_ID out of the anchors answering a Poll");
+BUILD_ASSERT((TWR_MODE == TWR_MODE_DS) || (TWR_RESPONDERS == 1), "SS-TWR with more than one anchor per Poll");
+
+/* Slot 0 is the discovery slot, the others hold the short ID of their tag,
+ * 0 if free. The state of the tag is in its registry entry, but for the
+ * Init to Poll turnaround it asked for, only needed while it has a slot. */
+static uint16 slots[TDMA_MAX_TAGS + 1];
+static uint16 poll_dly[TDMA_MAX_TAGS + 1];
+static uint64 sf_start;
+static int cur_slot;
+
+/*! --------------------------------------------------------------------------
+ * @fn tdma_init()
+ * @brief Starts the first superframe, with its discovery slot, at a given time
+ * @param  now  DW1000 time (dtu) of the start
+ * @return none
+ */
+void tdma_init(uint64 now)
+{
+    memset(slots, 0, sizeof(slots));
+    for (int slot = 0; slot <= TDMA_MAX_TAGS; slot++) poll_dly[slot] = INIT_RX_TO_POLL_TX_DLY_UUS;
+    sf_start = ts_add(now, -(int64)SUPERFRAME_DTU);
+    cur_slot = TDMA_MAX_TAGS;
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn tdma_assign()
+ * @brief Gets the slot of a tag, or gives it a free one
+ * @param  tag  registry entry of the tag
+ * @return the slot, -1 if full
+ */
+int tdma_assign(tag_entry_t *tag)
+{
+    if (tag->slot != 0) {
+        return tag->slot;
+    }
+    for (int slot = 1; slot <= TDMA_MAX_TAGS; slot++) {
+        if (slots[slot] == 0) {
+            slots[slot] = registry_short_id(tag);
+            poll_dly[slot] = INIT_RX_TO_POLL_TX_DLY_UUS;
+            tag->slot = slot;
+            tag->misses = 0;
+            return slot;
+        }
+    }
+    return -1;
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn tdma_tag()
+ * @brief Gets the tag of a slot
+ * @param  slot  the slot
+ * @return registry entry of the tag, NULL if the slot is free
+ */
+tag_entry_t *tdma_tag(int slot)
+{
+    return registry_get(slots[slot]);
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn tdma_seen()
+ * @brief Records a range in a slot
+ * @param  slot  the slot
+ * @return none
+ */
+void tdma_seen(int slot)
+{
+    tag_entry_t *tag = tdma_tag(slot);
+
+    if (tag != NULL) {
+        tag->misses = 0;
+        tag->last_seen = k_uptime_get_32();
+    }
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn tdma_missed()
+ * @brief Records a Poll missed in a slot, the slot is freed after
+ *          TDMA_MAX_MISSES in a row
+ * @param  slot  the slot
+ * @return 1 if the slot was freed, 0 otherwise
+ */
+int tdma_missed(int slot)
+{
+    tag_entry_t *tag = tdma_tag(slot);
+
+    if ((tag == NULL) || (++tag->misses < TDMA_MAX_MISSES)) {
+        return 0;
+    }
+    tag->slot = 0;
+    slots[slot] = 0;
+    return 1;
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn tdma_set_poll_delay()
+ * @brief Records the Init to Poll turnaround asked for by the tag of a slot,
+ *          given in its next Ranging Init
+ * @param  slot  the slot
+ *         dly_uus  the turnaround (UWB microseconds), kept within
+ *          TURNAROUND_MIN_UUS and INIT_RX_TO_POLL_TX_DLY_UUS
+ * @return none
+ */
+void tdma_set_poll_delay(int slot, uint16 dly_uus)
+{
+    poll_dly[slot] = TURNAROUND_CLAMP(dly_uus, INIT_RX_TO_POLL_TX_DLY_UUS);
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn tdma_poll_delay()
+ * @brief Gets the Init to Poll turnaround of the tag of a slot
+ * @param  slot  the slot
+ * @return the turnaround (UWB microseconds)
+ */
+uint16 tdma_poll_delay(int slot)
+{
+    return poll_dly[slot];
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn tdma_next()
+ * @brief Moves to the next slot to serve: the discovery slot or a slot with
+ *          a tag, which starts at least SLOT_MIN_LEAD_UUS after now
+ * @param  now  current DW1000 time (dtu)
+ *         start  DW1000 time (dtu) of the start of the slot
+ * @return the slot
+ */
+int tdma_next(uint64 now, uint64 *start)
+{
+    while (1) {
+        if (++cur_slot > TDMA_MAX_TAGS) {
+            cur_slot = TDMA_DISCOVERY_SLOT;
+            sf_start = ts_add(sf_start, SUPERFRAME_DTU);
+        }
+        if ((cur_slot != TDMA_DISCOVERY_SLOT) && (slots[cur_slot] == 0)) {
+            continue;
+        }
+
+        *start = ts_add(sf_start, cur_slot * SLOT_DTU);
+        if (ts_diff(*start, now) >= (int64)SLOT_MIN_LEAD_UUS * UUS_TO_DWT_TIME) {
+            return cur_slot;
+        }
+    }
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn tdma_next_slot_uus()
+ * @brief Time from a given DW1000 time to the next start of a slot
+ * @param  slot  the slot
+ *         from  DW1000 time (dtu)
+ * @return time to the start of the slot (UWB microseconds)
+ */
+uint32 tdma_next_slot_uus(int slot, uint64 from)
+{
+    uint64 start = ts_add(sf_start, slot * SLOT_DTU);
+
+    while (ts_diff(start, from) < (int64)SLOT_MIN_LEAD_UUS * UUS_TO_DWT_TIME) {
+        start = ts_add(start, SUPERFRAME_DTU);
+    }
+    return (uint32)(ts_interval(start, from) / UUS_TO_DWT_TIME);
+}
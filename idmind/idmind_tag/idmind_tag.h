@@ -5,11 +5,17 @@
 #include "deca_regs.h"
 #include "deca_spi.h"
 #include "port.h"
+#include "deca_turnaround.h"
+#include "deca_txretry.h"
+#include "deca_txframe.h"
+#include "deca_timestamp.h"
 // zephyr includes
 #include <zephyr.h>
 #include <sys/printk.h>
 
+#ifndef DEV_ID
 #define DEV_ID 0x0001
+#endif
 #define PAN_ID 0x6380
 #define BIG_PERIOD 50
 #define PERIOD 10
@@ -20,30 +26,131 @@
 #define UUS_TO_DWT_TIME 65536
 
 /* Delay Definitions */
-// Delay after Tx to start Rx scan (UWB microseconds)
+// Delay after Blink Tx to start Rx scan (UWB microseconds)
 #define TX_TO_RX_DELAY_UUS 300
-// Rx timeout (UWB microseconds)
+// Ranging Init Rx timeout after a Blink (UWB microseconds)
 #define RX_RESP_TIMEOUT_UUS 10000
+/* DS-TWR turnarounds (UWB microseconds), the longest ones, must match
+ * idmind_anchor.h. The turnarounds of an exchange are given in the Ranging
+ * Init and the Poll. */
+// Delay between Ranging Init Rx and Poll Tx
+#ifndef INIT_RX_TO_POLL_TX_DLY_UUS
+#define INIT_RX_TO_POLL_TX_DLY_UUS 1500
+#endif
+// Delay between Poll Rx and Response Tx at the anchor
+#ifndef POLL_RX_TO_RESP_TX_DLY_UUS
+#define POLL_RX_TO_RESP_TX_DLY_UUS 1500
+#endif
+// Delay between Response Rx and Final Tx
+#ifndef RESP_RX_TO_FINAL_TX_DLY_UUS
+#define RESP_RX_TO_FINAL_TX_DLY_UUS 1500
+#endif
+/* Adaptive turnarounds: the tag shortens its Poll and Final delays down to
+ * TURNAROUND_MIN_UUS while they are sent on time, see deca_turnaround.h.
+ * The Poll delay it wants is given by the anchor in the next Ranging Init.
+ * 0 keeps the delays fixed. */
+#ifndef TURNAROUND_ADAPTIVE
+#define TURNAROUND_ADAPTIVE 1
+#endif
+// Shortest turnaround tried (UWB microseconds), must match idmind_anchor.h
+#ifndef TURNAROUND_MIN_UUS
+#define TURNAROUND_MIN_UUS 400
+#endif
+// A turnaround read from a frame, kept within the shortest and the longest
+#define TURNAROUND_CLAMP(dly_uus, max_uus) MIN(MAX((dly_uus), TURNAROUND_MIN_UUS), (max_uus))
+// A late Poll or Final is sent again if it can still be this much after its planned time,
+// within the Rx window of the anchors (UWB microseconds), see deca_txretry.h. 0 drops the exchange.
+#ifndef TX_RETRY_SLIP_UUS
+#define TX_RETRY_SLIP_UUS RX_GUARD_UUS
+#endif
+// Time given to a started transmission to complete (miliseconds)
+#define TX_DONE_TIMEOUT_MS 5
+// Iterations between two prints of the late transmissions
+#define TX_STATS_PERIOD 100
+// Air time of a ranging frame, preamble included
+#define FRAME_AIR_UUS 250
+// Receiver on this long before the Response is expected, and after
+#define RX_GUARD_UUS 300
+// Response Rx scan delay after Poll Tx, given the turnaround of the anchor, and timeout
+#define RESP_RX_DLY_UUS(resp_dly) ((resp_dly) - RX_GUARD_UUS)
+#define RESP_RX_TIMEOUT_UUS (2*RX_GUARD_UUS + FRAME_AIR_UUS)
+
+/* Ranging mode, chosen by the anchor and given in the Ranging Init, see
+ * idmind_anchor.h. In SS-TWR the tag answers the Ranging Init with a single
+ * Poll to the anchor, holding its timestamps, and its receiver stays off. */
+#define TWR_MODE_DS 0
+#define TWR_MODE_SS 1
+
+/* One-to-many DS-TWR: the Poll is broadcast and each anchor answers in its
+ * own response slot, given by its index. A single Final carries the Response
+ * Rx timestamps of all of them. */
+// Anchors answering each Poll, must match idmind_anchor.h
+#ifndef TWR_RESPONDERS
+#define TWR_RESPONDERS 1
+#endif
+// Index of an anchor, from its short address, see idmind_anchor.h
+#define ANCHOR_FIRST_ID 0x00AC
+#define ANCHOR_INDEX(anchor_id) ((anchor_id) - ANCHOR_FIRST_ID)
+// Time between two response slots (UWB microseconds), must match idmind_anchor.h
+#define RESP_SLOT_UUS 1200
+// Poll Tx to Final Tx
+#define POLL_TX_TO_FINAL_TX_DLY_UUS(resp_dly, final_dly) ((resp_dly) + (TWR_RESPONDERS - 1)*RESP_SLOT_UUS + (final_dly))
 // TX and Rx Antenna delays
 #define TX_ANT_DLY 16436
 #define RX_ANT_DLY 16436
 
+/* TDMA: the Ranging Init gives the tag a slot of the anchor's superframe
+ * and the time to its next start. The receiver is turned on TDMA_GUARD_UUS
+ * before the expected Ranging Init. */
+#define TDMA_GUARD_UUS 500
+// Missed slots after which the tag blinks again
+#define TDMA_MAX_MISSES 3
+// dtu in a milisecond
+#define DWT_TIME_PER_MS (499.2 * 128 * 1000)
+
+/* 0xC5 SEQ 8*DEV_ID FCS_L FCS_H */
+#define BLINK_MSG_LEN 12
+/* 0x41 0x8C SEQ PANID_L PANID_H 8*DEST 2*SOURCE 0x20 TAG_SHORT_L TAG_SHORT_H POLL_DELAY_L POLL_DELAY_H
+ * SLOT 2*SLOT_UUS 4*SUPERFRAME_UUS 4*NEXT_SLOT_UUS RESP_DELAY_L RESP_DELAY_H TWR_MODE FCS_L FCS_H */
+#define RANGING_INIT_LEN 36
+#define RANGING_INIT_MODE_IDX 33
+/* 0x41 0x88 SEQ PANID_L PANID_H 2*DEST 2*SOURCE 0x61 RESP_DELAY_L RESP_DELAY_H FINAL_DELAY_L FINAL_DELAY_H
+ * NEXT_POLL_DELAY_L NEXT_POLL_DELAY_H FCS_L FCS_H
+ * The Poll and the Final are broadcast, DEST is 0xFFFF */
+#define POLL_MSG_LEN 18
+#define BROADCAST_ID 0xFFFF
+/* 0x41 0x88 SEQ PANID_L PANID_H 2*DEST 2*SOURCE 0x50 FCS_L FCS_H */
+#define RESP_MSG_LEN 12
+/* 0x41 0x88 SEQ PANID_L PANID_H 2*DEST 2*SOURCE 0x69 4*POLL_TX 4*FINAL_TX TWR_RESPONDERS*4*RESP_RX FCS_L FCS_H
+ * RESP_RX of each anchor at its index, 0 if its Response was not received */
+#define FINAL_MSG_LEN (18 + 4*TWR_RESPONDERS + 2)
+#define FINAL_MSG_POLL_TX_TS_IDX 10
+#define FINAL_MSG_FINAL_TX_TS_IDX 14
+#define FINAL_MSG_RESP_RX_TS_IDX(index) (18 + 4*(index))
+/* 0x41 0x88 SEQ PANID_L PANID_H 2*DEST 2*SOURCE 0x62 NEXT_POLL_DELAY_L NEXT_POLL_DELAY_H 4*INIT_RX 4*POLL_TX FCS_L FCS_H
+ * The Poll of SS-TWR, DEST is the anchor */
+#define SS_POLL_MSG_LEN 22
+#define SS_POLL_MSG_INIT_RX_TS_IDX 12
+#define SS_POLL_MSG_POLL_TX_TS_IDX 16
+/* Offsets of the frames sent by the tag in the DW1000 TX buffer, see deca_txframe.h */
+#define BLINK_TX_OFFSET 0
+#define POLL_TX_OFFSET 32
+#define FINAL_TX_OFFSET 64
+#define SS_POLL_TX_OFFSET (FINAL_TX_OFFSET + FINAL_MSG_LEN)
+
+/* Slot given by the anchor in the Ranging Init */
+typedef struct {
+    uint16 anchor_id;
+    uint16 short_id;
+    uint8 slot;
+    uint32 superframe_uus;
+    uint64 next_init_ts;    // expected Rx time of the next Ranging Init
+    int misses;             // Ranging Inits missed in a row
+} tag_session_t;
+
 /* Rx Buffer to be used in callbacks */
 #define FRAME_LEN_MAX 127
 static bool rx_received;
-// static uint8 rx_buffer[FRAME_LEN_MAX];
-/* The frame sent in this example is an 802.15.4e standard blink. 
- * It is a 12-byte frame composed of the following fields:
- *     - byte 0: frame type (0xC5 for a blink).
- *     - byte 1: sequence number, incremented for each new frame.
- *     - byte 2 -> 9: device ID.
- *     - byte 10/11: frame check-sum, automatically set by DW1000.
- */
-// static uint8 blink_msg[] = {0xC5, 0, 'D', 'E', 'C', 'A', 'W', 'A', 'V', 'E', 0, 0};
-
-/* 0x41 0x8C SEQ PANID_L PANID_H 2*DEST 2*SOURCE 0x61 FCS_L FCS_H*/
-// static uint8 poll_msg[] = {0x41, 0x88, 0x00, 0xCA, 0xDE, 0x00, 0x00, 0x00, 0x00, 0x61, 0x00, 0x00};
-// static uint8 final_msg[] = {0x41, 0x88, 0x00, 0xCA, 0xDE, 0x00, 0x00, 0x00, 0x00, 0x69, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
 
 /* idmind_tag_callbacks.c */
 void tx_done_cb(const dwt_cb_data_t *cb_data);
@@ -53,15 +160,13 @@ void rx_err_cb(const dwt_cb_data_t *cb_data);
 int rx_message(uint8* rx_buffer);
 
 /* idmind_tag_phases.c */
-// static uint64 tx_to_rx_delay;
-// static uint64 ranging_rx_ts;
-// static uint64 poll_tx_ts;
 void print_msg(char* msg, int size);
-uint64 get_tx_timestamp_u64(void);
-uint64 get_rx_timestamp_u64(void);
-void final_msg_get_ts(const uint8 *ts_field, uint32 *ts);
-int discovery_phase(int* seq_nr, uint32* dev_id, int* anchor_id);
-int ranging_phase(int* seq_nr, uint32* dev_id, int* anchor_id);
+void turnarounds_init(void);
+void tx_frames_load(void);
+void print_tx_stats(void);
+int discovery_phase(int seq_nr, tag_session_t *session);
+int slot_phase(tag_session_t *session);
+int ranging_phase(tag_session_t *session);
 
 /* idmind_tag.c */
 void print_header(void);
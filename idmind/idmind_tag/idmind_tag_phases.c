@@ -6,6 +6,43 @@
 
 #include "idmind_tag.h"
 
+static uint8 rx_buffer[FRAME_LEN_MAX];
+/* Turnarounds of the tag, see turnarounds_init() */
+static turnaround_t poll_dly;
+static turnaround_t final_dly;
+/* Late Poll or Final sent again in the same exchange, Final never sent */
+static uint32 tx_retries;
+static uint32 tx_errors;
+
+/* The Blink is an 802.15.4e standard blink, with the device ID */
+static uint8 blink_msg[BLINK_MSG_LEN] = {
+    0xC5, 0x00,
+    (DEV_ID) & 0xFF, (DEV_ID >> 8) & 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00
+};
+/* Broadcast, the source is set in real time */
+static uint8 poll_msg[POLL_MSG_LEN] = {
+    0x41, 0x88, 0x00, PAN_ID & 0xFF, (PAN_ID >> 8) & 0xFF,
+    BROADCAST_ID & 0xFF, (BROADCAST_ID >> 8) & 0xFF, 0x00, 0x00, 0x61,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00
+};
+/* Same header, the timestamps are set in real time */
+static uint8 final_msg[FINAL_MSG_LEN] = {
+    0x41, 0x88, 0x00, PAN_ID & 0xFF, (PAN_ID >> 8) & 0xFF,
+    BROADCAST_ID & 0xFF, (BROADCAST_ID >> 8) & 0xFF, 0x00, 0x00, 0x69
+};
+/* Poll of SS-TWR, to the anchor, with the timestamps of the tag */
+static uint8 ss_poll_msg[SS_POLL_MSG_LEN] = {
+    0x41, 0x88, 0x00, PAN_ID & 0xFF, (PAN_ID >> 8) & 0xFF,
+    0x00, 0x00, 0x00, 0x00, 0x62
+};
+/* The frames stay in the TX buffer, see tx_frames_load() */
+static txframe_t blink_frame;
+static txframe_t poll_frame;
+static txframe_t final_frame;
+static txframe_t ss_poll_frame;
+
 /*! --------------------------------------------------------------------------
  * @fn print_msg()
  * @brief Auxiliary function to print messages
@@ -21,93 +58,347 @@ void print_msg(char* msg, int size)
 
 
 /*! --------------------------------------------------------------------------
- * @fn get_tx_timestamp_u64()
- *
- * @brief Get the TX time-stamp in a 64-bit variable.
- *        /!\ This function assumes that length of time-stamps is 40 bits, 
- *            for both TX and RX!
- *
+ * @fn turnarounds_init()
+ * @brief Starts the Poll and Final turnarounds at their longest, they are
+ *          shortened while they are sent on time if TURNAROUND_ADAPTIVE
  * @param  none
- *
- * @return  64-bit value of the read time-stamp.
+ * @return none
  */
-uint64 get_tx_timestamp_u64(void)
+void turnarounds_init(void)
 {
-    uint8 ts_tab[5];
-    uint64 ts = 0;
-
-    dwt_readtxtimestamp(ts_tab);
-    for (int i = 4; i >= 0; i--) {
-        ts <<= 8;
-        ts |= ts_tab[i];
-    }
-    return ts;
+    turnaround_init(&poll_dly, INIT_RX_TO_POLL_TX_DLY_UUS,
+                    TURNAROUND_ADAPTIVE ? TURNAROUND_MIN_UUS : INIT_RX_TO_POLL_TX_DLY_UUS);
+    turnaround_init(&final_dly, RESP_RX_TO_FINAL_TX_DLY_UUS,
+                    TURNAROUND_ADAPTIVE ? TURNAROUND_MIN_UUS : RESP_RX_TO_FINAL_TX_DLY_UUS);
 }
 
 /*! --------------------------------------------------------------------------
- * @fn get_rx_timestamp_u64()
- *
- * @brief Get the RX time-stamp in a 64-bit variable.
- *        /!\ This function assumes that length of time-stamps is 40 bits, 
- *             for both TX and RX!
- *
+ * @fn tx_frames_load()
+ * @brief Loads the Blink, the Polls and the Final in the TX buffer, only their
+ *          changing bytes are written afterwards
  * @param  none
- *
- * @return  64-bit value of the read time-stamp.
+ * @return none
  */
-uint64 get_rx_timestamp_u64(void)
+void tx_frames_load(void)
 {
-    uint8 ts_tab[5];
-    uint64 ts = 0;
+    txframe_load(&blink_frame, blink_msg, sizeof(blink_msg), BLINK_TX_OFFSET);
+    txframe_load(&poll_frame, poll_msg, sizeof(poll_msg), POLL_TX_OFFSET);
+    txframe_load(&final_frame, final_msg, sizeof(final_msg), FINAL_TX_OFFSET);
+    txframe_load(&ss_poll_frame, ss_poll_msg, sizeof(ss_poll_msg), SS_POLL_TX_OFFSET);
+}
 
-    dwt_readrxtimestamp(ts_tab);
-    for (int i = 4; i >= 0; i--) {
-        ts <<= 8;
-        ts |= ts_tab[i];
+/*! --------------------------------------------------------------------------
+ * @fn turnaround_update()
+ * @brief Records whether a delayed transmission was on time, and prints the
+ *          turnaround when it changes
+ * @param  t  the turnaround
+ *         name  printed with the new value
+ *         late  whether the transmission was late
+ * @return none
+ */
+static void turnaround_update(turnaround_t *t, const char *name, bool late)
+{
+    if (late ? turnaround_late(t) : turnaround_ok(t)) {
+        printk("%s turnaround: %u uus (%u late)\n", name, t->dly_uus, t->late);
     }
-    return ts;
 }
 
 /*! --------------------------------------------------------------------------
- * @fn final_msg_get_ts()
- *
- * @brief Read a given timestamp value from the final message. 
- *        In the timestamp fields of the final message, the least
- *        significant byte is at the lower address.
- *
- * @param  ts_field  pointer on the first byte of the timestamp field to read
- *         ts  timestamp value
- *
+ * @fn print_tx_stats()
+ * @brief Prints the late delayed transmissions per cause, the ones sent again
+ *          in the same exchange and the transmissions never completed, since
+ *          the previous call
+ * @param  none
  * @return none
  */
-void final_msg_get_ts(const uint8 *ts_field, uint32 *ts)
+void print_tx_stats(void)
+{
+    static uint32 prev_late[DWT_TXLATE_NUM], prev_retries, prev_errors;
+    uint32 late[DWT_TXLATE_NUM];
+
+    dwt_readtxlatecounters(late);
+    printk("Late Tx: schedule %u | HPW %u | Retried: %u | Tx errors: %u\n",
+           late[DWT_TXLATE_SCHEDULE] - prev_late[DWT_TXLATE_SCHEDULE], late[DWT_TXLATE_HPW] - prev_late[DWT_TXLATE_HPW],
+           tx_retries - prev_retries, tx_errors - prev_errors);
+    memcpy(prev_late, late, sizeof(late));
+    prev_retries = tx_retries;
+    prev_errors = tx_errors;
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn wait_tx_done()
+ * @brief Waits for the end of the last frame of an exchange, before the next
+ *          slot is set up
+ * @param  name  of the frame, printed if it is not sent
+ * @return 0 if the frame was sent, -1 otherwise
+ */
+static int wait_tx_done(const char *name)
 {
-    *ts = 0;
-    for (int i = 0; i < 4; i++) {
-        *ts += ts_field[i] << (i * 8);
+    uint32 tx_start = k_uptime_get_32();
+
+    while (!(dwt_read32bitreg(SYS_STATUS_ID) & SYS_STATUS_TXFRS)) {
+        if ((k_uptime_get_32() - tx_start) > TX_DONE_TIMEOUT_MS) {
+            printk("%s Message not sent.\n", name);
+            dwt_forcetrxoff();
+            tx_errors++;
+            return -1;
+        }
     }
+    dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_TXFRS);
+    return 0;
 }
 
 /*! --------------------------------------------------------------------------
  * @fn discovery_phase()
- * @brief In the discovery phase, the tag sends blink messages and waits for 
- *          ranging init reply 
- * @param  none
+ * @brief In the discovery phase, the tag sends a blink message and waits for
+ *          the ranging init reply, which gives it a slot
+ * @param  seq_nr  sequence number of the blink
+ *         session  filled with the slot given by the anchor
  * @return 0 if successful pairing, -1 otherwise
  */
-int discovery_phase(int* seq_nr, uint32* dev_id, int* anchor_id)
+int discovery_phase(int seq_nr, tag_session_t *session)
 {
+    uint64 dest_id = 0;
+
+    // Send Blink Message
+    blink_msg[1] = seq_nr;
+    txframe_patch(&blink_frame, 1, 1);
+    txframe_select(&blink_frame, 0);
+    dwt_setrxaftertxdelay(TX_TO_RX_DELAY_UUS);
+    dwt_setrxtimeout(RX_RESP_TIMEOUT_UUS);
+    printk("Sending Blink: ");
+    print_msg(blink_msg, sizeof(blink_msg));
+    if (dwt_starttx(DWT_START_TX_IMMEDIATE | DWT_RESPONSE_EXPECTED) == DWT_ERROR) {
+        printk("Error sending Blink");
+        return -1;
+    }
+
+    if (rx_message(rx_buffer) != 0) {
+        printk("Did not receive Ranging Init message.\n");
+        return -1;
+    }
+    // If message received is our Ranging Init, prepare for Ranging Phase
+    for (int i = 0; i < 8; i++) dest_id += ((uint64)rx_buffer[5+i] << 8*i);
+    if (!((rx_buffer[0] == 0x41) && (rx_buffer[1] == 0x8C) && (rx_buffer[15] == 0x20) && (dest_id == DEV_ID))) {
+        printk("Expected a Ranging Init, received smothing else:\n");
+        print_msg(rx_buffer, dwt_read32bitreg(RX_FINFO_ID) & RX_FINFO_RXFL_MASK_1023);
+        return -1;
+    }
+    print_msg(rx_buffer, RANGING_INIT_LEN);
+    session->anchor_id = rx_buffer[13] + (rx_buffer[14] << 8);
+    session->short_id = rx_buffer[16] + (rx_buffer[17] << 8);
+    session->slot = rx_buffer[20];
+    session->superframe_uus = 0;
+    for (int i = 0; i < 4; i++) session->superframe_uus += ((uint32)rx_buffer[23+i] << 8*i);
+    session->misses = 0;
+    printk("Received a Ranging Init from Anchor %u, set id to %u, slot %u of %u uus\n",
+           session->anchor_id, session->short_id, session->slot, session->superframe_uus);
     return 0;
 }
 
 /*! --------------------------------------------------------------------------
- * @fn ranging_phase()
- * @brief In the ranging phase, the tag sends poll message, waits a response and 
- *          sends final message.
- * @param  none
- * @return 0 if successful pairing, -1 otherwise
+ * @fn slot_phase()
+ * @brief Sleeps until shortly before the tag's slot, then listens for its
+ *          ranging init. On a miss, the slot of the next superframe is
+ *          expected instead.
+ * @param  session  slot given by the anchor
+ * @return 0 if the ranging init was received, -1 otherwise
  */
-int ranging_phase(int* seq_nr, uint32* dev_id, int* anchor_id)
+int slot_phase(tag_session_t *session)
 {
+    uint64 rx_on_ts = ts_add(session->next_init_ts, -(int64)TDMA_GUARD_UUS*UUS_TO_DWT_TIME);
+    int64 wait_dtu = ts_diff(rx_on_ts, (uint64)dwt_readsystimestamphi32() << 8);
+
+    if (wait_dtu >= 0) {
+        uint32 wait_ms = (uint32)(wait_dtu / DWT_TIME_PER_MS);
+        if (wait_ms > 2) Sleep(wait_ms - 2);
+    }
+    dwt_setrxtimeout(3*TDMA_GUARD_UUS);
+    dwt_setdelayedtrxtime((uint32)(rx_on_ts >> 8));
+    if ((dwt_rxenable(DWT_START_RX_DELAYED | DWT_IDLE_ON_DLY_ERR) == DWT_ERROR) || (rx_message(rx_buffer) != 0) ||
+        !((rx_buffer[0] == 0x41) && (rx_buffer[1] == 0x8C) && (rx_buffer[15] == 0x20)) ||
+        ((rx_buffer[16] + (rx_buffer[17] << 8)) != session->short_id)) {
+        // Missed the slot, try the one of the next superframe. The late flags are sticky.
+        dwt_write16bitoffsetreg(SYS_STATUS_ID, 3, SYS_STATUS_TXERR);
+        session->next_init_ts = ts_add(session->next_init_ts, (int64)session->superframe_uus*UUS_TO_DWT_TIME);
+        session->misses++;
+        return -1;
+    }
+    session->misses = 0;
     return 0;
-}
\ No newline at end of file
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn sstwr_phase()
+ * @brief In SS-TWR, the tag answers the ranging init with a single poll
+ *          message to the anchor, holding the Ranging Init Rx and the Poll
+ *          Tx timestamps: the anchor gets the range from it. The Poll is
+ *          sent at a precomputed time, and sent again if it is late and
+ *          can still be received.
+ * @param  session  slot given by the anchor
+ *         init_rx_ts  Rx timestamp of the ranging init, in rx_buffer
+ *         poll_tx_time  delayed Tx time of the Poll
+ *         poll_delay_uus  its turnaround, given in the ranging init
+ * @return 0 if the poll message was sent, -1 otherwise
+ */
+static int sstwr_phase(tag_session_t *session, uint64 init_rx_ts, uint64 poll_tx_time, uint16 poll_delay_uus)
+{
+    uint64 poll_tx_ts = ts_add(poll_tx_time, TX_ANT_DLY);
+    int late;
+
+    ss_poll_msg[2] = rx_buffer[2];
+    for (int i = 0; i < 2; i++) ss_poll_msg[5+i] = (session->anchor_id >> 8*i) & 0xFF;
+    for (int i = 0; i < 2; i++) ss_poll_msg[7+i] = (session->short_id >> 8*i) & 0xFF;
+    for (int i = 0; i < 2; i++) ss_poll_msg[10+i] = (poll_dly.dly_uus >> 8*i) & 0xFF;
+    ts_set32(&ss_poll_msg[SS_POLL_MSG_INIT_RX_TS_IDX], init_rx_ts);
+    ts_set32(&ss_poll_msg[SS_POLL_MSG_POLL_TX_TS_IDX], poll_tx_ts);
+    txframe_patch(&ss_poll_frame, 2, SS_POLL_MSG_LEN - 3);
+    txframe_select(&ss_poll_frame, 1);
+    dwt_setdelayedtrxtime((uint32)(poll_tx_time >> 8));
+    late = (dwt_starttx(DWT_START_TX_DELAYED) == DWT_ERROR);
+    if (late || (poll_delay_uus <= poll_dly.dly_uus)) {
+        turnaround_update(&poll_dly, "Poll", late);
+    }
+    if (late && (TX_RETRY_SLIP_UUS > 0) && (txretry_time(&poll_tx_time, TX_RETRY_SLIP_UUS) == 0)) {
+        // The Poll carries its own TX timestamp
+        poll_tx_ts = ts_add(poll_tx_time, TX_ANT_DLY);
+        ts_set32(&ss_poll_msg[SS_POLL_MSG_POLL_TX_TS_IDX], poll_tx_ts);
+        txframe_patch(&ss_poll_frame, SS_POLL_MSG_POLL_TX_TS_IDX, SS_POLL_MSG_POLL_TX_TS_IDX + 3);
+        dwt_setdelayedtrxtime((uint32)(poll_tx_time >> 8));
+        late = (dwt_starttx(DWT_START_TX_DELAYED) == DWT_ERROR);
+        tx_retries += !late;
+    }
+    if (late) {
+        printk("Error sending Poll Message.\n");
+        return -1;
+    }
+    return wait_tx_done("Poll");
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn ranging_phase()
+ * @brief In the ranging phase, the tag answers the ranging init with a
+ *          broadcast poll message, waits the response of each anchor in its
+ *          response slot and sends a single final message with its
+ *          timestamps. Poll and Final are sent at precomputed times, so
+ *          their TX timestamps are known before they are sent. The Poll
+ *          gives the anchors the turnarounds of the exchange. A Poll or a
+ *          Final which is late is sent again if it can still be received.
+ *          The anchor may ask for SS-TWR instead, see sstwr_phase().
+ * @param  session  slot given by the anchor, the next ranging init is
+ *          expected at the time given by this one
+ * @return 0 if the final message was sent, -1 otherwise
+ */
+int ranging_phase(tag_session_t *session)
+{
+    uint64 init_rx_ts, poll_tx_time, poll_tx_ts, final_tx_time, final_tx_ts;
+    uint16 poll_delay_uus, resp_delay_uus, final_delay_uus = final_dly.dly_uus;
+    uint32 next_slot_uus = 0;
+    int late, responses = 0;
+
+    // Ranging Init is in rx_buffer, received at init_rx_ts
+    init_rx_ts = ts_read_rx();
+    poll_delay_uus = TURNAROUND_CLAMP(rx_buffer[18] + (rx_buffer[19] << 8), INIT_RX_TO_POLL_TX_DLY_UUS);
+    resp_delay_uus = TURNAROUND_CLAMP(rx_buffer[31] + (rx_buffer[32] << 8), POLL_RX_TO_RESP_TX_DLY_UUS);
+    for (int i = 0; i < 4; i++) next_slot_uus += ((uint32)rx_buffer[27+i] << 8*i);
+    session->next_init_ts = ts_add(init_rx_ts, (int64)next_slot_uus*UUS_TO_DWT_TIME);
+
+    /* Tag sends a Poll mesage, delayed by poll_delay_uus from the Ranging
+     * Init. The low 9 bits of the delayed time are ignored. */
+    poll_tx_time = ts_add(init_rx_ts, (int64)poll_delay_uus*UUS_TO_DWT_TIME) & ~(uint64)0x1FF;
+    poll_tx_ts = ts_add(poll_tx_time, TX_ANT_DLY);
+    if (rx_buffer[RANGING_INIT_MODE_IDX] == TWR_MODE_SS) {
+        return sstwr_phase(session, init_rx_ts, poll_tx_time, poll_delay_uus);
+    }
+    poll_msg[2] = rx_buffer[2];
+    final_msg[2] = rx_buffer[2];
+    for (int i = 0; i < 2; i++) poll_msg[7+i] = final_msg[7+i] = (session->short_id >> 8*i) & 0xFF;
+    for (int i = 0; i < 2; i++) poll_msg[10+i] = (resp_delay_uus >> 8*i) & 0xFF;
+    for (int i = 0; i < 2; i++) poll_msg[12+i] = (final_delay_uus >> 8*i) & 0xFF;
+    for (int i = 0; i < 2; i++) poll_msg[14+i] = (poll_dly.dly_uus >> 8*i) & 0xFF;
+    txframe_patch(&poll_frame, 2, POLL_MSG_LEN - 3);
+    txframe_select(&poll_frame, 1);
+    dwt_setrxaftertxdelay(RESP_RX_DLY_UUS(resp_delay_uus));
+    dwt_setrxtimeout(RESP_RX_TIMEOUT_UUS);
+    dwt_setdelayedtrxtime((uint32)(poll_tx_time >> 8));
+    late = (dwt_starttx(DWT_START_TX_DELAYED | DWT_RESPONSE_EXPECTED) == DWT_ERROR);
+    /* The Poll delay was asked for in the previous Poll, on time with a
+     * longer one says nothing of the current one */
+    if (late || (poll_delay_uus <= poll_dly.dly_uus)) {
+        turnaround_update(&poll_dly, "Poll", late);
+    }
+    /* Still in the Rx window of the anchors a little later, the rest of
+     * the exchange follows the Poll actually sent */
+    if (late && (TX_RETRY_SLIP_UUS > 0) && (txretry_time(&poll_tx_time, TX_RETRY_SLIP_UUS) == 0)) {
+        dwt_setdelayedtrxtime((uint32)(poll_tx_time >> 8));
+        late = (dwt_starttx(DWT_START_TX_DELAYED | DWT_RESPONSE_EXPECTED) == DWT_ERROR);
+        poll_tx_ts = ts_add(poll_tx_time, TX_ANT_DLY);
+        tx_retries += !late;
+    }
+    if (late) {
+        printk("Error sending Poll Message.\n");
+        return -1;
+    }
+
+    /* Final message, with the timestamps of the tag, including its own.
+     * It is sent at a fixed time after the Poll: all but the Response
+     * timestamps are written while the Responses are awaited. */
+    final_tx_time = ts_add(poll_tx_time, (int64)POLL_TX_TO_FINAL_TX_DLY_UUS(resp_delay_uus, final_delay_uus)*UUS_TO_DWT_TIME) &
+                    ~(uint64)0x1FF;
+    final_tx_ts = ts_add(final_tx_time, TX_ANT_DLY);
+    ts_set32(&final_msg[FINAL_MSG_POLL_TX_TS_IDX], poll_tx_ts);
+    ts_set32(&final_msg[FINAL_MSG_FINAL_TX_TS_IDX], final_tx_ts);
+    txframe_patch(&final_frame, 2, FINAL_MSG_FINAL_TX_TS_IDX + 3);
+
+    /* Wait for the Response of each anchor in its slot. The receiver is
+     * turned on by DWT_RESPONSE_EXPECTED for the first one, at a fixed
+     * time for the others. */
+    for (int index = 0; index < TWR_RESPONDERS; index++) {
+        uint64 resp_rx_ts = 0;
+
+        if (index > 0) {
+            uint64 rx_on_ts = ts_add(poll_tx_time, (int64)(RESP_RX_DLY_UUS(resp_delay_uus) + index*RESP_SLOT_UUS)*UUS_TO_DWT_TIME);
+
+            dwt_setdelayedtrxtime((uint32)(rx_on_ts >> 8));
+            if (dwt_rxenable(DWT_START_RX_DELAYED | DWT_IDLE_ON_DLY_ERR) == DWT_ERROR) {
+                dwt_write16bitoffsetreg(SYS_STATUS_ID, 3, SYS_STATUS_TXERR);
+                ts_set32(&final_msg[FINAL_MSG_RESP_RX_TS_IDX(index)], 0);
+                txframe_patch(&final_frame, FINAL_MSG_RESP_RX_TS_IDX(index), FINAL_MSG_RESP_RX_TS_IDX(index) + 3);
+                continue;
+            }
+        }
+        if ((rx_message(rx_buffer) == 0) &&
+            (rx_buffer[0] == 0x41) && (rx_buffer[1] == 0x88) && (rx_buffer[9] == 0x50) &&
+            ((rx_buffer[5] + (rx_buffer[6] << 8)) == session->short_id) &&
+            (ANCHOR_INDEX(rx_buffer[7] + (rx_buffer[8] << 8)) == index)) {
+            resp_rx_ts = ts_read_rx();
+            responses++;
+        }
+        // Written in the TX buffer before the next response slot
+        ts_set32(&final_msg[FINAL_MSG_RESP_RX_TS_IDX(index)], resp_rx_ts);
+        txframe_patch(&final_frame, FINAL_MSG_RESP_RX_TS_IDX(index), FINAL_MSG_RESP_RX_TS_IDX(index) + 3);
+    }
+    if (responses == 0) {
+        printk("Did not receive any Response message.\n");
+        return -1;
+    }
+
+    txframe_select(&final_frame, 1);
+    dwt_setdelayedtrxtime((uint32)(final_tx_time >> 8));
+    late = (dwt_starttx(DWT_START_TX_DELAYED) == DWT_ERROR);
+    turnaround_update(&final_dly, "Final", late);
+    if (late && (TX_RETRY_SLIP_UUS > 0) && (txretry_time(&final_tx_time, TX_RETRY_SLIP_UUS) == 0)) {
+        // The Final carries its own TX timestamp
+        final_tx_ts = ts_add(final_tx_time, TX_ANT_DLY);
+        ts_set32(&final_msg[FINAL_MSG_FINAL_TX_TS_IDX], final_tx_ts);
+        txframe_patch(&final_frame, FINAL_MSG_FINAL_TX_TS_IDX, FINAL_MSG_FINAL_TX_TS_IDX + 3);
+        dwt_setdelayedtrxtime((uint32)(final_tx_time >> 8));
+        late = (dwt_starttx(DWT_START_TX_DELAYED) == DWT_ERROR);
+        tx_retries += !late;
+    }
+    if (late) {
+        printk("Error sending Final Message.\n");
+        return -1;
+    }
+    return wait_tx_done("Final");
+}
@@ -10,11 +10,32 @@
 #include "deca_regs.h"
 #include "deca_spi.h"
 #include "port.h"
+#include "deca_ranging.h"
+#include "deca_timestamp.h"
 
 // zephyr includes
 #include <zephyr.h>
 #include <sys/printk.h>
 
+/* Timer of bench_math_cycles() */
+#if defined(CONFIG_CPU_CORTEX_M_HAS_DWT)
+#include <soc.h>
+#define BENCH_TIMER_INIT()  do { CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; \
+                                 DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk; } while (0)
+#define BENCH_TIMER()       DWT->CYCCNT
+#define BENCH_TIMER_UNIT    "cycles"
+#elif defined(CONFIG_BOARD_NATIVE_POSIX)
+/* The Zephyr clocks stand still while the code runs: host time */
+#include "dw1000_model.h"
+#define BENCH_TIMER_INIT()
+#define BENCH_TIMER()       ((uint32)dw1000_model_host_ns())
+#define BENCH_TIMER_UNIT    "ns"
+#else
+#define BENCH_TIMER_INIT()
+#define BENCH_TIMER()       k_cycle_get_32()
+#define BENCH_TIMER_UNIT    "hw cycles"
+#endif
+
 #define LOG_LEVEL 3
 #include <logging/log.h>
 LOG_MODULE_REGISTER(main);
@@ -64,6 +85,18 @@ static uint8 rx_buffer[RX_BUF_LEN];
 
 #define PERIOD 500
 #define SPEED_OF_LIGHT 299702547
+
+/* Benchmark mode: back-to-back DS-TWR exchanges with twr_resp_calib, without
+ * PERIOD, until BENCH_COUNT exchanges or BENCH_DURATION_MS have run (0 for no
+ * limit), followed by a report. Both 0 for the normal mode.
+ * e.g. cmake -B build -DBENCH_COUNT=1000 . */
+#ifndef BENCH_COUNT
+#define BENCH_COUNT 0
+#endif
+#ifndef BENCH_DURATION_MS
+#define BENCH_DURATION_MS 0
+#endif
+#define BENCH_MODE ((BENCH_COUNT > 0) || (BENCH_DURATION_MS > 0))
 /*! --------------------------------------------------------------------------
  * @fn print_header()
  *
@@ -132,7 +165,7 @@ int start_dwm(void)
         k_sleep(K_MSEC(500)); // allow logging to run.
         while (1) { };
     }
-    port_set_dw1000_fastrate();
+    port_set_dw1000_maxrate();
     printk("Success!\n");
     return 0;
 }
@@ -169,76 +202,349 @@ int config_dwm(void)
     return 0;
 }
 
+#if BENCH_MODE
+/* Latency histograms, in microseconds: values below 4 have their own bucket,
+ * then each power of 2 is split in 4 buckets, within 25% up to 2^21 us. */
+#define BENCH_HIST_BUCKETS 80
+
+typedef struct {
+    uint32 count[BENCH_HIST_BUCKETS];
+    uint32 n;
+    uint32 max_us;
+} bench_hist_t;
+
+enum {
+    BENCH_OK,
+    BENCH_TIMEOUT,
+    BENCH_ERROR,
+};
+
+/* Frames of twr_resp_calib */
+static uint8 bench_poll_msg[] = {0x41, 0x88, 0, 0x80, 0x63, 0x02, 0x00, 0x01, 0x00, 0x21, 0, 0};
+static uint8 bench_final_msg[] = {0x41, 0x88, 0, 0x80, 0x63, 'W', 'A', 'V', 'E',
+                                  0x23, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+#define FINAL_MSG_POLL_TX_TS_IDX 10
+#define FINAL_MSG_RESP_RX_TS_IDX 14
+#define FINAL_MSG_FINAL_TX_TS_IDX 18
+
+/* Ranging math timed against the double reference, runs per measure */
+#define BENCH_MATH_RUNS 1000
+
+static bench_hist_t hist_poll_resp;
+static bench_hist_t hist_resp_final;
+static bench_hist_t hist_end_to_end;
+
 /*! --------------------------------------------------------------------------
- * @fn get_tx_timestamp_u64()
+ * @fn bench_bucket()
  *
- * @brief Get the TX time-stamp in a 64-bit variable.
- *        /!\ This function assumes that length of time-stamps is 40 bits, 
- *            for both TX and RX!
+ * @brief Histogram bucket of a latency
  *
- * @param  none
+ * @param  us  latency in microseconds
  *
- * @return  64-bit value of the read time-stamp.
+ * @return the bucket
  */
-static uint64 get_tx_timestamp_u64(void)
+static int bench_bucket(uint32 us)
 {
-    uint8 ts_tab[5];
-    uint64 ts = 0;
-    int i;
-
-    dwt_readtxtimestamp(ts_tab);
-    for (i = 4; i >= 0; i--) {
-        ts <<= 8;
-        ts |= ts_tab[i];
+    int msb;
+
+    if (us < 4) {
+        return us;
     }
-    return ts;
+    msb = 31 - __builtin_clz(us);
+    return MIN(4*(msb - 1) + ((us >> (msb - 2)) & 3), BENCH_HIST_BUCKETS - 1);
 }
 
 /*! --------------------------------------------------------------------------
- * @fn get_rx_timestamp_u64()
+ * @fn bench_bucket_low()
  *
- * @brief Get the RX time-stamp in a 64-bit variable.
- *        /!\ This function assumes that length of time-stamps is 40 bits,
- *        for both TX and RX!
+ * @brief Lowest latency of a histogram bucket
  *
- * @param  none
+ * @param  bucket  the bucket
+ *
+ * @return latency in microseconds
+ */
+static uint32 bench_bucket_low(int bucket)
+{
+    if (bucket < 4) {
+        return bucket;
+    }
+    return (uint32)(4 + (bucket & 3)) << (bucket/4 - 1);
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn bench_hist_add()
+ *
+ * @brief Adds a latency to a histogram
+ *
+ * @param  hist  the histogram
+ *         us  latency in microseconds
+ *
+ * @return none
+ */
+static void bench_hist_add(bench_hist_t *hist, uint32 us)
+{
+    hist->count[bench_bucket(us)]++;
+    hist->n++;
+    hist->max_us = MAX(hist->max_us, us);
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn bench_hist_percentile()
+ *
+ * @brief Gets a percentile of a histogram, as the top of its bucket
  *
- * @return  64-bit value of the read time-stamp.
+ * @param  hist  the histogram
+ *         pct  the percentile
+ *
+ * @return latency in microseconds, 0 if the histogram is empty
  */
-static uint64 get_rx_timestamp_u64(void)
+static uint32 bench_hist_percentile(const bench_hist_t *hist, uint32 pct)
 {
-    uint8 ts_tab[5];
-    uint64 ts = 0;
-    int i;
-
-    dwt_readrxtimestamp(ts_tab);
-    for (i = 4; i >= 0; i--) {
-        ts <<= 8;
-        ts |= ts_tab[i];
+    uint32 rank = (hist->n * pct + 99) / 100;
+    uint32 sum = 0;
+
+    if (hist->n == 0) {
+        return 0;
     }
-    return ts;
+    for (int bucket = 0; bucket < BENCH_HIST_BUCKETS - 1; bucket++) {
+        sum += hist->count[bucket];
+        if (sum >= rank) {
+            return MIN(bench_bucket_low(bucket + 1) - 1, hist->max_us);
+        }
+    }
+    return hist->max_us;
 }
 
 /*! --------------------------------------------------------------------------
- * @fn final_msg_set_ts()
+ * @fn bench_hist_print()
  *
- * @brief Fill a given timestamp field in the final message with the 
- *        given value. In the timestamp fields of the final
- *        message, the least significant byte is at the lower address.
+ * @brief Prints the non-empty buckets of a histogram
  *
- * @param  ts_field  pointer on the first byte of the timestamp field to fill
- *         ts  timestamp value
+ * @param  name  name of the latency
+ *         hist  the histogram
  *
  * @return none
  */
-static void final_msg_set_ts(uint8 *ts_field, uint64 ts)
+static void bench_hist_print(const char *name, const bench_hist_t *hist)
 {
-    for (int i = 0; i < 4; i++) {
-        ts_field[i] = (uint8) ts;
-        ts >>= 8;
+    printk("%s (us): p50 %u | p90 %u | p99 %u | max %u\n", name,
+           bench_hist_percentile(hist, 50), bench_hist_percentile(hist, 90),
+           bench_hist_percentile(hist, 99), hist->max_us);
+    for (int bucket = 0; bucket < BENCH_HIST_BUCKETS; bucket++) {
+        if (hist->count[bucket] != 0) {
+            printk("  %7u - %7u: %u\n", bench_bucket_low(bucket),
+                   (bucket < BENCH_HIST_BUCKETS - 1) ? bench_bucket_low(bucket + 1) - 1 : hist->max_us,
+                   hist->count[bucket]);
+        }
     }
 }
 
+/*! --------------------------------------------------------------------------
+ * @fn bench_dtu_to_us()
+ *
+ * @brief Converts a DW1000 time difference, 1 us = 499.2 * 128 dtu
+ *
+ * @param  dtu  40-bit time difference
+ *
+ * @return microseconds
+ */
+static uint32 bench_dtu_to_us(uint64 dtu)
+{
+    return (uint32)(((dtu & 0xFFFFFFFFFFULL) * 10) / 638976);
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn bench_exchange()
+ *
+ * @brief Runs one DS-TWR exchange with twr_resp_calib: Poll, Response and
+ *        a delayed Final
+ *
+ * @param  seq_nr  sequence number of the frames
+ *         poll_resp_us  Poll TX to Response RX, from the DW1000 timestamps
+ *         resp_final_us  Response RX to the Final handed to the DW1000: the
+ *                        part of RESP_RX_TO_FINAL_TX_DLY_UUS the processing
+ *                        of the Response takes
+ *
+ * @return BENCH_OK, BENCH_TIMEOUT if no Response, BENCH_ERROR otherwise
+ */
+static int bench_exchange(uint8 seq_nr, uint32 *poll_resp_us, uint32 *resp_final_us)
+{
+    uint32 status_reg;
+    uint32 frame_len;
+    uint32 final_tx_time;
+    uint64 poll_tx_ts, resp_rx_ts, final_tx_ts;
+
+    bench_poll_msg[2] = seq_nr;
+    dwt_writetxdata(sizeof(bench_poll_msg), bench_poll_msg, 0);
+    dwt_writetxfctrl(sizeof(bench_poll_msg), 0, 1);
+    if (dwt_starttx(DWT_START_TX_IMMEDIATE | DWT_RESPONSE_EXPECTED) == DWT_ERROR) {
+        return BENCH_ERROR;
+    }
+    while (!((status_reg = dwt_read32bitreg(SYS_STATUS_ID)) & (SYS_STATUS_RXFCG | SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR))){ };
+
+    if (!(status_reg & SYS_STATUS_RXFCG)) {
+        /* Clear RX error/timeout events in the DW1000 status register. */
+        dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR | SYS_STATUS_TXFRS);
+        /* Reset RX to properly reinitialise LDE operation. */
+        dwt_rxreset();
+        return (status_reg & SYS_STATUS_ALL_RX_TO) ? BENCH_TIMEOUT : BENCH_ERROR;
+    }
+    dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_RXFCG | SYS_STATUS_TXFRS);
+
+    /* Check that the frame is the Response to this Poll */
+    frame_len = dwt_read32bitreg(RX_FINFO_ID) & RX_FINFO_RXFLEN_MASK;
+    if (frame_len > RX_BUF_LEN) {
+        return BENCH_ERROR;
+    }
+    dwt_readrxdata(rx_buffer, frame_len, 0);
+    if ((memcmp(rx_buffer, bench_poll_msg, 5) != 0) || (rx_buffer[9] != 0x10) ||
+        (rx_buffer[5] != bench_poll_msg[7]) || (rx_buffer[6] != bench_poll_msg[8]) ||
+        (rx_buffer[7] != bench_poll_msg[5]) || (rx_buffer[8] != bench_poll_msg[6])) {
+        return BENCH_ERROR;
+    }
+
+    /* Final at a fixed delay from the Response, its TX timestamp is the
+     * programmed time plus the TX antenna delay. */
+    poll_tx_ts = ts_read_tx();
+    resp_rx_ts = ts_read_rx();
+    final_tx_time = (uint32)((resp_rx_ts + ((uint64)RESP_RX_TO_FINAL_TX_DLY_UUS * UUS_TO_DWT_TIME)) >> 8);
+    final_tx_ts = (((uint64)(final_tx_time & 0xFFFFFFFEUL)) << 8) + TX_ANT_DLY;
+    ts_set32(&bench_final_msg[FINAL_MSG_POLL_TX_TS_IDX], poll_tx_ts);
+    ts_set32(&bench_final_msg[FINAL_MSG_RESP_RX_TS_IDX], resp_rx_ts);
+    ts_set32(&bench_final_msg[FINAL_MSG_FINAL_TX_TS_IDX], final_tx_ts);
+    bench_final_msg[2] = seq_nr;
+    dwt_writetxdata(sizeof(bench_final_msg), bench_final_msg, 0);
+    dwt_writetxfctrl(sizeof(bench_final_msg), 0, 1);
+    dwt_setdelayedtrxtime(final_tx_time);
+
+    *poll_resp_us = bench_dtu_to_us(ts_interval(resp_rx_ts, poll_tx_ts));
+    *resp_final_us = bench_dtu_to_us(ts_interval((uint64)dwt_readsystimestamphi32() << 8, resp_rx_ts));
+    if (dwt_starttx(DWT_START_TX_DELAYED) == DWT_ERROR) {
+        /* Late, the flags are sticky */
+        dwt_write16bitoffsetreg(SYS_STATUS_ID, 3, SYS_STATUS_TXERR);
+        return BENCH_ERROR;
+    }
+    while (!(dwt_read32bitreg(SYS_STATUS_ID) & SYS_STATUS_TXFRS)){ };
+    dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_TXFRS);
+    return BENCH_OK;
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn bench_math_cycles()
+ *
+ * @brief Times the DS-TWR distance of deca_ranging.h against the double
+ *        precision computation it replaced, the nRF52832 FPU is single
+ *        precision only
+ *
+ * The loops are timed with the DWT cycle counter of the Cortex-M4, which
+ * counts CPU cycles (k_cycle_get_32() runs from the 32 kHz RTC), in host
+ * ns on native_posix, in hardware cycles elsewhere, see BENCH_TIMER().
+ *
+ * @param  fixed  BENCH_TIMER_UNIT per distance, in integers
+ *         dbl  BENCH_TIMER_UNIT per distance, in double
+ *
+ * @return none
+ */
+static void bench_math_cycles(uint32 *fixed, uint32 *dbl)
+{
+    /* An exchange at 10 m with this app's delays. Volatile, so that the
+     * computations are not done at build time. */
+    static volatile uint32 ra = POLL_TX_TO_RESP_RX_DLY_UUS * UUS_TO_DWT_TIME + 2 * 2134;
+    static volatile uint32 db = POLL_TX_TO_RESP_RX_DLY_UUS * UUS_TO_DWT_TIME;
+    static volatile uint32 da = RESP_RX_TO_FINAL_TX_DLY_UUS * UUS_TO_DWT_TIME;
+    static volatile uint32 rb = RESP_RX_TO_FINAL_TX_DLY_UUS * UUS_TO_DWT_TIME + 2 * 2134;
+    static volatile int32 dist_mm;
+    static volatile double dist_m;
+    uint32 t0;
+
+    BENCH_TIMER_INIT();
+
+    t0 = BENCH_TIMER();
+    for (int i = 0; i < BENCH_MATH_RUNS; i++) {
+        dist_mm = ranging_tof_to_mm(ranging_dstwr_tof(ra, rb, da, db));
+    }
+    *fixed = (BENCH_TIMER() - t0) / BENCH_MATH_RUNS;
+
+    t0 = BENCH_TIMER();
+    for (int i = 0; i < BENCH_MATH_RUNS; i++) {
+        double Ra = ra, Rb = rb, Da = da, Db = db;
+
+        dist_m = (Ra * Rb - Da * Db) / (Ra + Rb + Da + Db) * DWT_TIME_UNITS * SPEED_OF_LIGHT;
+    }
+    *dbl = (BENCH_TIMER() - t0) / BENCH_MATH_RUNS;
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn benchmark()
+ *
+ * @brief Runs back-to-back exchanges and prints the exchange rate, the
+ *        outcome ratios and the latency histograms. The last line sums it
+ *        up as key=value pairs, with the raw dwt_config_t values, to
+ *        compare builds and configurations.
+ *
+ * @param  none
+ *
+ * @return none
+ */
+static void benchmark(void)
+{
+    uint32 exchanges = 0, ok = 0, timeouts = 0, errors = 0;
+    uint32 start, elapsed_ms, rate_milli;
+    uint32 math_fixed, math_double;
+    uint8 seq_nr = 0;
+
+    printk("Benchmark: %u exchanges, %u ms (0 for no limit)\n", BENCH_COUNT, BENCH_DURATION_MS);
+    start = k_uptime_get_32();
+    while (((BENCH_COUNT == 0) || (exchanges < BENCH_COUNT)) &&
+           ((BENCH_DURATION_MS == 0) || ((k_uptime_get_32() - start) < BENCH_DURATION_MS))) {
+        uint32 poll_resp_us, resp_final_us;
+        uint32 t0 = k_cycle_get_32();
+
+        exchanges++;
+        switch (bench_exchange(seq_nr++, &poll_resp_us, &resp_final_us)) {
+        case BENCH_OK:
+            ok++;
+            bench_hist_add(&hist_poll_resp, poll_resp_us);
+            bench_hist_add(&hist_resp_final, resp_final_us);
+            bench_hist_add(&hist_end_to_end, k_cyc_to_us_ceil32(k_cycle_get_32() - t0));
+            break;
+        case BENCH_TIMEOUT:
+            timeouts++;
+            break;
+        default:
+            errors++;
+            break;
+        }
+    }
+    elapsed_ms = MAX(k_uptime_get_32() - start, 1);
+    rate_milli = (uint32)(((uint64)exchanges * 1000 * 1000) / elapsed_ms);
+
+    printk("Exchanges: %u in %u ms, %u.%03u per second\n", exchanges, elapsed_ms,
+           rate_milli / 1000, rate_milli % 1000);
+    printk("Success: %u (%u%%) | Timeouts: %u (%u%%) | Errors: %u (%u%%)\n",
+           ok, ok * 100 / exchanges, timeouts, timeouts * 100 / exchanges,
+           errors, errors * 100 / exchanges);
+    bench_hist_print("Poll TX to Response RX", &hist_poll_resp);
+    bench_hist_print("Response RX to Final TX", &hist_resp_final);
+    bench_hist_print("End to end", &hist_end_to_end);
+    bench_math_cycles(&math_fixed, &math_double);
+    printk("Distance math: %u %s in integers | %u %s in double\n",
+           math_fixed, BENCH_TIMER_UNIT, math_double, BENCH_TIMER_UNIT);
+    printk("BENCH app=\"%s\" build=\"%s %s\" chan=%u prf=%u plen=%u pac=%u code=%u nssfd=%u br=%u phr=%u "
+           "resp_final_dly_uus=%u n=%u ok=%u timeout=%u error=%u ms=%u rate_milli=%u "
+           "poll_resp_p50=%u poll_resp_p99=%u resp_final_p50=%u resp_final_p99=%u resp_final_max=%u "
+           "e2e_p50=%u e2e_p99=%u e2e_max=%u math_fixed=%u math_double=%u math_unit=\"%s\"\n",
+           APP_NAME, __DATE__, __TIME__, config.chan, config.prf, config.txPreambLength, config.rxPAC,
+           config.txCode, config.nsSFD, config.dataRate, config.phrMode,
+           RESP_RX_TO_FINAL_TX_DLY_UUS, exchanges, ok, timeouts, errors, elapsed_ms, rate_milli,
+           bench_hist_percentile(&hist_poll_resp, 50), bench_hist_percentile(&hist_poll_resp, 99),
+           bench_hist_percentile(&hist_resp_final, 50), bench_hist_percentile(&hist_resp_final, 99),
+           hist_resp_final.max_us, bench_hist_percentile(&hist_end_to_end, 50),
+           bench_hist_percentile(&hist_end_to_end, 99), hist_end_to_end.max_us, math_fixed, math_double,
+           BENCH_TIMER_UNIT);
+}
+#endif
+
 /*! --------------------------------------------------------------------------
  * @fn main()
  *
@@ -257,6 +563,11 @@ int dw_main(void)
     /* Configure DWM */
     config_dwm();
 
+#if BENCH_MODE
+    benchmark();
+    return 0;
+#endif
+
     /* Messages to be used */
     /* - byte 0/1: frame control (0x8841 to indicate a data frame using 16-bit addressing).
        - byte 2: sequence number, incremented for each new frame.
@@ -333,16 +644,15 @@ int dw_main(void)
                 continue;
             }
             /* Retrieve poll transmission and response reception timestamp. */
-            poll_tx_ts = get_tx_timestamp_u64();
-            resp_rx_ts = get_rx_timestamp_u64();
-            printk("Message TX at %lld and Rx at %lld: %lld.\n", poll_tx_ts, resp_rx_ts, resp_rx_ts-poll_tx_ts);
-            double dt_uuwb = resp_rx_ts-poll_tx_ts;
-            double dt_uus = dt_uuwb/UUS_TO_DWT_TIME;
-            printk("")
+            poll_tx_ts = ts_read_tx();
+            resp_rx_ts = ts_read_rx();
+            printk("Message TX at %lld and Rx at %lld: %lld.\n", poll_tx_ts, resp_rx_ts, ts_interval(resp_rx_ts, poll_tx_ts));
+            /* printk has no floating point conversions */
+            printk("Turnaround: %u uus\n", (uint32)(ts_interval(resp_rx_ts, poll_tx_ts) / UUS_TO_DWT_TIME));
 
 
-            double distance = (resp_rx_ts-poll_tx_ts) * DWT_TIME_UNITS * SPEED_OF_LIGHT / UUS_TO_DWT_TIME;
-            printk("Estimated distance: %fm.\n", distance);
+            double distance = ts_interval(resp_rx_ts, poll_tx_ts) * DWT_TIME_UNITS * SPEED_OF_LIGHT / UUS_TO_DWT_TIME;
+            printk("Estimated distance: %d mm.\n", (int)(distance * 1000));
 
             /* Compute final message transmission time. See NOTE 10 below. */
             uint32 final_tx_time = (resp_rx_ts + 
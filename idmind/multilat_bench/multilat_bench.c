@@ -0,0 +1,183 @@
+/*! ----------------------------------------------------------------------------
+ *  @file       multilat_bench.c
+ *  @brief      Host benchmark of the position solver (platform/deca_multilat.c):
+ *              solves per second and accuracy over synthetic anchor layouts
+ *  @author     cneves
+ *
+ *  Not a Zephyr application: on native_posix the kernel clock stands still
+ *  while the CPU computes. Build and run on the host, see README.rst:
+ *      multilat_bench [solves per layout] [range noise (mm)]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "deca_multilat.h"
+
+#define DEFAULT_SOLVES 20000
+#define DEFAULT_NOISE_MM 100
+#define MAX_SOLVES 1000000
+
+/* Anchors, and the volume the tags are drawn in (m) */
+typedef struct {
+    const char *name;
+    int n;
+    multilat_point_t anchors[MULTILAT_MAX_ANCHORS];
+    multilat_point_t min;
+    multilat_point_t max;
+} layout_t;
+
+/* Anchors alternate between two heights, or 3-D can not tell above from below */
+static const layout_t layouts[] = {
+    {"room 10x8 m, 4 anchors", 4,
+     {{0, 0, 2.5f}, {10, 0, 0.5f}, {10, 8, 2.5f}, {0, 8, 0.5f}},
+     {1, 1, 0.5f}, {9, 7, 2.0f}},
+    {"hall 30x20 m, 6 anchors", 6,
+     {{0, 0, 3.0f}, {15, 0, 1.0f}, {30, 0, 3.0f}, {30, 20, 1.0f}, {15, 20, 3.0f}, {0, 20, 1.0f}},
+     {1, 1, 0.5f}, {29, 19, 2.0f}},
+    {"corridor 40x3 m, 6 anchors", 6,
+     {{0, 0, 2.5f}, {20, 0, 0.5f}, {40, 0, 2.5f}, {40, 3, 0.5f}, {20, 3, 2.5f}, {0, 3, 0.5f}},
+     {1, 0.5f, 0.5f}, {39, 2.5f, 2.0f}},
+    {"warehouse 100x60 m, 8 anchors", 8,
+     {{0, 0, 8.0f}, {50, 0, 2.0f}, {100, 0, 8.0f}, {100, 30, 2.0f},
+      {100, 60, 8.0f}, {50, 60, 2.0f}, {0, 60, 8.0f}, {0, 30, 2.0f}},
+     {2, 2, 0.5f}, {98, 58, 2.0f}},
+};
+
+/* Synthetic exchanges, generated before the timed loop */
+static multilat_point_t truth[MAX_SOLVES];
+static float ranges[MAX_SOLVES][MULTILAT_MAX_ANCHORS];
+static multilat_result_t results[MAX_SOLVES];
+static int status[MAX_SOLVES];
+static double errors[MAX_SOLVES];
+
+/*! --------------------------------------------------------------------------
+ * @fn uniform()
+ * @brief Uniform random number
+ * @param  lo, hi  bounds
+ * @return the number
+ */
+static double uniform(double lo, double hi)
+{
+    return lo + (hi - lo) * (rand() + 0.5) / (RAND_MAX + 1.0);
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn gauss()
+ * @brief Normal random number, Box-Muller
+ * @param  none
+ * @return the number, mean 0 and standard deviation 1
+ */
+static double gauss(void)
+{
+    return sqrt(-2.0 * log(uniform(0, 1))) * cos(2.0 * M_PI * uniform(0, 1));
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn now_s()
+ * @brief Host monotonic time
+ * @param  none
+ * @return seconds
+ */
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn compare()
+ * @brief qsort() order of the errors
+ */
+static int compare(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn bench()
+ * @brief Solves the positions of random tags in a layout and prints a line
+ *          of results: solves per second, failures, rms and 95th percentile
+ *          error, and the mean squared error over the trace of the covariance,
+ *          about 1 if the covariance is right
+ * @param  layout  the anchors and the volume of the tags
+ *         dims  2 (the height of the tag is known) or 3
+ *         count  number of tags
+ *         noise  standard deviation of the ranges (m)
+ * @return none
+ */
+static void bench(const layout_t *layout, int dims, int count, double noise)
+{
+    float vars[MULTILAT_MAX_ANCHORS];
+    double start, elapsed, sum2 = 0.0, nees = 0.0;
+    int ok = 0;
+
+    for (int i = 0; i < layout->n; i++) vars[i] = (float)(noise * noise);
+    for (int t = 0; t < count; t++) {
+        truth[t].x = uniform(layout->min.x, layout->max.x);
+        truth[t].y = uniform(layout->min.y, layout->max.y);
+        truth[t].z = uniform(layout->min.z, layout->max.z);
+        for (int i = 0; i < layout->n; i++) {
+            double dx = truth[t].x - layout->anchors[i].x;
+            double dy = truth[t].y - layout->anchors[i].y;
+            double dz = truth[t].z - layout->anchors[i].z;
+
+            ranges[t][i] = (float)(sqrt(dx*dx + dy*dy + dz*dz) + noise * gauss());
+        }
+    }
+
+    start = now_s();
+    for (int t = 0; t < count; t++) {
+        status[t] = (dims == 2) ?
+            multilat_solve_2d(layout->anchors, ranges[t], vars, layout->n, truth[t].z, &results[t]) :
+            multilat_solve_3d(layout->anchors, ranges[t], vars, layout->n, &results[t]);
+    }
+    elapsed = now_s() - start;
+
+    for (int t = 0; t < count; t++) {
+        double dx, dy, dz, err2, trace;
+
+        if (status[t] != 0) {
+            continue;
+        }
+        dx = results[t].pos.x - truth[t].x;
+        dy = results[t].pos.y - truth[t].y;
+        dz = (dims == 3) ? results[t].pos.z - truth[t].z : 0.0;
+        err2 = dx*dx + dy*dy + dz*dz;
+        trace = results[t].cov[0][0] + results[t].cov[1][1] + results[t].cov[2][2];
+        errors[ok++] = sqrt(err2);
+        sum2 += err2;
+        nees += err2 / trace;
+    }
+    qsort(errors, ok, sizeof(errors[0]), compare);
+
+    printf("%-32s %dD %10.0f %6.2f%% %8.3f %8.3f %6.2f\n", layout->name, dims, count / elapsed,
+           100.0 * (count - ok) / count, (ok > 0) ? sqrt(sum2 / ok) : 0.0,
+           (ok > 0) ? errors[(int)(0.95 * (ok - 1))] : 0.0, (ok > 0) ? nees / ok : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+    int count = (argc > 1) ? atoi(argv[1]) : DEFAULT_SOLVES;
+    double noise = ((argc > 2) ? atoi(argv[2]) : DEFAULT_NOISE_MM) / 1000.0;
+
+    if ((count <= 0) || (count > MAX_SOLVES)) {
+        fprintf(stderr, "solves per layout: 1 to %d\n", MAX_SOLVES);
+        return 1;
+    }
+    srand(1);
+    printf("%d solves per layout, range noise %.0f mm\n", count, noise * 1000.0);
+    printf("%-32s %-2s %10s %7s %8s %8s %6s\n", "layout", "", "solves/s", "failed", "rms (m)", "p95 (m)", "nees");
+    for (int l = 0; l < (int)(sizeof(layouts) / sizeof(layouts[0])); l++) {
+        bench(&layouts[l], 2, count, noise);
+        bench(&layouts[l], 3, count, noise);
+    }
+    return 0;
+}
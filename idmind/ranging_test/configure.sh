@@ -0,0 +1 @@
+cmake -B build .
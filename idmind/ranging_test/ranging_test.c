@@ -0,0 +1,322 @@
+/*! ----------------------------------------------------------------------------
+ *  @file       ranging_test.c
+ *  @brief      Host test of the fixed point ranging (platform/deca_ranging.c)
+ *              against a long double reference
+ *  @author     cneves
+ *
+ *  Not a Zephyr application. Build and run on the host, see README.rst:
+ *      ranging_test [exchanges per case]
+ *  Exits with 1 if any result is further from the reference than its limit.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "deca_device_api.h"
+#include "deca_ranging.h"
+#include "deca_timestamp.h"
+
+#define DEFAULT_EXCHANGES 200000
+
+#define TOF_ONE             ((long double)((int64)1 << RANGING_TOF_FRAC_BITS))
+#define OFFSET_ONE          ((long double)((int64)1 << RANGING_OFFSET_FRAC_BITS))
+#define SPEED_OF_LIGHT      (299702547.0L)
+#define DTU_PER_S           (1.0L / DWT_TIME_UNITS)
+#define CARRIER_MAX         ((1L << 20) - 1)        /* the carrier integrator is 21 bits, signed */
+
+/* Limits of the errors. The time of flight keeps RANGING_TOF_FRAC_BITS fractional bits, truncated. The distance is
+ * rounded to the millimetre, and RANGING_DTU_TO_MM is 7.4e-7 under its exact value: 0.74 mm more at 1 km. The same for
+ * RANGING_DTU_TO_PS, 2.5e-8 under. */
+#define LIMIT_TOF_DTU       (2.0L / TOF_ONE)
+#define LIMIT_OFFSET_LSB    (0.5L + 1e-6L)
+#define LIMIT_MM            (0.5L + 0.75L)
+#define LIMIT_PS            (0.5L + 0.1L)
+/* Times of flight the edge cases stay under (dtu), 78 km */
+#define TOF_MAX             ((long double)(1 << 24))
+
+/* Results of one case */
+typedef struct {
+    const char *name;
+    long count;
+    long failed;
+    long double worst;
+    long double limit;
+    const char *unit;
+} result_t;
+
+static int failures;
+
+/*! --------------------------------------------------------------------------
+ * @fn uniform()
+ * @brief Uniform random number
+ * @param  lo, hi  bounds
+ * @return the number
+ */
+static long double uniform(long double lo, long double hi)
+{
+    return lo + (hi - lo) * (rand() + 0.5L) / (RAND_MAX + 1.0L);
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn timestamp()
+ * @brief Random 40 bit timestamp, a quarter of them within a second of the wrap
+ * @param  none
+ * @return the timestamp
+ */
+static uint64 timestamp(void)
+{
+    if ((rand() & 3) == 0) {
+        return ts_add(0, (int64)uniform(-DTU_PER_S, 0));
+    }
+    return (((uint64)rand() << 31) ^ (uint64)rand()) & TS_MASK;
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn check()
+ * @brief Counts a result, and a failure if it is further from the reference
+ *          than the limit of the case
+ * @param  r  the case
+ *         got, ref  the result and its reference
+ * @return none
+ */
+static void check(result_t *r, long double got, long double ref)
+{
+    long double err = fabsl(got - ref);
+
+    r->count++;
+    if (err > r->worst) {
+        r->worst = err;
+    }
+    if (!(err <= r->limit)) {
+        if (r->failed++ < 5) {
+            printf("  %s: %.6Lf, reference %.6Lf\n", r->name, got, ref);
+        }
+    }
+}
+
+static void report(const result_t *r)
+{
+    printf("%-34s %9ld %12.3Le %12.3Le %-4s %7ld\n", r->name, r->count, r->worst, r->limit, r->unit, r->failed);
+    failures += r->failed;
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn ds_reference()
+ * @brief (Ra * Rb - Da * Db) / (Ra + Rb + Da + Db), in dtu
+ */
+static long double ds_reference(uint64 ra, uint64 rb, uint64 da, uint64 db)
+{
+    long double sum = (long double)ra + rb + da + db;
+
+    if (sum == 0) {
+        return 0;
+    }
+    return ((long double)ra * rb - (long double)da * db) / sum;
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn exchange()
+ * @brief Timestamps of a DS-TWR exchange between an initiator A and a
+ *          responder B with random clock offsets, from random 40 bit origins,
+ *          and the intervals of their pairs (see deca_ranging.h)
+ * @param  tof_m  distance between the devices (m)
+ *         reply_min, reply_max  bounds of the reply delays Db and Da (dtu)
+ *         iv  Ra, Rb, Da, Db
+ *         offset_b  clock offset of B relative to A
+ * @return none
+ */
+static void exchange(long double tof_m, long double reply_min, long double reply_max, uint64 iv[4],
+                     long double *offset_b)
+{
+    long double ea = uniform(-20e-6L, 20e-6L), eb = uniform(-20e-6L, 20e-6L);
+    long double tof = tof_m / SPEED_OF_LIGHT * DTU_PER_S;
+    long double db = uniform(reply_min, reply_max), da = uniform(reply_min, reply_max);
+    uint64 poll_tx = timestamp(), poll_rx = timestamp();
+    uint64 resp_tx, resp_rx, final_tx, final_rx;
+
+    /* Reply delays in the clock of the device which times them, flights in true time */
+    resp_tx = ts_add(poll_rx, (int64)llroundl(db));
+    resp_rx = ts_add(poll_tx, (int64)llroundl((2 * tof + db / (1 + eb)) * (1 + ea)));
+    final_tx = ts_add(resp_rx, (int64)llroundl(da));
+    final_rx = ts_add(resp_tx, (int64)llroundl((2 * tof + da / (1 + ea)) * (1 + eb)));
+
+    iv[0] = ts_interval(resp_rx, poll_tx);
+    iv[1] = ts_interval(final_rx, resp_tx);
+    iv[2] = ts_interval(final_tx, resp_rx);
+    iv[3] = ts_interval(resp_tx, poll_rx);
+    *offset_b = (1 + eb) / (1 + ea) - 1;
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn test_dstwr()
+ * @brief ranging_dstwr_tof() over random exchanges with reply delays in
+ *          [reply_min, reply_max] (dtu)
+ */
+static void test_dstwr(const char *name, long double reply_min, long double reply_max, int count)
+{
+    result_t r = {name, 0, 0, 0, LIMIT_TOF_DTU, "dtu"};
+
+    for (int i = 0; i < count; i++) {
+        uint64 iv[4];
+        long double offset;
+
+        exchange(uniform(-1, 300), reply_min, reply_max, iv, &offset);
+        check(&r, ranging_dstwr_tof(iv[0], iv[1], iv[2], iv[3]) / TOF_ONE, ds_reference(iv[0], iv[1], iv[2], iv[3]));
+    }
+    report(&r);
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn test_dstwr_edges()
+ * @brief ranging_dstwr_tof() at the bounds of its intervals: 0, 2^32 and
+ *          2^39 dtu, and the largest intervals of a 40 bit timestamp, in the
+ *          combinations which give times of flight under TOF_MAX
+ */
+static void test_dstwr_edges(void)
+{
+    static const uint64 values[] = {
+        0, 1, 2, 1000, 0xFFFFFFFFULL, 0x100000000ULL, 0x100000001ULL,
+        (1ULL << 39) - 1, 1ULL << 39, (1ULL << 39) + 1, TS_MASK - 1, TS_MASK,
+    };
+    const int n = sizeof(values) / sizeof(values[0]);
+    result_t r = {"ranging_dstwr_tof, edges", 0, 0, 0, LIMIT_TOF_DTU, "dtu"};
+
+    for (int a = 0; a < n; a++) {
+        for (int b = 0; b < n; b++) {
+            for (int c = 0; c < n; c++) {
+                for (int d = 0; d < n; d++) {
+                    uint64 ra = values[a], rb = values[b], da = values[c], db = values[d];
+                    long double ref = ds_reference(ra, rb, da, db);
+
+                    /* Ra and Rb are round trips, longer than the reply delays of the same exchange */
+                    if ((ra < db) || (rb < da) || (fabsl(ref) > TOF_MAX)) {
+                        continue;
+                    }
+                    check(&r, ranging_dstwr_tof(ra, rb, da, db) / TOF_ONE, ref);
+                }
+            }
+        }
+    }
+    /* 2^39 dtu reply delays with a few dtu of flight, across the wrap */
+    for (int tof = 0; tof < 1000; tof++) {
+        uint64 ra = (1ULL << 39) + 2 * tof, db = 1ULL << 39;
+        uint64 rb = (1ULL << 39) - 7 + 2 * tof, da = (1ULL << 39) - 7;
+
+        check(&r, ranging_dstwr_tof(ra, rb, da, db) / TOF_ONE, ds_reference(ra, rb, da, db));
+        check(&r, ranging_dstwr_tof(ts_interval(ts_add(TS_MASK - 3, ra), TS_MASK - 3), rb, da, db) / TOF_ONE,
+              ds_reference(ra, rb, da, db));
+    }
+    report(&r);
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn test_sstwr()
+ * @brief ranging_sstwr_tof() and ranging_sstwr_offset_tof() over random
+ *          exchanges, the offset taken from the carrier integrator the
+ *          responder's frame would give on channel 5 at 6.8 Mbps
+ */
+static void test_sstwr(const char *name, const char *name_offset, long double reply_min, long double reply_max,
+                       int count)
+{
+    result_t r = {name, 0, 0, 0, LIMIT_TOF_DTU, "dtu"};
+    result_t ro = {name_offset, 0, 0, 0, LIMIT_TOF_DTU, "dtu"};
+
+    for (int i = 0; i < count; i++) {
+        uint64 iv[4];
+        long double offset_b;
+        int32 carrier, offset;
+
+        exchange(uniform(-1, 300), reply_min, reply_max, iv, &offset_b);
+        check(&r, ranging_sstwr_tof(iv[0], iv[3]) / TOF_ONE, ((long double)iv[0] - iv[3]) / 2);
+
+        carrier = (int32)lroundl(offset_b * 1e6L / (FREQ_OFFSET_MULTIPLIER * HERTZ_TO_PPM_MULTIPLIER_CHAN_5));
+        offset = ranging_clock_offset(carrier, 5, DWT_BR_6M8);
+        check(&ro, ranging_sstwr_offset_tof(iv[0], iv[3], offset) / TOF_ONE,
+              ((long double)iv[0] - iv[3] * (1 - offset / OFFSET_ONE)) / 2);
+    }
+    report(&r);
+    report(&ro);
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn test_clock_offset()
+ * @brief ranging_clock_offset() on every channel and data rate, against the
+ *          FREQ_OFFSET_MULTIPLIER and HERTZ_TO_PPM_MULTIPLIER_CHAN_x of the
+ *          driver
+ */
+static void test_clock_offset(int count)
+{
+    static const struct {
+        uint8 chan;
+        long double hz_to_ppm;
+    } chans[] = {
+        {1, HERTZ_TO_PPM_MULTIPLIER_CHAN_1}, {2, HERTZ_TO_PPM_MULTIPLIER_CHAN_2},
+        {3, HERTZ_TO_PPM_MULTIPLIER_CHAN_3}, {4, HERTZ_TO_PPM_MULTIPLIER_CHAN_2},
+        {5, HERTZ_TO_PPM_MULTIPLIER_CHAN_5}, {7, HERTZ_TO_PPM_MULTIPLIER_CHAN_5},
+    };
+    static const uint8 rates[] = {DWT_BR_110K, DWT_BR_850K, DWT_BR_6M8};
+    result_t r = {"ranging_clock_offset", 0, 0, 0, LIMIT_OFFSET_LSB, "lsb"};
+
+    for (int c = 0; c < (int)(sizeof(chans) / sizeof(chans[0])); c++) {
+        for (int k = 0; k < (int)sizeof(rates); k++) {
+            long double hz = (rates[k] == DWT_BR_110K) ? FREQ_OFFSET_MULTIPLIER_110KB : FREQ_OFFSET_MULTIPLIER;
+
+            for (int i = 0; i < count; i++) {
+                int32 carrier = (i < 3) ? (int32)(i - 1) * CARRIER_MAX : (int32)lroundl(uniform(-CARRIER_MAX, CARRIER_MAX));
+                long double ref = carrier * hz * chans[c].hz_to_ppm * 1e-6L * OFFSET_ONE;
+
+                check(&r, ranging_clock_offset(carrier, chans[c].chan, rates[k]), ref);
+            }
+        }
+    }
+    /* Channels the DW1000 does not have */
+    check(&r, ranging_clock_offset(CARRIER_MAX, 0, DWT_BR_6M8), 0);
+    check(&r, ranging_clock_offset(CARRIER_MAX, 6, DWT_BR_6M8), 0);
+    report(&r);
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn test_distance()
+ * @brief ranging_tof_to_mm() and ranging_tof_to_ps() from -10 m to 1 km
+ */
+static void test_distance(int count)
+{
+    result_t rmm = {"ranging_tof_to_mm", 0, 0, 0, LIMIT_MM, "mm"};
+    result_t rps = {"ranging_tof_to_ps", 0, 0, 0, LIMIT_PS, "ps"};
+
+    for (int i = 0; i < count; i++) {
+        long double s = uniform(-10, 1000) / SPEED_OF_LIGHT;
+        int64 tof = (int64)llroundl(s * DTU_PER_S * TOF_ONE);
+        long double exact = tof / TOF_ONE / DTU_PER_S;
+
+        check(&rmm, ranging_tof_to_mm(tof), exact * SPEED_OF_LIGHT * 1000);
+        check(&rps, ranging_tof_to_ps(tof), exact * 1e12L);
+    }
+    report(&rmm);
+    report(&rps);
+}
+
+int main(int argc, char **argv)
+{
+    int count = (argc > 1) ? atoi(argv[1]) : DEFAULT_EXCHANGES;
+    const long double ms = DTU_PER_S / 1000;
+
+    if (count <= 0) {
+        fprintf(stderr, "exchanges per case: 1 or more\n");
+        return 1;
+    }
+    srand(1);
+    printf("%d exchanges per case, ranges -1 to 300 m, clock offsets within 20 ppm\n", count);
+    printf("%-34s %9s %12s %12s %-4s %7s\n", "case", "count", "worst error", "limit", "", "failed");
+    test_dstwr("ranging_dstwr_tof, replies < 2^32", 0.1L * ms, 60 * ms, count);
+    test_dstwr("ranging_dstwr_tof, replies < 2^39", 70 * ms, (1ULL << 39) - 1000, count);
+    test_dstwr_edges();
+    test_sstwr("ranging_sstwr_tof, replies < 2^32", "ranging_sstwr_offset_tof, < 2^32", 0.1L * ms, 60 * ms, count);
+    test_sstwr("ranging_sstwr_tof, replies < 2^39", "ranging_sstwr_offset_tof, < 2^39", 70 * ms,
+               (1ULL << 39) - 1000, count);
+    test_clock_offset(count / 10);
+    test_distance(count);
+    printf("%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,275 @@
+/*! ----------------------------------------------------------------------------
+ *  @file       spi_bench.c
+ *  @brief      Benchmark of the SPI transport per dwt_* call
+ *  @author     cneves
+ *
+ *  See README.rst. Runs each dwt_* call of the table BENCH_ROUNDS times and
+ *  prints its time per call:
+ *  - on the DWM1001, measured with the DWT cycle counter of the CPU;
+ *  - on native_posix, modelled: the bus time of the DW1000 model, with the
+ *    driver time of DW1000_SIM_SPI_CALL_US per call of the SPI backend,
+ *    along with the backend calls, the SPI transactions, the bytes on the
+ *    bus and the bytes copied by the CPU in the transport.
+ *
+ *  Built with -DDWT_BATCH_MAX_XFER=1 the driver issues each register access
+ *  of its batches (dwt_configure(), dwt_isr()) on its own, as before
+ *  batching. On native_posix, built with -DDECA_SPI_SIM_STAGING the
+ *  transport copies as deca_spi.c did with its 255-byte staging buffers,
+ *  otherwise it passes the caller's buffers through as the scatter-gather
+ *  lists of deca_spi.c now do.
+ *
+ *  dwt_isr() is timed on a received frame: another device must be
+ *  transmitting, see README.rst.
+ */
+
+#include "deca_device_api.h"
+#include "deca_regs.h"
+#include "deca_spi.h"
+#include "port.h"
+
+#include <zephyr.h>
+#include <sys/printk.h>
+
+#if defined(CONFIG_BOARD_NATIVE_POSIX)
+#include "dw1000_model.h"
+#include "deca_spi_sim.h"
+#include "posix_board_if.h"
+#elif defined(CONFIG_CPU_CORTEX_M_HAS_DWT)
+#include <soc.h>
+#endif
+
+#define APP_NAME "SPI BENCH v1.1\n"
+
+#define BENCH_ROUNDS        100
+#define BENCH_ISR_ROUNDS    20          /* frames received for dwt_isr()   */
+#define BENCH_RX_WAIT_MS    1000        /* wait for each of them           */
+#define ACC_READ_LEN    (1 + 992 * 4)   /* dummy octet and the CIR at 16 MHz PRF */
+
+/* Default communication configuration, as in the ranging applications */
+static dwt_config_t config = {
+    5,               /* Channel number. */
+    DWT_PRF_64M,     /* Pulse repetition frequency. */
+    DWT_PLEN_128,    /* Preamble length. Used in TX only. */
+    DWT_PAC8,        /* Preamble acquisition chunk size. Used in RX only. */
+    9,               /* TX preamble code. Used in TX only. */
+    9,               /* RX preamble code. Used in RX only. */
+    1,               /* 0 to use standard SFD, 1 to use non-standard SFD. */
+    DWT_BR_6M8,      /* Data rate. */
+    DWT_PHRMODE_STD, /* PHY header mode. */
+    (129)            /* SFD timeout (preamble length + 1 + SFD length - PAC size).
+                        Used in RX only. */
+};
+
+static uint8 buffer[ACC_READ_LEN];
+static uint8 rx_buffer[128];
+static uint8 timestamp[5];
+static dwt_rxdiag_t diagnostics;
+
+/* Counters of one or more calls */
+typedef struct {
+    uint32 time;                        /* ticks of BENCH_TIMER()          */
+#if defined(CONFIG_BOARD_NATIVE_POSIX)
+    dw1000_model_spi_stats_t bus;
+    deca_spi_sim_stats_t     sim;
+#endif
+} bench_sample_t;
+
+#if defined(CONFIG_BOARD_NATIVE_POSIX)
+/* Time stands still while the code runs: the time is the modelled bus time */
+#define BENCH_TIMER_INIT()
+#define BENCH_TIMER()       0
+#elif defined(CONFIG_CPU_CORTEX_M_HAS_DWT)
+#define BENCH_TIMER_INIT()  do { CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; \
+                                 DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk; } while (0)
+#define BENCH_TIMER()       DWT->CYCCNT
+#define BENCH_TIMER_MHZ     (SystemCoreClock / 1000000)
+#else
+#error "spi_bench needs the DWT cycle counter or native_posix"
+#endif
+
+static void bench_readdevid(void)    { dwt_readdevid(); }
+static void bench_systime(void)      { dwt_readsystimestamphi32(); }
+static void bench_rxtimestamp(void)  { dwt_readrxtimestamp(timestamp); }
+static void bench_diagnostics(void)  { dwt_readdiagnostics(&diagnostics); }
+static void bench_writetx_12(void)   { dwt_writetxdata(12, buffer, 0); }
+static void bench_writetx_127(void)  { dwt_writetxdata(127, buffer, 0); }
+static void bench_writetx_1023(void) { dwt_writetxdata(1023, buffer, 0); }
+static void bench_readrx_12(void)    { dwt_readrxdata(buffer, 12, 0); }
+static void bench_readrx_127(void)   { dwt_readrxdata(buffer, 127, 0); }
+static void bench_readrx_1021(void)  { dwt_readrxdata(buffer, 1021, 0); }
+static void bench_readacc(void)      { dwt_readaccdata(buffer, ACC_READ_LEN, 0); }
+static void bench_configure(void)    { dwt_configure(&config); }
+static void bench_isr(void)          { dwt_isr(); }
+
+/* The frame is read by dwt_isr() into rx_buffer, as in the applications */
+static void bench_rx_ok(const dwt_cb_data_t *cb_data)
+{
+    ARG_UNUSED(cb_data);
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn bench_wait_frame()
+ * @brief Turns the receiver on and waits for a good frame, without
+ *          clearing its events: the next dwt_isr() handles it
+ * @return 1 if a frame was received, 0 if none came within BENCH_RX_WAIT_MS
+ */
+static int bench_wait_frame(void)
+{
+    dwt_rxenable(DWT_START_RX_IMMEDIATE);
+
+    for (int ms = 0; ms < BENCH_RX_WAIT_MS; ms++) {
+        uint32 status = dwt_read32bitreg(SYS_STATUS_ID);
+
+        if (status & SYS_STATUS_RXFCG) {
+            return 1;
+        }
+        if (status & (SYS_STATUS_ALL_RX_ERR | SYS_STATUS_ALL_RX_TO)) {
+            dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_ERR | SYS_STATUS_ALL_RX_TO);
+            dwt_rxenable(DWT_START_RX_IMMEDIATE);
+        }
+        k_msleep(1);
+    }
+
+    dwt_forcetrxoff();
+    return 0;
+}
+
+typedef struct {
+    const char * name;
+    int       (* prepare)(void);        /* before each call, not timed     */
+    void      (* call)(void);
+    int          rounds;
+} bench_case_t;
+
+static const bench_case_t bench_cases[] = {
+    { "dwt_readdevid()",                NULL, bench_readdevid,    BENCH_ROUNDS },
+    { "dwt_readsystimestamphi32()",     NULL, bench_systime,      BENCH_ROUNDS },
+    { "dwt_readrxtimestamp()",          NULL, bench_rxtimestamp,  BENCH_ROUNDS },
+    { "dwt_readdiagnostics()",          NULL, bench_diagnostics,  BENCH_ROUNDS },
+    { "dwt_writetxdata(), 12 bytes",    NULL, bench_writetx_12,   BENCH_ROUNDS },
+    { "dwt_writetxdata(), 127 bytes",   NULL, bench_writetx_127,  BENCH_ROUNDS },
+    { "dwt_writetxdata(), 1023 bytes",  NULL, bench_writetx_1023, BENCH_ROUNDS },
+    { "dwt_readrxdata(), 12 bytes",     NULL, bench_readrx_12,    BENCH_ROUNDS },
+    { "dwt_readrxdata(), 127 bytes",    NULL, bench_readrx_127,   BENCH_ROUNDS },
+    { "dwt_readrxdata(), 1021 bytes",   NULL, bench_readrx_1021,  BENCH_ROUNDS },
+    { "dwt_readaccdata(), 3969 bytes",  NULL, bench_readacc,      BENCH_ROUNDS },
+    { "dwt_configure()",                NULL, bench_configure,    BENCH_ROUNDS },
+    { "dwt_isr(), frame received",      bench_wait_frame, bench_isr, BENCH_ISR_ROUNDS },
+};
+
+static void bench_sample(bench_sample_t *sample)
+{
+    sample->time = BENCH_TIMER();
+#if defined(CONFIG_BOARD_NATIVE_POSIX)
+    dw1000_model_spi_stats(&sample->bus);
+    deca_spi_sim_stats(&sample->sim);
+#endif
+}
+
+/* Adds the counters from before to after to sum */
+static void bench_add(bench_sample_t *sum, const bench_sample_t *before, const bench_sample_t *after)
+{
+    sum->time += after->time - before->time;
+#if defined(CONFIG_BOARD_NATIVE_POSIX)
+    sum->bus.calls += after->bus.calls - before->bus.calls;
+    sum->bus.count += after->bus.count - before->bus.count;
+    sum->bus.bytes += after->bus.bytes - before->bus.bytes;
+    sum->bus.busy_us += after->bus.busy_us - before->bus.busy_us;
+    sum->sim.copied += after->sim.copied - before->sim.copied;
+    sum->sim.over += after->sim.over - before->sim.over;
+#endif
+}
+
+/*! --------------------------------------------------------------------------
+ * @fn bench_run()
+ * @brief Runs one case, prints its counters per call
+ * @param  bench  the case
+ * @return none
+ */
+static void bench_run(const bench_case_t *bench)
+{
+    bench_sample_t sum = { 0 };
+    bench_sample_t before, after;
+    uint32 n = 0;
+    uint32 us10;
+
+    for (int i = 0; i < bench->rounds; i++) {
+        /* No frame: nobody is transmitting, do not wait for the others */
+        if ((bench->prepare != NULL) && !bench->prepare()) {
+            break;
+        }
+        bench_sample(&before);
+        bench->call();
+        bench_sample(&after);
+        bench_add(&sum, &before, &after);
+        n++;
+    }
+
+    if (n == 0) {
+        printk("%-32s no frame received\n", bench->name);
+        return;
+    }
+
+    /* us per call, in tenths */
+#if defined(CONFIG_BOARD_NATIVE_POSIX)
+    us10 = (uint32)(sum.bus.busy_us * 10 / n + 0.5);
+
+    printk("%-32s %5u %5u %6u %5u.%u %8u %8u\n", bench->name,
+           (uint32)(sum.bus.calls / n), (uint32)(sum.bus.count / n), (uint32)(sum.bus.bytes / n),
+           us10 / 10, us10 % 10, sum.sim.copied / n, sum.sim.over / n);
+#else
+    us10 = (uint32)((uint64)sum.time * 10 / BENCH_TIMER_MHZ / n);
+
+    printk("%-32s %5u %5u.%u\n", bench->name, n, us10 / 10, us10 % 10);
+#endif
+}
+
+int dw_main(void)
+{
+    printk(APP_NAME);
+
+    openspi();
+    reset_DW1000();
+
+    port_set_dw1000_slowrate();
+    if (dwt_initialise(DWT_LOADUCODE) == DWT_ERROR) {
+        printk("err - init failed\n");
+        return -1;
+    }
+    port_set_dw1000_fastrate();
+    dwt_configure(&config);
+    dwt_setcallbacks(NULL, bench_rx_ok, NULL, NULL);
+    dwt_setcallbackrxbuffer(rx_buffer, sizeof(rx_buffer));
+
+    BENCH_TIMER_INIT();
+
+#ifdef DWT_BATCH_MAX_XFER
+    printk("batches: up to %u register accesses\n", DWT_BATCH_MAX_XFER);
+#else
+    printk("batches: default size (deca_device.c)\n");
+#endif
+#if defined(CONFIG_BOARD_NATIVE_POSIX)
+#ifdef DECA_SPI_SIM_STAGING
+    printk("transport: %u-byte staging buffers (former deca_spi.c)\n", DECA_SPI_SIM_STAGING_LEN);
+#else
+    printk("transport: scatter-gather, caller's buffers\n");
+#endif
+    printk("time: modelled, bus time of the DW1000 model at %u Hz\n", get_spi_speed());
+    printk("per call:\n");
+    printk("%-32s %5s %5s %6s %7s %8s %8s\n", "call", "calls", "xfers", "bus B", "bus us", "copied B", "over 255");
+#else
+    printk("time: measured, CPU cycle counter at %u MHz, SPI at %u Hz\n", BENCH_TIMER_MHZ, get_spi_speed());
+    printk("per call:\n");
+    printk("%-32s %5s %7s\n", "call", "n", "us");
+#endif
+
+    for (uint32 i = 0; i < ARRAY_SIZE(bench_cases); i++) {
+        bench_run(&bench_cases[i]);
+    }
+
+#if defined(CONFIG_BOARD_NATIVE_POSIX)
+    posix_exit(0);
+#endif
+
+    return 0;
+}
@@ -0,0 +1,311 @@
+/*! ----------------------------------------------------------------------------
+ * @file	deca_multilat.c
+ * @brief	Position of a tag from its ranges to anchors at known coordinates, see deca_multilat.h
+ *
+ * @attention
+ *
+ * All rights reserved.
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "deca_multilat.h"
+
+/* A Cholesky pivot this small, relative to its diagonal element, means the anchors do not fix the position */
+#define MULTILAT_PIVOT_MIN          (1e-5f)
+/* Halvings of a Gauss-Newton step which does not lower the cost */
+#define MULTILAT_MAX_HALVING        (8)
+/* Ranges shorter than this give no direction to the tag (m) */
+#define MULTILAT_DIST_MIN           (1e-3f)
+
+/* Anchors relative to their centroid, and the tag's height in 2-D */
+typedef struct
+{
+    float a[MULTILAT_MAX_ANCHORS][3];
+    float origin[3];
+    int n;
+    int dims;
+} multilat_frame_t;
+
+/* Cholesky factor l of the symmetric positive definite h (dims x dims). Returns -1 if h is not. */
+static int multilat_factor(float h[3][3], int dims, float l[3][3])
+{
+    for (int j = 0; j < dims; j++)
+    {
+        float s = h[j][j];
+
+        for (int k = 0; k < j; k++)
+        {
+            s -= l[j][k] * l[j][k];
+        }
+        if (!(s > MULTILAT_PIVOT_MIN * h[j][j]))
+        {
+            return -1;
+        }
+        l[j][j] = sqrtf(s);
+        for (int i = j + 1; i < dims; i++)
+        {
+            float t = h[i][j];
+
+            for (int k = 0; k < j; k++)
+            {
+                t -= l[i][k] * l[j][k];
+            }
+            l[i][j] = t / l[j][j];
+        }
+    }
+    return 0;
+}
+
+/* Solves l * l^T * x = b */
+static void multilat_subst(float l[3][3], int dims, const float b[3], float x[3])
+{
+    float y[3];
+
+    for (int i = 0; i < dims; i++)
+    {
+        y[i] = b[i];
+        for (int k = 0; k < i; k++)
+        {
+            y[i] -= l[i][k] * y[k];
+        }
+        y[i] /= l[i][i];
+    }
+    for (int i = dims - 1; i >= 0; i--)
+    {
+        x[i] = y[i];
+        for (int k = i + 1; k < dims; k++)
+        {
+            x[i] -= l[k][i] * x[k];
+        }
+        x[i] /= l[i][i];
+    }
+}
+
+/* First guess: |p - a_i|^2 = r_i^2, minus their mean over i, is linear in p once the anchors are centred:
+ * 2 * a_i . p = |a_i|^2 - mean(|a|^2) - r_i^2 + mean(r^2). In 2-D, the ranges are first brought to the tag's
+ * height. */
+static int multilat_guess(const multilat_frame_t *f, const float *r2, float p[3])
+{
+    float h[3][3] = {{0.0f}}, l[3][3] = {{0.0f}}, g[3] = {0.0f};
+    float mean_a2 = 0.0f, mean_r2 = 0.0f;
+
+    for (int i = 0; i < f->n; i++)
+    {
+        for (int k = 0; k < f->dims; k++)
+        {
+            mean_a2 += f->a[i][k] * f->a[i][k];
+        }
+        mean_r2 += r2[i];
+    }
+    mean_a2 /= f->n;
+    mean_r2 /= f->n;
+
+    for (int i = 0; i < f->n; i++)
+    {
+        float b = -mean_a2 - r2[i] + mean_r2;
+
+        for (int k = 0; k < f->dims; k++)
+        {
+            b += f->a[i][k] * f->a[i][k];
+        }
+        for (int j = 0; j < f->dims; j++)
+        {
+            for (int k = 0; k < f->dims; k++)
+            {
+                h[j][k] += 4.0f * f->a[i][j] * f->a[i][k];
+            }
+            g[j] += 2.0f * f->a[i][j] * b;
+        }
+    }
+    if (multilat_factor(h, f->dims, l) != 0)
+    {
+        return -1;
+    }
+    multilat_subst(l, f->dims, g, p);
+    return 0;
+}
+
+/* Weighted sum of the squared range residuals r_i - |p - a_i| at p, and the normal equations of the Gauss-Newton
+ * step from p if h is not NULL. ssr gets the unweighted sum. */
+static float multilat_normal(const multilat_frame_t *f, const float *ranges, const float *vars, const float p[3],
+                             float h[3][3], float g[3], float *ssr)
+{
+    float cost = 0.0f;
+
+    if (h != NULL)
+    {
+        memset(h, 0, 3 * sizeof(h[0]));
+        memset(g, 0, 3 * sizeof(g[0]));
+    }
+    *ssr = 0.0f;
+    for (int i = 0; i < f->n; i++)
+    {
+        float d[3], dist, res, w;
+
+        d[0] = p[0] - f->a[i][0];
+        d[1] = p[1] - f->a[i][1];
+        d[2] = p[2] - f->a[i][2];
+        dist = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+        res = ranges[i] - dist;
+        w = (vars != NULL) ? 1.0f / vars[i] : 1.0f;
+        *ssr += res * res;
+        cost += w * res * res;
+        if ((h == NULL) || (dist < MULTILAT_DIST_MIN))
+        {
+            continue;
+        }
+        for (int j = 0; j < f->dims; j++)
+        {
+            for (int k = 0; k < f->dims; k++)
+            {
+                h[j][k] += w * d[j] * d[k] / (dist * dist);
+            }
+            g[j] += w * res * d[j] / dist;
+        }
+    }
+    return cost;
+}
+
+static int multilat_solve(const multilat_point_t *anchors, const float *ranges, const float *vars, int n, int dims,
+                          float z, multilat_result_t *result)
+{
+    multilat_frame_t f;
+    float r2[MULTILAT_MAX_ANCHORS];
+    float h[3][3], l[3][3] = {{0.0f}}, g[3], p[3] = {0.0f}, step[3];
+    float cost, ssr, norm, scale;
+    int converged = 0;
+
+    if ((n <= dims) || (n > MULTILAT_MAX_ANCHORS))
+    {
+        return -1;
+    }
+
+    /* Anchors relative to their centroid, in 2-D the tag's height is fixed and stays in the third coordinate */
+    f.n = n;
+    f.dims = dims;
+    memset(f.origin, 0, sizeof(f.origin));
+    for (int i = 0; i < n; i++)
+    {
+        f.origin[0] += anchors[i].x / n;
+        f.origin[1] += anchors[i].y / n;
+        f.origin[2] += anchors[i].z / n;
+    }
+    if (dims == 2)
+    {
+        f.origin[2] = z;
+    }
+    for (int i = 0; i < n; i++)
+    {
+        f.a[i][0] = anchors[i].x - f.origin[0];
+        f.a[i][1] = anchors[i].y - f.origin[1];
+        f.a[i][2] = anchors[i].z - f.origin[2];
+        r2[i] = ranges[i] * ranges[i];
+        if (dims == 2)
+        {
+            r2[i] -= f.a[i][2] * f.a[i][2];
+        }
+    }
+    if (multilat_guess(&f, r2, p) != 0)
+    {
+        return -1;
+    }
+
+    /* Gauss-Newton, each step halved until it lowers the cost: far from the anchors' plane, a poorly fixed height
+     * makes full steps overshoot. The last pass leaves the normal matrix at p for the covariance. */
+    result->iterations = 0;
+    cost = multilat_normal(&f, ranges, vars, p, h, g, &ssr);
+    while (1)
+    {
+        float trial[3], trial_cost, trial_ssr;
+
+        if (multilat_factor(h, dims, l) != 0)
+        {
+            return -1;
+        }
+        if (converged || (result->iterations == MULTILAT_MAX_ITER))
+        {
+            break;
+        }
+
+        multilat_subst(l, dims, g, step);
+        /* Converged if the full step is small, in metres or in standard deviations of the position (from the normal
+         * matrix, scaled as the covariance below) */
+        converged = 1;
+        norm = 0.0f;
+        for (int j = 0; j < dims; j++)
+        {
+            converged &= (fabsf(step[j]) < MULTILAT_CONVERGED_M);
+            for (int k = 0; k < dims; k++)
+            {
+                norm += step[j] * h[j][k] * step[k];
+            }
+        }
+        scale = (vars != NULL) ? 1.0f : ssr / (n - dims);
+        converged |= (norm < MULTILAT_CONVERGED_SIGMA * MULTILAT_CONVERGED_SIGMA * scale);
+        for (int halving = 0; ; halving++)
+        {
+            memcpy(trial, p, sizeof(trial));
+            for (int j = 0; j < dims; j++)
+            {
+                trial[j] += step[j];
+            }
+            trial_cost = multilat_normal(&f, ranges, vars, trial, NULL, NULL, &trial_ssr);
+            if ((trial_cost <= cost) || (halving == MULTILAT_MAX_HALVING))
+            {
+                break;
+            }
+            for (int j = 0; j < dims; j++)
+            {
+                step[j] *= 0.5f;
+            }
+        }
+        /* Stalled: the cost rises even after MULTILAT_MAX_HALVING halvings. p is kept, with its normal matrix for the
+         * covariance, and is only reported converged if the full step was within the tolerance above. */
+        if (trial_cost > cost)
+        {
+            break;
+        }
+        /* The same cost in the direction of the step: p is the minimum, to the float resolution */
+        converged |= (trial_cost == cost);
+        memcpy(p, trial, sizeof(trial));
+        result->iterations++;
+        cost = multilat_normal(&f, ranges, vars, p, h, g, &ssr);
+    }
+
+    result->pos.x = p[0] + f.origin[0];
+    result->pos.y = p[1] + f.origin[1];
+    result->pos.z = p[2] + f.origin[2];
+    result->rms = sqrtf(ssr / n);
+
+    /* Covariance: the inverse of the normal matrix. Without variances, a range variance is estimated from the
+     * residuals. */
+    scale = (vars != NULL) ? 1.0f : ssr / (n - dims);
+    memset(result->cov, 0, sizeof(result->cov));
+    for (int k = 0; k < dims; k++)
+    {
+        float unit[3] = {0.0f}, col[3];
+
+        unit[k] = 1.0f;
+        multilat_subst(l, dims, unit, col);
+        for (int j = 0; j < dims; j++)
+        {
+            result->cov[j][k] = scale * col[j];
+        }
+    }
+    return converged ? 0 : -1;
+}
+
+int multilat_solve_2d(const multilat_point_t *anchors, const float *ranges, const float *vars, int n, float z,
+                      multilat_result_t *result)
+{
+    return multilat_solve(anchors, ranges, vars, n, 2, z, result);
+}
+
+int multilat_solve_3d(const multilat_point_t *anchors, const float *ranges, const float *vars, int n,
+                      multilat_result_t *result)
+{
+    return multilat_solve(anchors, ranges, vars, n, 3, 0.0f, result);
+}
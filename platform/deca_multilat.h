@@ -0,0 +1,66 @@
+/*! ----------------------------------------------------------------------------
+ * @file	deca_multilat.h
+ * @brief	Position of a tag from its ranges to anchors at known coordinates
+ *
+ * Weighted least squares: a closed-form first guess, from the range equations made linear by subtracting their mean,
+ * refined by Gauss-Newton iterations on the ranges themselves. The solution comes with its covariance, from the ranges'
+ * variances (or, if none are given, from the residuals) and the geometry of the anchors.
+ *
+ * Single precision only, for the nRF52832 FPU: the coordinates are taken relative to the centroid of the anchors, so
+ * rooms of a few hundred metres keep millimetre resolution. Needs sqrtf() from the C library (CONFIG_NEWLIB_LIBC).
+ * The matrices are at most 3x3, solved in place by Cholesky: the CMSIS-DSP matrix functions cost more to call than
+ * the sums themselves.
+ */
+
+#ifndef _DECA_MULTILAT_H_
+#define _DECA_MULTILAT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MULTILAT_MAX_ANCHORS        (16)
+#define MULTILAT_MAX_ITER           (20)        // Gauss-Newton iterations
+#define MULTILAT_CONVERGED_M        (0.0001f)   // iterations stop once the position moves less than this (m),
+#define MULTILAT_CONVERGED_SIGMA    (0.03f)     // or less than this many standard deviations
+
+typedef struct
+{
+    float x;
+    float y;
+    float z;
+} multilat_point_t;
+
+typedef struct
+{
+    multilat_point_t pos;       // position of the tag (m)
+    float cov[3][3];            // its covariance (m^2), x y z, the z row and column are 0 in 2-D
+    float rms;                  // rms of the range residuals (m)
+    int iterations;             // Gauss-Newton iterations run
+} multilat_result_t;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: multilat_solve_2d()
+ *
+ * Solves the x and y of a tag at a known height z, from n ranges (m) to anchors (m), with their variances (m^2) or NULL
+ * for equal weights. Needs at least 3 anchors, not all in line. Returns 0 if the solution converged, -1 otherwise: too
+ * few anchors, degenerate geometry (result not set), no convergence in MULTILAT_MAX_ITER or a stall, no step lowering
+ * the residuals (result set to the last iteration).
+ */
+int multilat_solve_2d(const multilat_point_t *anchors, const float *ranges, const float *vars, int n, float z,
+                      multilat_result_t *result);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: multilat_solve_3d()
+ *
+ * Same as multilat_solve_2d() for x, y and z. Needs at least 4 anchors, not all in a plane: anchors at the same height
+ * can not tell above from below, see multilat_solve_2d().
+ */
+int multilat_solve_3d(const multilat_point_t *anchors, const float *ranges, const float *vars, int n,
+                      multilat_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DECA_MULTILAT_H_ */
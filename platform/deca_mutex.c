@@ -12,6 +12,8 @@
 
 #include "deca_device_api.h"
 #include "port.h"
+
+#include <zephyr.h>
 // ---------------------------------------------------------------------------
 //
 // NB: The purpose of this file is to provide for microprocessor interrupt enable/disable, this is used for 
@@ -31,8 +33,21 @@
 //	   For critical section use this mutex instead
 //	   __save_intstate()
 //     __restore_intstate()
+//
+//     Zephyr port: only the interrupt of the DW_IRQ line is masked, which keeps dwt_isr() out of a critical
+//     section. The threads sharing the radio (ranging, BLE, accelerometer) are kept out of each other's by
+//     a kernel mutex, which is recursive for its owner, so critical sections may nest. It is not taken from
+//     an ISR, which cannot run while a thread holds the DW_IRQ masked. An asynchronous SPI transfer must be
+//     completed by the thread which started it.
 // ---------------------------------------------------------------------------
 
+K_MUTEX_DEFINE(deca_mutex);
+
+static int    mutex_depth;
+static uint32 mutex_start;
+static uint32 mutex_count;
+static uint32 mutex_max_hold;       // in hardware cycles
+
 
 /*! ------------------------------------------------------------------------------------------------------------------
  * Function: decamutexon()
@@ -50,11 +65,21 @@
  */
 decaIrqStatus_t decamutexon(void)           
 {
-	decaIrqStatus_t s = port_GetEXT_IRQStatus();
+	decaIrqStatus_t s;
+
+	if(!k_is_in_isr()) {
+		k_mutex_lock(&deca_mutex, K_FOREVER);
+	}
+
+	s = port_GetEXT_IRQStatus();
 
 	if(s) {
 		port_DisableEXT_IRQ(); //disable the external interrupt line
 	}
+
+	if(mutex_depth++ == 0) {
+		mutex_start = k_cycle_get_32();
+	}
 	return s ;   // return state before disable, value is used to re-enable in decamutexoff call
 }
 
@@ -75,7 +100,49 @@ decaIrqStatus_t decamutexon(void)
  */
 void decamutexoff(decaIrqStatus_t s)        // put a function here that re-enables the interrupt at the end of the critical section
 {
+	if(--mutex_depth == 0) {
+		uint32 hold = k_cycle_get_32() - mutex_start;
+
+		mutex_count++;
+		if(hold > mutex_max_hold) {
+			mutex_max_hold = hold;
+		}
+	}
+
 	if(s) { //need to check the port state as we can't use level sensitive interrupt on the STM ARM
 		port_EnableEXT_IRQ();
 	}
+
+	if(!k_is_in_isr()) {
+		k_mutex_unlock(&deca_mutex);
+	}
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: decamutexstats()
+ *
+ * Description: This function reads the longest hold time and the number of the outermost critical sections
+ *
+ * input parameters:
+ * @param reset - if non-zero, the statistics are cleared after being read
+ *
+ * output parameters
+ * @param maxHold - the maximum hold time, in microseconds
+ * @param count   - the number of critical sections
+ *
+ * no return value
+ */
+void decamutexstats(uint32 *maxHold, uint32 *count, int reset)
+{
+	k_mutex_lock(&deca_mutex, K_FOREVER);
+
+	*maxHold = k_cyc_to_us_ceil32(mutex_max_hold);
+	*count = mutex_count;
+
+	if(reset) {
+		mutex_max_hold = 0;
+		mutex_count = 0;
+	}
+
+	k_mutex_unlock(&deca_mutex);
 }
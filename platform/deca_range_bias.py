@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+"""Generates deca_range_bias.h, the range bias corrections of deca_range_tables.c
+direct-indexed by the range in 25 cm units.
+
+The threshold tables in deca_range_tables.c stay the source: each holds the
+range, in 25 cm units, up to which the correction is its index plus the table's
+CM_OFFSET (cm). dwt_getrangebias() walked them on every call; the generated
+tables hold the correction for each of the 256 ranges, one load per call.
+Run after editing the threshold tables:
+
+    python3 deca_range_bias.py            writes deca_range_bias.h
+    python3 deca_range_bias.py --check    fails if deca_range_bias.h is stale, then
+                                          builds deca_range_tables.c on the host and
+                                          compares dwt_getrangebias() and
+                                          dwt_getrangebias_mm() with the walk of the
+                                          threshold tables, for every channel, PRF
+                                          and range
+"""
+
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SOURCE = os.path.join(HERE, "deca_range_tables.c")
+HEADER = os.path.join(HERE, "deca_range_bias.h")
+INDEXES = 256
+
+# Threshold table -> generated table and its CM_OFFSET
+TABLES = [
+    ("range25cm16PRFnb", "rangebias16PRFnb", "CM_OFFSET_16M_NB"),
+    ("range25cm16PRFwb", "rangebias16PRFwb", "CM_OFFSET_16M_WB"),
+    ("range25cm64PRFnb", "rangebias64PRFnb", "CM_OFFSET_64M_NB"),
+    ("range25cm64PRFwb", "rangebias64PRFwb", "CM_OFFSET_64M_WB"),
+]
+
+# Channels using the wide band tables, the others use the narrow band ones
+WIDE_BAND = (4, 7)
+
+HOST_CHECK = r"""
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "deca_device_api.h"
+#include "deca_param_types.h"
+#include "deca_range_tables.h"
+
+double dwt_getrangebias_walk(uint8 chan, float range, uint8 prf);
+
+int main(void)
+{
+    static const uint8 prfs[] = {DWT_PRF_16M, DWT_PRF_64M};
+    long checked = 0, failed = 0;
+
+    for (int p = 0; p < 2; p++) {
+        for (uint8 chan = 0; chan < NUM_CH_SUPPORTED; chan++) {
+            /* Around every 25 cm step, the ends of the tables, and beyond them */
+            for (int step = -8; step <= 300; step++) {
+                static const float within[] = {-0.001f, 0.0f, 0.001f, 0.1f, 0.2499f};
+
+                for (int k = 0; k < (int)(sizeof(within) / sizeof(within[0])); k++) {
+                    float range = step * 0.25f + within[k];
+                    double ref = dwt_getrangebias_walk(chan, range, prfs[p]);
+                    double got = dwt_getrangebias(chan, range, prfs[p]);
+
+                    checked++;
+                    if (memcmp(&ref, &got, sizeof(ref)) != 0) {
+                        if (failed++ < 10) {
+                            printf("dwt_getrangebias(%u, %f, %u) = %f, walk %f\n", chan, range, prfs[p], got, ref);
+                        }
+                    }
+                }
+            }
+            /* Every millimetre from -2 m to 80 m */
+            for (long mm = -2000; mm <= 80000; mm++) {
+                int ref = (int)lround(dwt_getrangebias_walk(chan, (float)mm / 1000.0f, prfs[p]) * 1000.0);
+                int got = dwt_getrangebias_mm(chan, (int32)mm, prfs[p]);
+
+                checked++;
+                if (got != ref) {
+                    if (failed++ < 10) {
+                        printf("dwt_getrangebias_mm(%u, %ld, %u) = %d, walk %d\n", chan, mm, prfs[p], got, ref);
+                    }
+                }
+            }
+        }
+    }
+    printf("%ld checked, %ld failed\n", checked, failed);
+    return failed != 0;
+}
+"""
+
+
+def parse(text):
+    text = re.sub(r"//[^\n]*", "", text)
+    offsets = {m.group(1): int(m.group(2))
+               for m in re.finditer(r"#define\s+(CM_OFFSET_\w+)\s+\((-?\d+)\)", text)}
+    idx = {}
+    for name in ("chan_idxnb", "chan_idxwb"):
+        m = re.search(name + r"\[\w+\]\s*=\s*\{([^}]*)\}", text)
+        idx[name] = [int(v) for v in m.group(1).split(",")]
+    tables = {}
+    for name, _, _ in TABLES:
+        m = re.search(r"const uint8 " + name + r"\[\d+\]\[\w+\]\s*=\s*\{(.*?)\};", text, re.S)
+        rows = [[int(v) for v in row.split(",") if v.strip()]
+                for row in re.findall(r"\{([^{}]*)\}", m.group(1))]
+        for row in rows:
+            if row[-1] != 255 or row != sorted(row):
+                sys.exit("%s: each row must rise and end in 255" % name)
+        tables[name] = rows
+    return offsets, idx, tables
+
+
+def invert(row, offset):
+    # The walk stops at the first threshold not below the range
+    return [next(i for i, t in enumerate(row) if r <= t) + offset for r in range(INDEXES)]
+
+
+def generate():
+    with open(SOURCE) as f:
+        offsets, idx, tables = parse(f.read())
+    out = [
+        "/*! ----------------------------------------------------------------------------",
+        " *  @file    deca_range_bias.h",
+        " *  @brief   DW1000 range bias corrections (cm), direct-indexed by the range in 25 cm units",
+        " *",
+        " *  Generated by deca_range_bias.py from the threshold tables in deca_range_tables.c, do not edit.",
+        " */",
+        "",
+        "#define RANGE_BIAS_INDEXES  (%d)" % INDEXES,
+        "",
+    ]
+    for src, dst, offset in TABLES:
+        rows = tables[src]
+        out.append("static const int8 %s[%d][RANGE_BIAS_INDEXES] =" % (dst, len(rows)))
+        out.append("{")
+        for row in rows:
+            values = invert(row, offsets[offset])
+            out.append("    {")
+            for i in range(0, INDEXES, 16):
+                out.append("        " + ", ".join("%3d" % v for v in values[i:i + 16]) + ",")
+            out.append("    },")
+        out.append("};")
+        out.append("")
+    for prf in ("16", "64"):
+        rows = []
+        for chan in range(len(idx["chan_idxnb"])):
+            if chan in WIDE_BAND:
+                rows.append("rangebias%sPRFwb[%d]" % (prf, idx["chan_idxwb"][chan]))
+            else:
+                rows.append("rangebias%sPRFnb[%d]" % (prf, idx["chan_idxnb"][chan]))
+        out.append("/* Table of each channel at %s MHz PRF */" % prf)
+        out.append("static const int8 *const rangebias%sPRF[NUM_CH_SUPPORTED] =" % prf)
+        out.append("{")
+        out.append("    " + ", ".join(rows[:4]) + ",")
+        out.append("    " + ", ".join(rows[4:]) + ",")
+        out.append("};")
+        out.append("")
+    return "\n".join(out)
+
+
+def check(text):
+    with open(HEADER) as f:
+        if f.read() != text:
+            sys.exit("deca_range_bias.h is stale, run deca_range_bias.py")
+    root = os.path.dirname(HERE)
+    with tempfile.TemporaryDirectory() as tmp:
+        main = os.path.join(tmp, "check.c")
+        exe = os.path.join(tmp, "check")
+        with open(main, "w") as f:
+            f.write(HOST_CHECK)
+        subprocess.check_call(["cc", "-O1", "-DDECA_RANGE_BIAS_THRESHOLDS",
+                               "-I" + os.path.join(root, "decadriver"), "-I" + HERE,
+                               main, SOURCE, "-o", exe, "-lm"])
+        sys.exit(subprocess.call([exe]))
+
+
+def main():
+    text = generate()
+    if "--check" in sys.argv[1:]:
+        check(text)
+    with open(HEADER, "w") as f:
+        f.write(text)
+
+
+if __name__ == "__main__":
+    main()
@@ -14,6 +14,11 @@
 
 #include "deca_device_api.h"
 #include "deca_param_types.h"
+#include "deca_range_tables.h"
+
+#ifdef DECA_RANGE_BIAS_THRESHOLDS
+// The threshold tables below are the source of the direct-indexed tables of deca_range_bias.h, run deca_range_bias.py
+// after editing them. They are only built for its host check, with their walk in dwt_getrangebias_walk().
 
 #define NUM_16M_OFFSET  (37)
 #define NUM_16M_OFFSETWB  (68)
@@ -620,9 +625,10 @@ const uint8 range25cm64PRFwb[2][NUM_64M_OFFSETWB] =
 
 
 /*! ------------------------------------------------------------------------------------------------------------------
- * Function: dwt_getrangebias()
+ * Function: dwt_getrangebias_walk()
  *
- * Description: This function is used to return the range bias correction need for TWR with DW1000 units.
+ * Description: This function is used to return the range bias correction need for TWR with DW1000 units, walking the
+ * threshold tables. Reference for the host check of dwt_getrangebias().
  *
  * input parameters:	
  * @param chan  - specifies the operating channel (e.g. 1, 2, 3, 4, 5, 6 or 7) 
@@ -633,7 +639,7 @@ const uint8 range25cm64PRFwb[2][NUM_64M_OFFSETWB] =
  *
  * returns correction needed in meters
  */
-double dwt_getrangebias(uint8 chan, float range, uint8 prf)
+double dwt_getrangebias_walk(uint8 chan, float range, uint8 prf)
 {
     //first get the lookup index that corresponds to given range for a particular channel at 16M PRF
     int i = 0 ;
@@ -696,3 +702,69 @@ double dwt_getrangebias(uint8 chan, float range, uint8 prf)
 
     return (mOffset) ;
 }
+#endif /* DECA_RANGE_BIAS_THRESHOLDS */
+
+#include "deca_range_bias.h"
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: range_bias_table()
+ *
+ * Returns the direct-indexed table of corrections (cm) of a channel and PRF. Channels out of range take that of 0.
+ */
+static const int8 *range_bias_table(uint8 chan, uint8 prf)
+{
+    if (chan >= NUM_CH_SUPPORTED)
+    {
+        chan = 0;
+    }
+    return (prf == DWT_PRF_16M) ? rangebias16PRF[chan] : rangebias64PRF[chan];
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: dwt_getrangebias()
+ *
+ * Description: This function is used to return the range bias correction need for TWR with DW1000 units.
+ *
+ * input parameters:
+ * @param chan  - specifies the operating channel (e.g. 1, 2, 3, 4, 5, 6 or 7)
+ * @param range - the calculated distance before correction
+ * @param prf	- this is the PRF e.g. DWT_PRF_16M or DWT_PRF_64M
+ *
+ * output parameters
+ *
+ * returns correction needed in meters
+ */
+double dwt_getrangebias(uint8 chan, float range, uint8 prf)
+{
+    double range25cm = range * 4.00 ;               // convert range to number of 25cm values, truncated below
+
+    // NB: note we may get some small negitive values e.g. up to -50 cm, they take the correction at 0 cm.
+
+    int rangeint25cm = (range25cm > 0) ? ((range25cm < RANGE_BIAS_INDEXES - 1) ? (int) range25cm : RANGE_BIAS_INDEXES - 1) : 0 ;
+
+    return range_bias_table(chan, prf)[rangeint25cm] * 0.01 ;             // convert centimetres to metres
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: dwt_getrangebias_mm()
+ *
+ * Description: This function is used to return the range bias correction need for TWR with DW1000 units, in integers.
+ *
+ * input parameters:
+ * @param chan     - specifies the operating channel (e.g. 1, 2, 3, 4, 5, 6 or 7)
+ * @param range_mm - the calculated distance before correction, in millimetres
+ * @param prf      - this is the PRF e.g. DWT_PRF_16M or DWT_PRF_64M
+ *
+ * output parameters
+ *
+ * returns correction needed in millimetres
+ */
+int16 dwt_getrangebias_mm(uint8 chan, int32 range_mm, uint8 prf)
+{
+    int32 rangeint25cm = range_mm / 250 ;           // convert range to integer number of 25cm values
+
+    if (rangeint25cm < 0) rangeint25cm = 0 ;
+    if (rangeint25cm > RANGE_BIAS_INDEXES - 1) rangeint25cm = RANGE_BIAS_INDEXES - 1 ;
+
+    return (int16) (range_bias_table(chan, prf)[rangeint25cm] * 10) ;
+}
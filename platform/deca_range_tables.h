@@ -0,0 +1,38 @@
+/*! ----------------------------------------------------------------------------
+ * @file	deca_range_tables.h
+ * @brief	DW1000 range bias correction, see deca_range_tables.c
+ *
+ * The corrections depend on the channel and PRF, and are in whole centimetres for each 25 cm of range. They are looked
+ * up in tables direct-indexed by the range, generated from the threshold tables of deca_range_tables.c by
+ * deca_range_bias.py. Ranges beyond 63.75 m take the correction of 63.75 m, negative ones that of 0 m.
+ */
+
+#ifndef _DECA_RANGE_TABLES_H_
+#define _DECA_RANGE_TABLES_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "deca_types.h"
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: dwt_getrangebias()
+ *
+ * Returns the range bias correction (m) for TWR at range (m) on channel chan (1 to 7) with PRF prf (DWT_PRF_16M or
+ * DWT_PRF_64M).
+ */
+double dwt_getrangebias(uint8 chan, float range, uint8 prf);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: dwt_getrangebias_mm()
+ *
+ * As dwt_getrangebias(), in integers: returns the correction (mm) at range_mm (mm).
+ */
+int16 dwt_getrangebias_mm(uint8 chan, int32 range_mm, uint8 prf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DECA_RANGE_TABLES_H_ */
@@ -0,0 +1,118 @@
+/*! ----------------------------------------------------------------------------
+ * @file	deca_ranging.c
+ * @brief	Time of flight and distance of two-way ranging exchanges, in integer fixed point, see deca_ranging.h
+ *
+ * @attention
+ *
+ * All rights reserved.
+ *
+ */
+
+#include "deca_device_api.h"
+#include "deca_ranging.h"
+
+#define RANGING_TOF_ONE             ((int64)1 << RANGING_TOF_FRAC_BITS)
+/* Distance in air (mm) and time (ps) of 1 dtu, with 16 fractional bits: 299702547 m/s / (499.2 MHz * 128) and
+ * 1 / (499.2 MHz * 128) */
+#define RANGING_DTU_TO_MM           (307387)
+#define RANGING_DTU_TO_PS           (1025641)
+/* The carrier integrator counts 998.4 MHz / 2 / 1024 / 2^17 Hz (8192 instead of 1024 at 110 kbps) of offset of the
+ * carrier, so a clock offset of -1 / (2^28 * fc / 998.4 MHz). Twice fc / 998.4 MHz, for each channel. */
+static const uint8 ranging_carrier_div[8] = {0, 7, 8, 9, 8, 13, 0, 13};
+
+/* 64 x 64 bit product, in 32 bit halves for the targets without a 128 bit type */
+static void ranging_mul(uint64 a, uint64 b, uint64 *hi, uint64 *lo)
+{
+    uint64 p00 = (a & 0xFFFFFFFFUL) * (b & 0xFFFFFFFFUL);
+    uint64 p01 = (a & 0xFFFFFFFFUL) * (b >> 32);
+    uint64 p10 = (a >> 32) * (b & 0xFFFFFFFFUL);
+    uint64 mid = (p00 >> 32) + (p01 & 0xFFFFFFFFUL) + (p10 & 0xFFFFFFFFUL);
+
+    *lo = (mid << 32) | (p00 & 0xFFFFFFFFUL);
+    *hi = (a >> 32) * (b >> 32) + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+}
+
+/* num / den with RANGING_TOF_FRAC_BITS fractional bits, rounded towards 0. The remainder is below den, so it keeps
+ * clear of overflow for den up to 2^46. */
+static int64 ranging_div(int64 num, int64 den)
+{
+    int64 q = num / den;
+    int64 r = num % den;
+
+    return q * RANGING_TOF_ONE + (r * RANGING_TOF_ONE) / den;
+}
+
+/* x / 2^32, rounded to nearest */
+static int32 ranging_round32(int64 x)
+{
+    return (int32)((x + ((int64)1 << 31)) >> 32);
+}
+
+int64 ranging_dstwr_tof(uint64 ra, uint64 rb, uint64 da, uint64 db)
+{
+    uint64 sum = ra + rb + da + db;
+    uint64 hi, lo, hi2, lo2;
+
+    if (sum == 0)
+    {
+        return 0;
+    }
+    /* The exchanges are short: the products hold in 64 bits, and so does their difference, about tof * sum */
+    if (((ra | rb | da | db) >> 32) == 0)
+    {
+        return ranging_div((int64)(ra * rb - da * db), (int64)sum);
+    }
+
+    ranging_mul(ra, rb, &hi, &lo);
+    ranging_mul(da, db, &hi2, &lo2);
+    hi = hi - hi2 - (lo < lo2);
+    lo = lo - lo2;
+    /* Drop the same low bits of the difference and of the sum until the difference holds in 64 bits: the sum is over
+     * 32 bits, far more than the precision needed */
+    while ((int64)hi != ((int64)lo >> 63))
+    {
+        lo = (lo >> 1) | (hi << 63);
+        hi = (uint64)((int64)hi >> 1);
+        sum >>= 1;
+    }
+    return ranging_div((int64)lo, (int64)sum);
+}
+
+int64 ranging_sstwr_tof(uint64 ra, uint64 db)
+{
+    return (int64)(ra - db) * (RANGING_TOF_ONE / 2);
+}
+
+int32 ranging_clock_offset(int32 carrier, uint8 chan, uint8 rate)
+{
+    int64 num = -(int64)carrier * ((rate == DWT_BR_110K) ? ((int64)1 << (RANGING_OFFSET_FRAC_BITS - 30))
+                                                         : ((int64)1 << (RANGING_OFFSET_FRAC_BITS - 27)));
+    int64 den = ranging_carrier_div[chan & 7];
+
+    if (den == 0)
+    {
+        return 0;
+    }
+    return (int32)((num + ((num < 0) ? -den / 2 : den / 2)) / den);
+}
+
+int64 ranging_sstwr_offset_tof(uint64 ra, uint64 db, int32 offset)
+{
+    /* db * offset in two parts, each in 64 bits for intervals up to 40 bits */
+    int64 hi = (int64)(db >> 20) * offset;
+    int64 lo = (int64)(db & 0xFFFFF) * offset;
+    int64 corr = hi / ((int64)1 << (RANGING_OFFSET_FRAC_BITS - RANGING_TOF_FRAC_BITS - 20)) +
+                 lo / ((int64)1 << (RANGING_OFFSET_FRAC_BITS - RANGING_TOF_FRAC_BITS));
+
+    return ((int64)(ra - db) * RANGING_TOF_ONE + corr) / 2;
+}
+
+int32 ranging_tof_to_mm(int64 tof)
+{
+    return ranging_round32(tof * RANGING_DTU_TO_MM);
+}
+
+int32 ranging_tof_to_ps(int64 tof)
+{
+    return ranging_round32(tof * RANGING_DTU_TO_PS);
+}
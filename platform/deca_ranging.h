@@ -0,0 +1,84 @@
+/*! ----------------------------------------------------------------------------
+ * @file	deca_ranging.h
+ * @brief	Time of flight and distance of two-way ranging exchanges, in integer fixed point
+ *
+ * The nRF52832 FPU is single precision only, and single precision can not hold the products of DS-TWR, so the ranging
+ * is done in 64 bit integers (128 bit for the products of intervals longer than 32 bits of dtu, i.e. 67 ms). Times of
+ * flight are in dtu (1 / (499.2 MHz * 128), about 15.65 ps) with RANGING_TOF_FRAC_BITS fractional bits, distances in
+ * millimetres.
+ *
+ * Intervals are the differences of two DW1000 timestamps of the same device, see ts_interval() in deca_timestamp.h.
+ * With the usual names, for an initiator A and a responder B:
+ *  - Ra: A's Poll TX to A's Response RX
+ *  - Db: B's Poll RX to B's Response TX
+ *  - Rb: B's Response TX to B's Final RX
+ *  - Da: A's Response RX to A's Final TX
+ */
+
+#ifndef _DECA_RANGING_H_
+#define _DECA_RANGING_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "deca_types.h"
+
+#define RANGING_TOF_FRAC_BITS       (16)        // fractional bits of a time of flight in dtu
+#define RANGING_OFFSET_FRAC_BITS    (40)        // fractional bits of a clock offset, about 1 ppt
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: ranging_dstwr_tof()
+ *
+ * Returns the time of flight (dtu, RANGING_TOF_FRAC_BITS fractional bits) of a double-sided exchange with asymmetric
+ * delays, (Ra * Rb - Da * Db) / (Ra + Rb + Da + Db), in which the clock offsets of both devices cancel out. The
+ * intervals are up to 40 bits, the time of flight under 2^24 dtu (78 km). Returns 0 if they are all 0.
+ */
+int64 ranging_dstwr_tof(uint64 ra, uint64 rb, uint64 da, uint64 db);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: ranging_sstwr_tof()
+ *
+ * Returns the time of flight (dtu, RANGING_TOF_FRAC_BITS fractional bits) of a single-sided exchange, (Ra - Db) / 2,
+ * without correcting the clock offset of the devices. The intervals are up to 40 bits.
+ */
+int64 ranging_sstwr_tof(uint64 ra, uint64 db);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: ranging_clock_offset()
+ *
+ * Returns the clock offset of a remote device relative to this one, (f_remote - f_local) / f_local with
+ * RANGING_OFFSET_FRAC_BITS fractional bits, from the carrier integrator (dwt_readcarrierintegrator()) of a frame
+ * received from it on channel chan at data rate rate (DWT_BR_110K, DWT_BR_850K or DWT_BR_6M8). Returns 0 for the
+ * channels the DW1000 does not have.
+ */
+int32 ranging_clock_offset(int32 carrier, uint8 chan, uint8 rate);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: ranging_sstwr_offset_tof()
+ *
+ * As ranging_sstwr_tof(), with Db, timed by the responder, brought to the clock of the initiator:
+ * (Ra - Db * (1 - offset)) / 2, offset being the clock offset of the responder given by ranging_clock_offset().
+ */
+int64 ranging_sstwr_offset_tof(uint64 ra, uint64 db, int32 offset);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: ranging_tof_to_mm()
+ *
+ * Returns the distance (mm, rounded) covered in air in a time of flight given by ranging_dstwr_tof() or
+ * ranging_sstwr_tof(). Negative times of flight, from noise at short range, give negative distances.
+ */
+int32 ranging_tof_to_mm(int64 tof);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: ranging_tof_to_ps()
+ *
+ * Returns a time of flight given by ranging_dstwr_tof() or ranging_sstwr_tof() in picoseconds, rounded.
+ */
+int32 ranging_tof_to_ps(int64 tof);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DECA_RANGING_H_ */
@@ -15,6 +15,7 @@
 
 #include "deca_spi.h"
 #include "deca_device_api.h"
+#include "deca_regs.h"
 #include "port.h"
 
 #include <errno.h>
@@ -34,16 +35,40 @@ struct spi_config   spi_cfgs [4] = {0};
 
 #define SPI_CFGS_COUNT ((sizeof(spi_cfgs)/sizeof(spi_cfgs[0])))
 
-uint8_t tx_buf [255];
-uint8_t rx_buf [255];
+#define SPI_SLOW_FREQUENCY  (2000000)
 
-struct spi_buf bufs [2];
+/* Rate of set_spi_speed_fast(), raised by set_spi_speed_negotiate() */
+static uint32 spi_fast_frequency = 8000000;
 
-struct spi_buf_set tx; 
-struct spi_buf_set rx;
+/*
+ * Transfers are described as scatter-gather lists so that the header and
+ * the caller's body buffer are handed to the SPIM EasyDMA directly: no
+ * intermediate copy and no limit on the transfer length.
+ *  - write: TX = {header, body}, no RX.
+ *  - read:  TX = {header},       RX = {skip header, caller's buffer}.
+ *    While the body is clocked in, MOSI carries the SPIM over-read
+ *    character, which the DW1000 ignores.
+ */
+static struct spi_buf tx_bufs [2];
+static struct spi_buf rx_bufs [2];
+
+static struct spi_buf_set tx = { .buffers = tx_bufs };
+static struct spi_buf_set rx = { .buffers = rx_bufs };
 
 static struct spi_cs_control cs_ctrl;
 
+#ifdef CONFIG_SPI_ASYNC
+static struct k_poll_signal async_signal;
+#endif
+
+#ifdef DECA_SPI_TRACE
+#define TRACE_START(v)                  uint32 v = deca_spi_trace_time()
+#define TRACE_RECORD(hdr, len, start)   deca_spi_trace_record(hdr, len, start, deca_spi_trace_tag())
+#else
+#define TRACE_START(v)
+#define TRACE_RECORD(hdr, len, start)
+#endif
+
 /*
  *****************************************************************************
  *
@@ -81,16 +106,11 @@ int openspi(void)
         return -1;
     }
     spi_cfg->operation = SPI_WORD_SET(8);
-    spi_cfg->frequency = 2000000;
-
-    memset(&tx_buf[0], 0, 255);
-    memset(&rx_buf[0], 0, 255);
-    bufs[0].buf = &tx_buf[0];
-    bufs[1].buf = &rx_buf[0];
-    tx.buffers = &bufs[0];
-    rx.buffers = &bufs[1];
-    tx.count = 1;
-    rx.count = 1;
+    spi_cfg->frequency = SPI_SLOW_FREQUENCY;
+
+#ifdef CONFIG_SPI_ASYNC
+    k_poll_signal_init(&async_signal);
+#endif
 
     return 0;
 }
@@ -99,20 +119,19 @@ void set_spi_speed_slow(void)
 {
     spi_cfg = &spi_cfgs[0];
     spi_cfg->operation = SPI_WORD_SET(8);
-    spi_cfg->frequency = 2000000;
-
-    memset(&tx_buf[0], 0, 255);
-    memset(&rx_buf[0], 0, 255);
+    spi_cfg->frequency = SPI_SLOW_FREQUENCY;
 }
 
 void set_spi_speed_fast(void)
 {
     spi_cfg = &spi_cfgs[1];
     spi_cfg->operation = SPI_WORD_SET(8);
-    spi_cfg->frequency = 8000000;
+    spi_cfg->frequency = spi_fast_frequency;
+}
 
-    memset(&tx_buf[0], 0, 255);
-    memset(&rx_buf[0], 0, 255);
+uint32 get_spi_speed(void)
+{
+    return spi_cfg->frequency;
 }
 
 /*
@@ -148,13 +167,15 @@ int writetospi(uint16           headerLength,
 
     stat = decamutexon();
 
-    memcpy(&tx_buf[0], headerBuffer, headerLength);
-    memcpy(&tx_buf[headerLength], bodyBuffer, bodyLength);
+    tx_bufs[0].buf = (uint8 *)headerBuffer;
+    tx_bufs[0].len = headerLength;
+    tx_bufs[1].buf = (uint8 *)bodyBuffer;
+    tx_bufs[1].len = bodyLength;
+    tx.count = (bodyLength > 0) ? 2 : 1;
 
-    bufs[0].len = headerLength + bodyLength;
-    bufs[1].len = headerLength + bodyLength;
-
-    spi_transceive(spi, spi_cfg, &tx, &rx);
+    TRACE_START(start);
+    spi_write(spi, spi_cfg, &tx);
+    TRACE_RECORD(headerBuffer, bodyLength, start);
 
     decamutexoff(stat);
 
@@ -166,6 +187,7 @@ int writetospi(uint16           headerLength,
  *
  * Low level abstract function to read from the SPI
  * Takes two separate byte buffers for write header and read data
+ * The read data is received directly into readBuffer.
  * returns the offset into read buffer where first byte of read data 
  * may be found, or returns 0
  */
@@ -178,15 +200,20 @@ int readfromspi(uint16        headerLength,
 
     stat = decamutexon();
 
-    memset(&tx_buf[0], 0, headerLength + readLength);
-    memcpy(&tx_buf[0], headerBuffer, headerLength);
+    tx_bufs[0].buf = (uint8 *)headerBuffer;
+    tx_bufs[0].len = headerLength;
+    tx.count = 1;
 
-    bufs[0].len = headerLength + readLength;
-    bufs[1].len = headerLength + readLength;
+    /* A NULL buffer makes the SPI driver discard the header echo. */
+    rx_bufs[0].buf = NULL;
+    rx_bufs[0].len = headerLength;
+    rx_bufs[1].buf = readBuffer;
+    rx_bufs[1].len = readLength;
+    rx.count = 2;
 
+    TRACE_START(start);
     spi_transceive(spi, spi_cfg, &tx, &rx);
-
-    memcpy(readBuffer, rx_buf + headerLength, readLength);
+    TRACE_RECORD(headerBuffer, readLength, start);
 
     decamutexoff(stat);
 
@@ -197,3 +224,386 @@ int readfromspi(uint16        headerLength,
 
     return 0;
 }
+
+/*
+ *****************************************************************************
+ *
+ *                          DW1000 SPI clock section
+ *
+ *****************************************************************************
+ */
+
+/*
+ * Candidate rates, in increasing order. The DW1000 accepts up to 20 MHz
+ * once its PLL is locked. The SPIM driver rounds a rate down to one the
+ * instance supports (8 MHz at most on SPI1 of the nRF52832), so a step
+ * which does not make the bus faster is not taken.
+ */
+static const uint32 spi_rates [] = { 2000000, 4000000, 8000000, 16000000, 20000000 };
+
+#define SPI_CHECK_LOOPS     (4)
+#define SPI_MEASURE_LOOPS   (8)
+#define SPI_MEASURE_LEN     (256)
+
+static const uint8 spi_patterns [][8] = {
+    { 0x55, 0xAA, 0x55, 0xAA, 0x55, 0xAA, 0x55, 0xAA },
+    { 0xFF, 0x00, 0xFF, 0x00, 0x0F, 0xF0, 0x0F, 0xF0 },
+    { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80 },
+    { 0xFE, 0xFD, 0xFB, 0xF7, 0xEF, 0xDF, 0xBF, 0x7F },
+};
+
+static int spi_check_devid(void)
+{
+    const uint8 header = DEV_ID_ID;
+    uint8       buffer [4];
+
+    for (int i = 0; i < SPI_CHECK_LOOPS; i++) {
+        readfromspi(1, &header, sizeof(buffer), buffer);
+        if ((buffer[0] | (buffer[1] << 8) | (buffer[2] << 16) | ((uint32)buffer[3] << 24)) != DWT_DEVICE_ID) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int spi_check_patterns(void)
+{
+    const uint8 wr_header = 0x80 | EUI_64_ID;
+    const uint8 rd_header = EUI_64_ID;
+    uint8       buffer [8];
+
+    for (int i = 0; i < sizeof(spi_patterns)/sizeof(spi_patterns[0]); i++) {
+        writetospi(1, &wr_header, sizeof(buffer), spi_patterns[i]);
+        readfromspi(1, &rd_header, sizeof(buffer), buffer);
+        if (memcmp(buffer, spi_patterns[i], sizeof(buffer)) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Read throughput of the selected rate, header and CS overhead included */
+static uint32 spi_measure(void)
+{
+    static uint8 buffer [SPI_MEASURE_LEN];
+    const uint8  header = RX_BUFFER_ID;
+    uint32       start;
+    uint32       cycles;
+
+    start = k_cycle_get_32();
+    for (int i = 0; i < SPI_MEASURE_LOOPS; i++) {
+        readfromspi(1, &header, sizeof(buffer), buffer);
+    }
+    cycles = k_cycle_get_32() - start;
+
+    if (cycles == 0) {
+        return 0;
+    }
+    return (uint32)(((uint64)SPI_MEASURE_LOOPS * (1 + sizeof(buffer)) *
+                     sys_clock_hw_cycles_per_sec()) / cycles);
+}
+
+/*
+ * Function: set_spi_speed_negotiate()
+ *
+ * Finds the fastest reliable SPI rate, see deca_spi.h.
+ * returns the chosen rate in Hz, or 0 if the device did not answer
+ */
+uint32 set_spi_speed_negotiate(uint32 * bytes_per_sec)
+{
+    const uint8 wr_header = 0x80 | EUI_64_ID;
+    const uint8 rd_header = EUI_64_ID;
+    uint8       eui [8];
+    uint32      best = 0;
+    uint32      best_bps = 0;
+
+    set_spi_speed_slow();
+    if (!spi_check_devid()) {
+        printk("%s: no DW1000 at %u Hz\n", __func__, SPI_SLOW_FREQUENCY);
+        return 0;
+    }
+    readfromspi(1, &rd_header, sizeof(eui), eui);
+
+    for (int i = 0; i < sizeof(spi_rates)/sizeof(spi_rates[0]); i++) {
+        uint32 bps;
+
+        spi_fast_frequency = spi_rates[i];
+        set_spi_speed_fast();
+
+        if (!spi_check_devid() || !spi_check_patterns()) {
+            LOG_INF("%u Hz: failed", spi_rates[i]);
+            break;
+        }
+
+        bps = spi_measure();
+        LOG_INF("%u Hz: %u bytes/s", spi_rates[i], bps);
+
+        /* Less than 5% better: the driver clamped the rate */
+        if (bps <= best_bps + best_bps / 20) {
+            break;
+        }
+        best = spi_rates[i];
+        best_bps = bps;
+    }
+
+    spi_fast_frequency = (best != 0) ? best : SPI_SLOW_FREQUENCY;
+    set_spi_speed_fast();
+    writetospi(1, &wr_header, sizeof(eui), eui);
+
+    printk("%s: SPI at %u Hz, %u bytes/s\n", __func__, spi_fast_frequency, best_bps);
+
+    if (bytes_per_sec) {
+        *bytes_per_sec = best_bps;
+    }
+    return spi_fast_frequency;
+}
+
+/*
+ *****************************************************************************
+ *
+ *                          DW1000 batched SPI section
+ *
+ *****************************************************************************
+ */
+
+/*
+ * Function: transferspi()
+ *
+ * Low level abstract function to issue a list of transactions back to back.
+ * The DW1000 latches the header at chip select assertion, so every
+ * transaction still gets its own CS cycle, but the mutex is taken once and
+ * the bus is kept locked (SPI_LOCK_ON) for the whole list, which spares the
+ * per-transaction lock and configuration overhead of the SPI driver.
+ * returns 0 for success, or -1 for error
+ */
+int transferspi(const deca_spi_xfer_t * xfers,
+                uint16                  count)
+{
+    decaIrqStatus_t  stat;
+    int              ret = 0;
+
+    stat = decamutexon();
+
+    spi_cfg->operation |= SPI_LOCK_ON;
+
+    for (int i = 0; (i < count) && (ret == 0); i++) {
+        const deca_spi_xfer_t * xfer = &xfers[i];
+        TRACE_START(start);
+
+        tx_bufs[0].buf = (uint8 *)xfer->headerBuffer;
+        tx_bufs[0].len = xfer->headerLength;
+
+        if (xfer->read) {
+            tx.count = 1;
+
+            rx_bufs[0].buf = NULL;
+            rx_bufs[0].len = xfer->headerLength;
+            rx_bufs[1].buf = xfer->bodyBuffer;
+            rx_bufs[1].len = xfer->bodyLength;
+            rx.count = 2;
+
+            ret = spi_transceive(spi, spi_cfg, &tx, &rx);
+        }
+        else {
+            tx_bufs[1].buf = xfer->bodyBuffer;
+            tx_bufs[1].len = xfer->bodyLength;
+            tx.count = (xfer->bodyLength > 0) ? 2 : 1;
+
+            ret = spi_write(spi, spi_cfg, &tx);
+        }
+
+        TRACE_RECORD(xfer->headerBuffer, xfer->bodyLength, start);
+    }
+
+    spi_release(spi, spi_cfg);
+    spi_cfg->operation &= ~SPI_LOCK_ON;
+
+    decamutexoff(stat);
+
+    return (ret == 0) ? 0 : -1;
+}
+
+/*
+ *****************************************************************************
+ *
+ *                        DW1000 asynchronous SPI section
+ *
+ *****************************************************************************
+ */
+
+/*
+ * Only one asynchronous transfer can be in flight. It uses its own
+ * descriptors (the SPI driver walks them during the transfer) and its own
+ * copy of the header, so the caller's header may live on the stack.
+ */
+static uint8 async_header [DECA_MAX_SPI_HEADER_LENGTH];
+
+static struct spi_buf async_tx_bufs [2];
+static struct spi_buf async_rx_bufs [2];
+
+static struct spi_buf_set async_tx = { .buffers = async_tx_bufs };
+static struct spi_buf_set async_rx = { .buffers = async_rx_bufs };
+
+static bool            async_pending;
+static int             async_result;
+static decaIrqStatus_t async_stat;
+
+#ifdef DECA_SPI_TRACE
+static uint32          async_length;
+static uint32          async_start;
+static const char *    async_tag;
+
+/* The transfer is recorded on completion, with the tag of the thread which started it */
+#define TRACE_ASYNC_START(len)  do { async_length = (len); async_start = deca_spi_trace_time(); async_tag = deca_spi_trace_tag(); } while (0)
+#define TRACE_ASYNC_RECORD()    deca_spi_trace_record(async_header, async_length, async_start, async_tag)
+#else
+#define TRACE_ASYNC_START(len)
+#define TRACE_ASYNC_RECORD()
+#endif
+
+/*
+ * Function: start_async()
+ *
+ * Takes the DW1000 mutex and submits the prepared async_tx/async_rx sets.
+ * Without CONFIG_SPI_ASYNC (and CONFIG_POLL, for the completion signal),
+ * which the application must enable in its prj.conf, the transfer is run
+ * to completion right away.
+ * returns 0 for success, or -1 for error
+ */
+static int start_async(const struct spi_buf_set * rx_set)
+{
+    async_stat = decamutexon();
+    async_pending = true;
+
+#ifdef CONFIG_SPI_ASYNC
+    k_poll_signal_reset(&async_signal);
+    async_result = spi_transceive_async(spi, spi_cfg, &async_tx, rx_set,
+                                        &async_signal);
+    if (async_result == 0) {
+        return 0;
+    }
+#else
+    async_result = spi_transceive(spi, spi_cfg, &async_tx, rx_set);
+#endif
+
+    /* Completed (or failed) synchronously: nothing is in flight. */
+    TRACE_ASYNC_RECORD();
+    async_pending = false;
+    decamutexoff(async_stat);
+
+    return (async_result == 0) ? 0 : -1;
+}
+
+/*
+ * Function: readfromspi_async()
+ *
+ * Low level abstract function to start a read from the SPI without waiting
+ * for its completion. See spi_async_done()/spi_async_wait().
+ * returns 0 for success, or -1 for error
+ */
+int readfromspi_async(uint16        headerLength,
+                      const uint8 * headerBuffer,
+                      uint32        readLength,
+                      uint8       * readBuffer)
+{
+    if (async_pending || headerLength > DECA_MAX_SPI_HEADER_LENGTH) {
+        return -1;
+    }
+
+    memcpy(async_header, headerBuffer, headerLength);
+
+    async_tx_bufs[0].buf = async_header;
+    async_tx_bufs[0].len = headerLength;
+    async_tx.count = 1;
+
+    async_rx_bufs[0].buf = NULL;
+    async_rx_bufs[0].len = headerLength;
+    async_rx_bufs[1].buf = readBuffer;
+    async_rx_bufs[1].len = readLength;
+    async_rx.count = 2;
+
+    TRACE_ASYNC_START(readLength);
+    return start_async(&async_rx);
+}
+
+/*
+ * Function: writetospi_async()
+ *
+ * Low level abstract function to start a write to the SPI without waiting
+ * for its completion. See spi_async_done()/spi_async_wait().
+ * returns 0 for success, or -1 for error
+ */
+int writetospi_async(uint16        headerLength,
+                     const uint8 * headerBuffer,
+                     uint32        bodyLength,
+                     const uint8 * bodyBuffer)
+{
+    if (async_pending || headerLength > DECA_MAX_SPI_HEADER_LENGTH) {
+        return -1;
+    }
+
+    memcpy(async_header, headerBuffer, headerLength);
+
+    async_tx_bufs[0].buf = async_header;
+    async_tx_bufs[0].len = headerLength;
+    async_tx_bufs[1].buf = (uint8 *)bodyBuffer;
+    async_tx_bufs[1].len = bodyLength;
+    async_tx.count = (bodyLength > 0) ? 2 : 1;
+
+    TRACE_ASYNC_START(bodyLength);
+    return start_async(NULL);
+}
+
+/*
+ * Function: spi_async_done()
+ *
+ * Checks whether the pending asynchronous transfer has completed, and if so
+ * releases the DW1000 mutex taken when it was started.
+ * returns 1 if no transfer is pending, 0 if it is still in flight
+ */
+int spi_async_done(void)
+{
+    if (!async_pending) {
+        return 1;
+    }
+
+#ifdef CONFIG_SPI_ASYNC
+    unsigned int signaled;
+    int result;
+
+    k_poll_signal_check(&async_signal, &signaled, &result);
+    if (!signaled) {
+        return 0;
+    }
+    async_result = result;
+#endif
+
+    TRACE_ASYNC_RECORD();
+    async_pending = false;
+    decamutexoff(async_stat);
+
+    return 1;
+}
+
+/*
+ * Function: spi_async_wait()
+ *
+ * Blocks until the pending asynchronous transfer has completed.
+ * returns 0 for success, or -1 if the transfer failed
+ */
+int spi_async_wait(void)
+{
+#ifdef CONFIG_SPI_ASYNC
+    if (async_pending) {
+        struct k_poll_event event = 
+            K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_SIGNAL,
+                                     K_POLL_MODE_NOTIFY_ONLY,
+                                     &async_signal);
+        k_poll(&event, 1, K_FOREVER);
+    }
+#endif
+
+    spi_async_done();
+
+    return (async_result == 0) ? 0 : -1;
+}
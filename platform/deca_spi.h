@@ -41,6 +41,122 @@ int closespi(void) ;
 void set_spi_speed_slow();
 void set_spi_speed_fast();
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: get_spi_speed()
+ *
+ * returns the SPI clock rate currently selected, in Hz
+ */
+uint32 get_spi_speed(void) ;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: set_spi_speed_negotiate()
+ *
+ * Steps the SPI clock up through the supported rates and checks each one by
+ * reading DEV_ID and writing/reading back test patterns in EUI_64 (restored
+ * afterwards). The fastest rate which passes, and which is actually faster
+ * than the previous one on the bus, becomes the rate of set_spi_speed_fast()
+ * and is selected.
+ * The DW1000 must be in IDLE (PLL locked, i.e. after dwt_initialise()), in
+ * INIT it only accepts up to 3 MHz.
+ *
+ * input parameters
+ * @param bytes_per_sec - if not NULL, returns the read throughput measured at the chosen rate
+ *
+ * returns the chosen rate in Hz, or 0 if the device did not answer (the fast rate is then unchanged)
+ */
+uint32 set_spi_speed_negotiate(uint32 * bytes_per_sec) ;
+
+#ifdef DECA_SPI_TRACE
+/*
+ * SPI transaction trace (built with -DDECA_SPI_TRACE)
+ *
+ * Every transaction issued by writetospi()/readfromspi() (and the batched
+ * and asynchronous variants) is logged into a fixed-size ring buffer with
+ * its register file ID, sub-index, length, direction, start and end times
+ * (deca_spi_trace_time()), and the name of the dwt_* function which caused it.
+ * When the ring is full the oldest entries are overwritten.
+ * The ring is in deca_spi_trace.c, which every SPI backend is built with.
+ */
+#ifndef DECA_SPI_TRACE_LEN
+#define DECA_SPI_TRACE_LEN              (256)                   // number of entries in the ring, must be a power of 2
+#endif
+#ifndef DECA_SPI_TRACE_THREADS
+#define DECA_SPI_TRACE_THREADS          (4)                     // threads tagged at once, inside dwt_* functions
+#endif
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: deca_spi_trace_enter()
+ *
+ * Sets the tag recorded with the following transactions of the calling
+ * thread, unless it already has one (the outermost dwt_* function wins).
+ * returns the previous tag, to be given back to deca_spi_trace_exit()
+ */
+const char * deca_spi_trace_enter(const char * tag) ;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: deca_spi_trace_exit()
+ *
+ * Restores the tag returned by deca_spi_trace_enter().
+ */
+void deca_spi_trace_exit(const char * const * prev) ;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: deca_spi_trace_tag()
+ *
+ * returns the tag of the calling thread, NULL if none
+ */
+const char * deca_spi_trace_tag(void) ;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: deca_spi_trace_record()
+ *
+ * Records a transaction, for the SPI backends: its header (register file ID
+ * and sub-index), body length, deca_spi_trace_time() at its start (the end
+ * is now) and tag, see deca_spi_trace_tag().
+ */
+void deca_spi_trace_record(const uint8 * header, uint32 length, uint32 start, const char * tag) ;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: deca_spi_trace_time()
+ *
+ * Clock of the trace: the DWT cycle counter of the CPU on Cortex-M, as a
+ * transaction lasts a few us and k_cycle_get_32() runs from the 32 kHz RTC on
+ * the nRF52; k_cycle_get_32() elsewhere (native_posix).
+ * returns the current time, in ticks of that clock
+ */
+uint32 deca_spi_trace_time(void) ;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: deca_spi_trace_clear()
+ *
+ * Empties the ring buffer.
+ */
+void deca_spi_trace_clear(void) ;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: deca_spi_trace_count()
+ *
+ * returns the number of transactions recorded since the last clear, including the overwritten ones
+ */
+uint32 deca_spi_trace_count(void) ;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: deca_spi_trace_dump()
+ *
+ * Prints the entries of the ring buffer, oldest first, on the console.
+ */
+void deca_spi_trace_dump(void) ;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: deca_spi_trace_summary()
+ *
+ * Prints, for the entries of the ring buffer, the transaction count, total
+ * bytes and p50/p99/max duration per register file, and the transaction
+ * count, total bytes and total duration per dwt_* function.
+ */
+void deca_spi_trace_summary(void) ;
+#endif /* DECA_SPI_TRACE */
+
 #ifdef __cplusplus
 }
 #endif
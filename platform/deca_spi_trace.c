@@ -0,0 +1,297 @@
+/*! ----------------------------------------------------------------------------
+ * @file    deca_spi_trace.c
+ * @brief   SPI transaction trace (built with -DDECA_SPI_TRACE)
+ *
+ * The ring buffer and the tags of deca_spi.h, shared by the SPI backends
+ * (deca_spi.c and sim/deca_spi_sim.c), which record their transactions with
+ * deca_spi_trace_record().
+ */
+
+#include "deca_spi.h"
+
+#include <zephyr.h>
+#include <sys/printk.h>
+
+#ifdef DECA_SPI_TRACE
+
+#if defined(CONFIG_CPU_CORTEX_M_HAS_DWT)
+#include <soc.h>
+#endif
+
+#if (DECA_SPI_TRACE_LEN & (DECA_SPI_TRACE_LEN - 1)) != 0
+#error "DECA_SPI_TRACE_LEN must be a power of 2"
+#endif
+
+#define TRACE_REG_COUNT     (64)        /* register file IDs are 6 bits  */
+#define TRACE_TAG_COUNT     (24)        /* distinct tags in the summary  */
+
+typedef struct {
+    uint32       start;                 /* deca_spi_trace_time() before  */
+    uint32       end;                   /* deca_spi_trace_time() after   */
+    const char * tag;                   /* dwt_* function, NULL if none  */
+    uint16       index;                 /* sub-index                     */
+    uint16       length;                /* body length                   */
+    uint8        reg;                   /* register file ID              */
+    uint8        write;                 /* 1 write, 0 read               */
+} trace_entry_t;
+
+/*
+ * Writers claim a slot by atomically incrementing trace_head, so recording
+ * never blocks (transactions may also be logged from the ISR). The readers
+ * only take a snapshot of trace_head; an entry being overwritten while it
+ * is printed shows up as a garbled line, nothing worse.
+ */
+static trace_entry_t trace_ring [DECA_SPI_TRACE_LEN];
+static atomic_t      trace_head;
+
+/* Scratch area of deca_spi_trace_summary() */
+static uint32        trace_durations [DECA_SPI_TRACE_LEN];
+
+/*
+ * Tag of each thread inside a dwt_* function. A thread may be preempted in
+ * the middle of one by another, e.g. the application by the DW1000 IRQ
+ * thread running dwt_isr(): each keeps its own tag. A slot is claimed by
+ * the outermost deca_spi_trace_enter() of a thread and freed by the
+ * matching deca_spi_trace_exit(); only its owner writes it afterwards.
+ * Threads beyond DECA_SPI_TRACE_THREADS at once are traced untagged.
+ */
+typedef struct {
+    k_tid_t      thread;
+    const char * tag;
+} trace_thread_t;
+
+static trace_thread_t trace_threads [DECA_SPI_TRACE_THREADS];
+
+uint32 deca_spi_trace_time(void)
+{
+#if defined(CONFIG_CPU_CORTEX_M_HAS_DWT)
+    if (!(DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk)) {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+    return DWT->CYCCNT;
+#else
+    return k_cycle_get_32();
+#endif
+}
+
+/* Converts a duration in deca_spi_trace_time() ticks to us */
+static uint32 trace_to_us(uint32 ticks)
+{
+#if defined(CONFIG_CPU_CORTEX_M_HAS_DWT)
+    return ticks / (SystemCoreClock / 1000000);
+#else
+    return k_cyc_to_us_floor32(ticks);
+#endif
+}
+
+static trace_thread_t * trace_thread_find(k_tid_t thread)
+{
+    for (int i = 0; i < DECA_SPI_TRACE_THREADS; i++) {
+        if (trace_threads[i].thread == thread) {
+            return &trace_threads[i];
+        }
+    }
+    return NULL;
+}
+
+const char * deca_spi_trace_enter(const char * tag)
+{
+    k_tid_t          self;
+    trace_thread_t * slot;
+    unsigned int     key;
+
+    if (k_is_in_isr()) {
+        return tag;
+    }
+
+    self = k_current_get();
+    slot = trace_thread_find(self);
+    if (slot != NULL) {
+        return slot->tag;
+    }
+
+    key = irq_lock();
+    slot = trace_thread_find(NULL);
+    if (slot != NULL) {
+        slot->tag = tag;
+        slot->thread = self;
+    }
+    irq_unlock(key);
+
+    /* Untagged if there was no free slot: no exit to undo either */
+    return (slot != NULL) ? NULL : tag;
+}
+
+void deca_spi_trace_exit(const char * const * prev)
+{
+    trace_thread_t * slot;
+
+    if (*prev != NULL) {
+        return;
+    }
+
+    slot = trace_thread_find(k_current_get());
+    if (slot != NULL) {
+        slot->tag = NULL;
+        slot->thread = NULL;
+    }
+}
+
+const char * deca_spi_trace_tag(void)
+{
+    const trace_thread_t * slot;
+
+    if (k_is_in_isr()) {
+        return NULL;
+    }
+
+    slot = trace_thread_find(k_current_get());
+    return (slot != NULL) ? slot->tag : NULL;
+}
+
+void deca_spi_trace_record(const uint8 * header, uint32 length, uint32 start, const char * tag)
+{
+    uint32          end = deca_spi_trace_time();
+    trace_entry_t * entry;
+
+    entry = &trace_ring[(uint32)atomic_inc(&trace_head) & (DECA_SPI_TRACE_LEN - 1)];
+
+    entry->start  = start;
+    entry->end    = end;
+    entry->tag    = tag;
+    entry->reg    = header[0] & 0x3F;
+    entry->write  = (header[0] & 0x80) ? 1 : 0;
+    entry->length = (uint16)length;
+    entry->index  = 0;
+    if (header[0] & 0x40) {
+        entry->index = header[1] & 0x7F;
+        if (header[1] & 0x80) {
+            entry->index |= (uint16)header[2] << 7;
+        }
+    }
+}
+
+void deca_spi_trace_clear(void)
+{
+    atomic_set(&trace_head, 0);
+}
+
+uint32 deca_spi_trace_count(void)
+{
+    return (uint32)atomic_get(&trace_head);
+}
+
+/* Returns the number of valid entries, the oldest one is at *first. */
+static uint32 trace_snapshot(uint32 * first)
+{
+    uint32 head = (uint32)atomic_get(&trace_head);
+
+    if (head > DECA_SPI_TRACE_LEN) {
+        *first = head - DECA_SPI_TRACE_LEN;
+        return DECA_SPI_TRACE_LEN;
+    }
+
+    *first = 0;
+    return head;
+}
+
+static void trace_sort(uint32 * values, uint32 count)
+{
+    for (uint32 i = 1; i < count; i++) {
+        uint32 value = values[i];
+        uint32 j = i;
+
+        while ((j > 0) && (values[j - 1] > value)) {
+            values[j] = values[j - 1];
+            j--;
+        }
+        values[j] = value;
+    }
+}
+
+void deca_spi_trace_dump(void)
+{
+    uint32 first;
+    uint32 count = trace_snapshot(&first);
+
+    printk("spi trace: %u entries\n", count);
+    printk("start_cyc  dur_us dir reg  idx   len fn\n");
+
+    for (uint32 i = 0; i < count; i++) {
+        const trace_entry_t * entry = &trace_ring[(first + i) & (DECA_SPI_TRACE_LEN - 1)];
+
+        printk("%10u %6u %s  0x%02x %4u %5u %s\n",
+               entry->start,
+               trace_to_us(entry->end - entry->start),
+               entry->write ? "W" : "R",
+               entry->reg,
+               entry->index,
+               entry->length,
+               entry->tag ? entry->tag : "-");
+    }
+}
+
+void deca_spi_trace_summary(void)
+{
+    const char * tags [TRACE_TAG_COUNT];
+    uint32       tag_count [TRACE_TAG_COUNT];
+    uint32       tag_bytes [TRACE_TAG_COUNT];
+    uint32       tag_cycles [TRACE_TAG_COUNT];
+    uint32       ntags = 0;
+    uint32       first;
+    uint32       count = trace_snapshot(&first);
+
+    printk("spi trace summary: %u entries\n", count);
+    printk("reg   count    bytes  p50_us  p99_us  max_us\n");
+
+    for (uint8 reg = 0; reg < TRACE_REG_COUNT; reg++) {
+        uint32 n = 0;
+        uint32 bytes = 0;
+
+        for (uint32 i = 0; i < count; i++) {
+            const trace_entry_t * entry = &trace_ring[(first + i) & (DECA_SPI_TRACE_LEN - 1)];
+
+            if (entry->reg == reg) {
+                trace_durations[n++] = entry->end - entry->start;
+                bytes += entry->length;
+            }
+        }
+        if (n == 0) {
+            continue;
+        }
+
+        trace_sort(trace_durations, n);
+        printk("0x%02x %6u %8u %7u %7u %7u\n", reg, n, bytes,
+               trace_to_us(trace_durations[(n - 1) * 50 / 100]),
+               trace_to_us(trace_durations[(n - 1) * 99 / 100]),
+               trace_to_us(trace_durations[n - 1]));
+    }
+
+    for (uint32 i = 0; i < count; i++) {
+        const trace_entry_t * entry = &trace_ring[(first + i) & (DECA_SPI_TRACE_LEN - 1)];
+        uint32 t;
+
+        for (t = 0; (t < ntags) && (tags[t] != entry->tag); t++) {
+        }
+        if (t == ntags) {
+            if (ntags == TRACE_TAG_COUNT) {
+                continue;
+            }
+            tags[t] = entry->tag;
+            tag_count[t] = tag_bytes[t] = tag_cycles[t] = 0;
+            ntags++;
+        }
+        tag_count[t]++;
+        tag_bytes[t] += entry->length;
+        tag_cycles[t] += entry->end - entry->start;
+    }
+
+    printk("count    bytes  total_us fn\n");
+    for (uint32 t = 0; t < ntags; t++) {
+        printk("%5u %8u %9u %s\n", tag_count[t], tag_bytes[t],
+               trace_to_us(tag_cycles[t]),
+               tags[t] ? tags[t] : "-");
+    }
+}
+#endif /* DECA_SPI_TRACE */
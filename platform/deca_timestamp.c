@@ -0,0 +1,40 @@
+/*! ----------------------------------------------------------------------------
+ * @file	deca_timestamp.c
+ * @brief	DW1000 40 bit timestamps, see deca_timestamp.h
+ *
+ * @attention
+ *
+ * All rights reserved.
+ *
+ */
+
+#include "deca_device_api.h"
+#include "deca_timestamp.h"
+
+uint64 ts_read_tx(void)
+{
+    uint64 ts = 0;
+
+    /* The 5 bytes of the register, in the low bytes of ts */
+    dwt_readtxtimestamp((uint8 *)&ts);
+    return ts;
+}
+
+uint64 ts_read_rx(void)
+{
+    uint64 ts = 0;
+
+    dwt_readrxtimestamp((uint8 *)&ts);
+    return ts;
+}
+
+void ts_timeline_init(ts_timeline_t *t, uint64 ts)
+{
+    t->last = ts & TS_MASK;
+}
+
+uint64 ts_extend(ts_timeline_t *t, uint64 ts)
+{
+    t->last += (uint64)ts_diff(ts, t->last);
+    return t->last;
+}
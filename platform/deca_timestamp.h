@@ -0,0 +1,157 @@
+/*! ----------------------------------------------------------------------------
+ * @file	deca_timestamp.h
+ * @brief	DW1000 40 bit timestamps: reading, arithmetic across the wrap, and frame fields
+ *
+ * The DW1000 system time counts dtu (1 / (499.2 MHz * 128), about 15.65 ps) in 40 bits and wraps every 17.2 s.
+ * Timestamps are held in the low 40 bits of a uint64: sums and differences must go through the helpers below, or be
+ * masked with TS_MASK, to stay right across the wrap. ts_extend() carries them on a 64 bit timeline which does not
+ * wrap, for the times which must be compared over longer than half a wrap.
+ *
+ * Timestamps travel in frames least significant byte first, whole (5 bytes) or truncated to their low 32 bits
+ * (4 bytes). A truncated timestamp only gives intervals up to 2^32 dtu (67 ms), with the other end from the same
+ * device and frame, see ts_interval32().
+ */
+
+#ifndef _DECA_TIMESTAMP_H_
+#define _DECA_TIMESTAMP_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "deca_types.h"
+
+/* Timestamps and frame fields are little endian, like the DW1000 registers: they are copied in place */
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__)
+#error "deca_timestamp.h needs a little endian target"
+#endif
+
+#define TS_BITS                     (40)
+#define TS_MASK                     (0xFFFFFFFFFFULL)
+#define TS_HALF                     (0x8000000000ULL)   // half a wrap, the limit of ts_diff()
+#define TS_LEN                      (5)                 // bytes of a whole timestamp field
+#define TS_LEN32                    (4)                 // bytes of a truncated timestamp field
+
+/* 64 bit timeline of the timestamps of a device, see ts_extend() */
+typedef struct
+{
+    uint64 last;        // last time given by ts_extend()
+} ts_timeline_t;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: ts_read_tx()
+ *
+ * Returns the TX timestamp of the last frame sent, in one SPI read.
+ */
+uint64 ts_read_tx(void);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: ts_read_rx()
+ *
+ * Returns the RX timestamp of the last frame received, in one SPI read. The callbacks get it in cb_data->rx_ts.
+ */
+uint64 ts_read_rx(void);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: ts_timeline_init()
+ *
+ * Starts a timeline at timestamp ts, which ts_extend() gives as is.
+ */
+void ts_timeline_init(ts_timeline_t *t, uint64 ts);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: ts_extend()
+ *
+ * Returns timestamp ts on the 64 bit timeline t: the time nearest to the last one given, whose low 40 bits are ts.
+ * The timestamps must come less than half a wrap (8.6 s) apart, earlier ones included.
+ */
+uint64 ts_extend(ts_timeline_t *t, uint64 ts);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: ts_add()
+ *
+ * Returns timestamp ts moved by dtu, which may be negative.
+ */
+static inline uint64 ts_add(uint64 ts, int64 dtu)
+{
+    return (ts + (uint64)dtu) & TS_MASK;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: ts_interval()
+ *
+ * Returns the time (dtu) from timestamp earlier to timestamp later, which comes after it by less than a wrap.
+ */
+static inline uint64 ts_interval(uint64 later, uint64 earlier)
+{
+    return (later - earlier) & TS_MASK;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: ts_interval32()
+ *
+ * As ts_interval(), from the low 32 bits of both timestamps, for the intervals shorter than 2^32 dtu (67 ms).
+ */
+static inline uint32 ts_interval32(uint32 later, uint32 earlier)
+{
+    return (uint32)((later - earlier) & 0xFFFFFFFFUL);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: ts_diff()
+ *
+ * Returns a - b (dtu), for timestamps less than half a wrap apart: negative if a comes before b.
+ */
+static inline int64 ts_diff(uint64 a, uint64 b)
+{
+    uint64 d = (a - b) & TS_MASK;
+
+    return (d >= TS_HALF) ? (int64)d - (int64)(TS_MASK + 1) : (int64)d;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: ts_get()/ts_set()
+ *
+ * Read and write the timestamp field of len bytes (TS_LEN or TS_LEN32) at field, least significant byte first.
+ * Called with a constant len, as by the wrappers below, they are a single copy.
+ */
+static inline uint64 ts_get(const uint8 *field, int len)
+{
+    uint64 ts = 0;
+
+    memcpy(&ts, field, len);
+    return ts;
+}
+
+static inline void ts_set(uint8 *field, int len, uint64 ts)
+{
+    memcpy(field, &ts, len);
+}
+
+static inline uint64 ts_get40(const uint8 *field)
+{
+    return ts_get(field, TS_LEN);
+}
+
+static inline uint32 ts_get32(const uint8 *field)
+{
+    return (uint32)ts_get(field, TS_LEN32);
+}
+
+static inline void ts_set40(uint8 *field, uint64 ts)
+{
+    ts_set(field, TS_LEN, ts);
+}
+
+static inline void ts_set32(uint8 *field, uint64 ts)
+{
+    ts_set(field, TS_LEN32, ts);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DECA_TIMESTAMP_H_ */
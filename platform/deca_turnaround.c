@@ -0,0 +1,53 @@
+/*! ----------------------------------------------------------------------------
+ * @file	deca_turnaround.c
+ * @brief	Self-tuning turnaround delays for delayed transmissions, see deca_turnaround.h
+ *
+ * @attention
+ *
+ * All rights reserved.
+ *
+ */
+
+#include "deca_turnaround.h"
+
+void turnaround_init(turnaround_t *t, uint16 max_uus, uint16 min_uus)
+{
+    t->dly_uus = max_uus;
+    t->min_uus = (min_uus < max_uus) ? min_uus : max_uus;
+    t->max_uus = max_uus;
+    t->run = 0;
+    t->hold = TURNAROUND_HOLD_MIN;
+    t->late = 0;
+}
+
+int turnaround_ok(turnaround_t *t)
+{
+    if ((t->dly_uus <= t->min_uus) || (++t->run < t->hold))
+    {
+        return 0;
+    }
+    t->run = 0;
+    t->dly_uus = (t->dly_uus - t->min_uus > TURNAROUND_STEP_UUS) ? t->dly_uus - TURNAROUND_STEP_UUS : t->min_uus;
+    return 1;
+}
+
+int turnaround_late(turnaround_t *t)
+{
+    uint16 dly_uus;
+
+    t->late++;
+    t->run = 0;
+    if (t->min_uus == t->max_uus)
+    {
+        return 0;
+    }
+    /* Hysteresis: each late reply makes the next shortening wait longer */
+    t->hold = (t->hold < TURNAROUND_HOLD_MAX / 2) ? t->hold * 2 : TURNAROUND_HOLD_MAX;
+    dly_uus = (t->max_uus - t->dly_uus > TURNAROUND_BACKOFF_UUS) ? t->dly_uus + TURNAROUND_BACKOFF_UUS : t->max_uus;
+    if (dly_uus == t->dly_uus)
+    {
+        return 0;
+    }
+    t->dly_uus = dly_uus;
+    return 1;
+}
@@ -0,0 +1,63 @@
+/*! ----------------------------------------------------------------------------
+ * @file	deca_turnaround.h
+ * @brief	Self-tuning turnaround delays for delayed transmissions
+ *
+ * A turnaround is the delay between the reception of a frame and the
+ * delayed transmission of the reply. It starts at its longest, safe value
+ * and is shortened by TURNAROUND_STEP_UUS after a run of on-time replies.
+ * A late reply (dwt_starttx() failing on HPDWARN) lengthens it by
+ * TURNAROUND_BACKOFF_UUS and doubles the run needed to shorten it again,
+ * so it settles just above the shortest delay the build, CPU load and SPI
+ * speed allow.
+ */
+
+#ifndef _DECA_TURNAROUND_H_
+#define _DECA_TURNAROUND_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "deca_types.h"
+
+#define TURNAROUND_STEP_UUS         (50)        // shortening after a run of on-time replies
+#define TURNAROUND_BACKOFF_UUS      (200)       // lengthening after a late reply
+#define TURNAROUND_HOLD_MIN         (16)        // on-time replies before the first shortening
+#define TURNAROUND_HOLD_MAX         (1024)
+
+typedef struct
+{
+    uint16 dly_uus;     // current turnaround (UWB microseconds)
+    uint16 min_uus;
+    uint16 max_uus;     // starting value
+    uint16 run;         // on-time replies since the last change
+    uint16 hold;        // on-time replies needed to shorten
+    uint32 late;        // late replies, in total
+} turnaround_t;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: turnaround_init()
+ *
+ * Starts a turnaround at max_uus. It is fixed if min_uus is max_uus.
+ */
+void turnaround_init(turnaround_t *t, uint16 max_uus, uint16 min_uus);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: turnaround_ok()
+ *
+ * Records a reply sent on time. Returns 1 if the turnaround was shortened, 0 otherwise.
+ */
+int turnaround_ok(turnaround_t *t);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: turnaround_late()
+ *
+ * Records a late reply. Returns 1 if the turnaround was lengthened, 0 otherwise.
+ */
+int turnaround_late(turnaround_t *t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DECA_TURNAROUND_H_ */
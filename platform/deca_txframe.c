@@ -0,0 +1,33 @@
+/*! ----------------------------------------------------------------------------
+ * @file	deca_txframe.c
+ * @brief	Frames kept in the DW1000 TX buffer, patched in place, see deca_txframe.h
+ *
+ * @attention
+ *
+ * All rights reserved.
+ *
+ */
+
+#include "deca_device_api.h"
+#include "deca_txframe.h"
+
+/* dwt_writetxdata() lengths count the 2 bytes of the FCS, which it does not write */
+#define TXFRAME_FCS_LEN             (2)
+
+void txframe_load(txframe_t *f, const uint8 *data, uint16 len, uint16 offset)
+{
+    f->data = data;
+    f->len = len;
+    f->offset = offset;
+    dwt_writetxdata(len, (uint8 *)data, offset);
+}
+
+void txframe_patch(const txframe_t *f, uint16 first, uint16 last)
+{
+    dwt_writetxdata(last - first + 1 + TXFRAME_FCS_LEN, (uint8 *)&f->data[first], f->offset + first);
+}
+
+void txframe_select(const txframe_t *f, int ranging)
+{
+    dwt_writetxfctrl(f->len, f->offset, ranging);
+}
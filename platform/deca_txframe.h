@@ -0,0 +1,60 @@
+/*! ----------------------------------------------------------------------------
+ * @file	deca_txframe.h
+ * @brief	Frames kept in the DW1000 TX buffer, patched in place
+ *
+ * Each frame an application sends is loaded once, whole, at its own offset
+ * of the 1024 byte TX buffer. Before a transmission only the bytes which
+ * changed since (sequence number, addresses, timestamps) are written, from
+ * the copy of the frame kept by the application, and the frame is selected
+ * with its offset in TX_FCTRL. The bytes known early can be written while
+ * the device is waiting for a frame, leaving less SPI traffic between the
+ * reception and the delayed transmission which answers it.
+ *
+ * The TX buffer is lost when the DW1000 sleeps or is reset: the frames must
+ * then be loaded again.
+ */
+
+#ifndef _DECA_TXFRAME_H_
+#define _DECA_TXFRAME_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "deca_types.h"
+
+typedef struct
+{
+    const uint8 *data;  // copy of the frame kept by the application, FCS included
+    uint16 len;         // frame length, FCS included
+    uint16 offset;      // offset of the frame in the TX buffer
+} txframe_t;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: txframe_load()
+ *
+ * Writes a whole frame at a given offset of the TX buffer. The data stays the application's, it is read again by
+ * txframe_patch().
+ */
+void txframe_load(txframe_t *f, const uint8 *data, uint16 len, uint16 offset);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: txframe_patch()
+ *
+ * Writes the bytes from index first to index last of the frame, both included, from the application's copy. The bytes in
+ * between are written too: one write of a few bytes more is cheaper than two.
+ */
+void txframe_patch(const txframe_t *f, uint16 first, uint16 last);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: txframe_select()
+ *
+ * Makes the frame the one sent by the next dwt_starttx(), ranging is the ranging bit of the frame.
+ */
+void txframe_select(const txframe_t *f, int ranging);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DECA_TXFRAME_H_ */
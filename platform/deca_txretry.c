@@ -0,0 +1,33 @@
+/*! ----------------------------------------------------------------------------
+ * @file	deca_txretry.c
+ * @brief	New time for a delayed transmission which dwt_starttx() could not start, see deca_txretry.h
+ *
+ * @attention
+ *
+ * All rights reserved.
+ *
+ */
+
+#include "deca_device_api.h"
+#include "deca_txretry.h"
+
+/* 1 uus = 512 / 499.2 usec and 1 usec = 499.2 * 128 dtu */
+#define TXRETRY_UUS_TO_DTU          (65536)
+/* DW1000 system time is 40 bits of dtu, delayed transmissions ignore the low 9 */
+#define TXRETRY_TIME_MASK           (0xFFFFFFFFFFULL)
+#define TXRETRY_TIME_RES            (0x1FFULL)
+
+int txretry_time(uint64 *tx_time, uint32 max_slip_uus)
+{
+    uint64 now = (uint64)dwt_readsystimestamphi32() << 8;
+    uint64 retry = (now + (uint64)TXRETRY_LEAD_UUS * TXRETRY_UUS_TO_DTU + TXRETRY_TIME_RES) & TXRETRY_TIME_MASK & ~TXRETRY_TIME_RES;
+    uint64 slip = (retry - *tx_time) & TXRETRY_TIME_MASK;
+
+    /* The planned time is still ahead (the failure was not lateness) or too far behind */
+    if ((slip > (TXRETRY_TIME_MASK >> 1)) || (slip > (uint64)max_slip_uus * TXRETRY_UUS_TO_DTU))
+    {
+        return -1;
+    }
+    *tx_time = retry;
+    return 0;
+}
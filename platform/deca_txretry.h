@@ -0,0 +1,39 @@
+/*! ----------------------------------------------------------------------------
+ * @file	deca_txretry.h
+ * @brief	New time for a delayed transmission which dwt_starttx() could not start
+ *
+ * A delayed transmission missed by a little (see dwt_gettxlatecause()) can
+ * often still be sent in the same exchange: the receiver of the other end
+ * opens a guard time before the expected frame and closes it after. The
+ * transmission is retried at the earliest time it can still start, as long
+ * as it is no more than a given slip after the planned time. The caller
+ * recomputes whatever depends on the transmission time (e.g. a TX timestamp
+ * carried by the frame) before starting it again.
+ */
+
+#ifndef _DECA_TXRETRY_H_
+#define _DECA_TXRETRY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "deca_types.h"
+#include "port.h"
+
+#define TXRETRY_LEAD_UUS            (100)       // time to program and power up the transmitter, from now
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: txretry_time()
+ *
+ * Moves a delayed transmission time (dtu, 40 bits, low 9 bits ignored) to the earliest one it can still start,
+ * TXRETRY_LEAD_UUS from now. Returns 0 if it is no more than max_slip_uus after the planned one, -1 otherwise, in which
+ * case tx_time is left as is.
+ */
+int txretry_time(uint64 *tx_time, uint32 max_slip_uus);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DECA_TXRETRY_H_ */
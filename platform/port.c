@@ -29,6 +29,12 @@
 static const struct device * gpio_dev;
 static struct gpio_callback gpio_cb;
 
+/* GPIOTE channel of the DW_IRQ pin, found by port_set_deca_isr() */
+static uint32_t deca_irq_mask;
+static gpio_pin_t deca_irq_pin;
+
+static port_deca_isr_t port_deca_isr;
+
 /****************************************************************************//**
  *
  *                              APP global variables
@@ -198,10 +204,22 @@ void led_on (led_t led)
 
 /* @fn      port_wakeup_dw1000
  * @brief   "slow" waking up of DW1000 using DW_CS only
+ *          The CS is held low by a long read at the slow rate (the DW1000
+ *          does not accept more than 3 MHz before its PLL is locked), then
+ *          the previous rate is restored.
  * */
 void port_wakeup_dw1000(void)
 {
-    //TODO
+    static uint8 wakeup_buf [600];  /* 2.4ms of CS low at 2MHz */
+    uint32 frequency = get_spi_speed();
+
+    set_spi_speed_slow();
+
+    dwt_spicswakeup(wakeup_buf, sizeof(wakeup_buf));
+
+    if (frequency != get_spi_speed()) {
+        set_spi_speed_fast();
+    }
 }
 
 /* @fn      port_wakeup_dw1000_fast
@@ -225,11 +243,26 @@ void port_set_dw1000_slowrate(void)
 }
 
 /* @fn      port_set_dw1000_fastrate
- * @brief   set 8MHz
+ * @brief   set 8MHz, or the rate found by port_set_dw1000_maxrate()
  * */
 void port_set_dw1000_fastrate(void)
 {
-    //TODO
+    set_spi_speed_fast();
+}
+
+/* @fn      port_set_dw1000_maxrate
+ * @brief   set the fastest rate the board can handle
+ *          The rate is negotiated with the DW1000 on the first call, which
+ *          must be made once it is in IDLE (after dwt_initialise()), and
+ *          then reused by port_set_dw1000_fastrate().
+ * */
+void port_set_dw1000_maxrate(void)
+{
+    static bool negotiated;
+
+    if (!negotiated) {
+        negotiated = (set_spi_speed_negotiate(NULL) != 0);
+    }
     set_spi_speed_fast();
 }
 
@@ -256,36 +289,54 @@ void port_set_dw1000_fastrate(void)
  * */
 void process_deca_irq(void)
 {
-    //TODO
+    int calls = 0;
+
+    if (!port_deca_isr) {
+        return;
+    }
+
+    /* No new edge comes while the line stays high: a bounded number of
+     * re-entries so that a handler which does not clear the events cannot
+     * starve the other threads. */
+    do {
+        port_deca_isr();
+    } while (port_CheckEXT_IRQ() && (++calls < DECA_IRQ_REENTRY_MAX));
 }
 
 
 /* @fn      port_DisableEXT_IRQ
  * @brief   wrapper to disable DW_IRQ pin IRQ
- *          in current implementation it disables all IRQ from lines 5:9
+ *          in current implementation it masks the interrupt of the GPIOTE
+ *          channel of DW_IRQ only: the other GPIO, BLE and timer interrupts
+ *          keep running. The IN event is still latched by the GPIOTE, so an
+ *          edge arriving while masked is serviced when unmasked.
  * */
 void port_DisableEXT_IRQ(void)
 {
-    //TODO
+    nrf_gpiote_int_disable(NRF_GPIOTE, deca_irq_mask);
 }
 
 /* @fn      port_EnableEXT_IRQ
  * @brief   wrapper to enable DW_IRQ pin IRQ
- *          in current implementation it enables all IRQ from lines 5:9
+ *          in current implementation it unmasks the interrupt of the GPIOTE
+ *          channel of DW_IRQ only
  * */
 void port_EnableEXT_IRQ(void)
 {
-    //TODO
+    nrf_gpiote_int_enable(NRF_GPIOTE, deca_irq_mask);
 }
 
 
 /* @fn      port_GetEXT_IRQStatus
  * @brief   wrapper to read a DW_IRQ pin IRQ status
+ *          returns 0 until port_set_deca_isr() is called
  * */
 uint32_t port_GetEXT_IRQStatus(void)
 {
-    //TODO
-    return 0;
+    if (deca_irq_mask == 0) {
+        return 0;
+    }
+    return nrf_gpiote_int_enable_check(NRF_GPIOTE, deca_irq_mask) ? 1 : 0;
 }
 
 
@@ -294,8 +345,10 @@ uint32_t port_GetEXT_IRQStatus(void)
  * */
 uint32_t port_CheckEXT_IRQ(void)
 {
-    //TODO
-    return 0;
+    if (!gpio_dev) {
+        return 0;
+    }
+    return (gpio_pin_get_raw(gpio_dev, deca_irq_pin) > 0) ? 1 : 0;
 }
 
 
@@ -305,6 +358,106 @@ uint32_t port_CheckEXT_IRQ(void)
  *
  *******************************************************************************/
 
+/****************************************************************************//**
+ *
+ *                          DW1000 IRQ dispatch section
+ *
+ *******************************************************************************/
+
+K_SEM_DEFINE(deca_irq_sem, 0, 1);
+
+static volatile bool     deca_irq_pending;
+static volatile uint32_t deca_irq_edge_time;
+
+static uint32_t irq_latency [DECA_IRQ_STATS_LEN];  /* in hardware cycles */
+static uint32_t irq_latency_sorted [DECA_IRQ_STATS_LEN];  /* guarded by irq_stats_mutex */
+K_MUTEX_DEFINE(irq_stats_mutex);
+static uint32_t irq_latency_count;
+static uint32_t irq_latency_max;
+
+/* GPIO interrupt: timestamp the first edge not yet handled, wake the thread */
+static void deca_irq_edge(const struct device * dev, struct gpio_callback * cb,
+                          uint32_t pins)
+{
+    if (!deca_irq_pending) {
+        deca_irq_edge_time = k_cycle_get_32();
+        deca_irq_pending = true;
+    }
+    k_sem_give(&deca_irq_sem);
+}
+
+static void deca_irq_thread(void * p1, void * p2, void * p3)
+{
+    while (1) {
+        unsigned int key;
+        uint32_t     latency;
+
+        k_sem_take(&deca_irq_sem, K_FOREVER);
+
+        key = irq_lock();
+        latency = k_cycle_get_32() - deca_irq_edge_time;
+        deca_irq_pending = false;
+        irq_latency[irq_latency_count % DECA_IRQ_STATS_LEN] = latency;
+        irq_latency_count++;
+        if (latency > irq_latency_max) {
+            irq_latency_max = latency;
+        }
+        irq_unlock(key);
+
+        process_deca_irq();
+    }
+}
+
+K_THREAD_DEFINE(deca_irq_tid, DECA_IRQ_THREAD_STACKSIZE, deca_irq_thread,
+                NULL, NULL, NULL, DECA_IRQ_THREAD_PRIORITY, 0, 0);
+
+/* @fn      port_set_deca_irq_priority
+ * @brief   changes the priority of the DW1000 IRQ thread
+ * */
+void port_set_deca_irq_priority(int prio)
+{
+    k_thread_priority_set(deca_irq_tid, prio);
+}
+
+/* @fn      port_deca_irq_stats
+ * @brief   reads the DW_IRQ edge to handler latency statistics, in us
+ * */
+void port_deca_irq_stats(uint32_t * p50, uint32_t * p99, uint32_t * max,
+                         uint32_t * count, int reset)
+{
+    unsigned int key;
+    uint32_t     n;
+
+    /* The sort runs outside of irq_lock(), on a buffer shared by the callers */
+    k_mutex_lock(&irq_stats_mutex, K_FOREVER);
+    key = irq_lock();
+    n = MIN(irq_latency_count, DECA_IRQ_STATS_LEN);
+    memcpy(irq_latency_sorted, irq_latency, n * sizeof(irq_latency[0]));
+    *max = k_cyc_to_us_ceil32(irq_latency_max);
+    *count = irq_latency_count;
+    if (reset) {
+        irq_latency_count = 0;
+        irq_latency_max = 0;
+    }
+    irq_unlock(key);
+
+    /* Insertion sort, the sample set is small */
+    for (uint32_t i = 1; i < n; i++) {
+        uint32_t v = irq_latency_sorted[i];
+        uint32_t j = i;
+
+        while ((j > 0) && (irq_latency_sorted[j - 1] > v)) {
+            irq_latency_sorted[j] = irq_latency_sorted[j - 1];
+            j--;
+        }
+        irq_latency_sorted[j] = v;
+    }
+
+    *p50 = n ? k_cyc_to_us_ceil32(irq_latency_sorted[(n - 1) / 2]) : 0;
+    *p99 = n ? k_cyc_to_us_ceil32(irq_latency_sorted[((n - 1) * 99) / 100]) : 0;
+    k_mutex_unlock(&irq_stats_mutex);
+}
+
 /* DW1000 IRQ handler definition. */
 
 #define GPIO_NAME    DT_LABEL(DT_PHANDLE_BY_IDX(DT_NODELABEL(dwmirq), gpios, 0))
@@ -331,14 +484,31 @@ void port_set_deca_isr(port_deca_isr_t deca_isr)
         return;
     }
 
-    /* Decawave interrupt */
+    port_deca_isr = deca_isr;
+
+    /* Decawave interrupt, dispatched to the DW1000 IRQ thread */
     gpio_pin_configure(gpio_dev, GPIO_PIN, (GPIO_INPUT | GPIO_FLAGS));
 
-    gpio_init_callback(&gpio_cb, (gpio_callback_handler_t)(deca_isr), BIT(GPIO_PIN));
+    gpio_init_callback(&gpio_cb, deca_irq_edge, BIT(GPIO_PIN));
 
     gpio_add_callback(gpio_dev, &gpio_cb);
 
     gpio_pin_interrupt_configure(gpio_dev, GPIO_PIN, GPIO_INT_EDGE_RISING);
+
+    /* Find the GPIOTE channel the GPIO driver allocated to DW_IRQ */
+    deca_irq_pin = GPIO_PIN;
+    deca_irq_mask = 0;
+    for (int ch = 0; ch < GPIOTE_CH_NUM; ch++) {
+        if (((NRF_GPIOTE->CONFIG[ch] & GPIOTE_CONFIG_MODE_Msk) ==
+             (GPIOTE_CONFIG_MODE_Event << GPIOTE_CONFIG_MODE_Pos)) &&
+            (nrf_gpiote_event_pin_get(NRF_GPIOTE, ch) == GPIO_PIN)) {
+            deca_irq_mask = BIT(ch);
+            break;
+        }
+    }
+    if (!deca_irq_mask) {
+        printk("%s: no GPIOTE channel for pin %d, IRQ not masked by decamutexon\n", __func__, GPIO_PIN);
+    }
 }
 
 /****************************************************************************//**
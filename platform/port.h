@@ -29,6 +29,40 @@ extern "C" {
 /* DW1000 IRQ handler type. */
 typedef void (*port_deca_isr_t)(void);
 
+/*
+ * DW1000 IRQ dispatch: the GPIO interrupt only timestamps the edge and
+ * wakes a dedicated thread, which runs the installed handler (normally
+ * dwt_isr()) with the SPI transactions out of interrupt context. Its stack
+ * and priority are set by CONFIG_DECA_IRQ_THREAD_STACKSIZE and
+ * CONFIG_DECA_IRQ_THREAD_PRIORITY on the DWM1001 (boards/arm/nrf52_dwm1001/
+ * Kconfig), by the defaults below elsewhere.
+ */
+#ifndef DECA_IRQ_THREAD_STACKSIZE
+#ifdef CONFIG_DECA_IRQ_THREAD_STACKSIZE
+#define DECA_IRQ_THREAD_STACKSIZE   CONFIG_DECA_IRQ_THREAD_STACKSIZE
+#else
+#define DECA_IRQ_THREAD_STACKSIZE   (2048)
+#endif
+#endif
+
+#ifndef DECA_IRQ_THREAD_PRIORITY
+#ifdef CONFIG_DECA_IRQ_THREAD_PRIORITY
+#define DECA_IRQ_THREAD_PRIORITY    K_PRIO_COOP(CONFIG_DECA_IRQ_THREAD_PRIORITY)
+#else
+#define DECA_IRQ_THREAD_PRIORITY    K_PRIO_COOP(2)
+#endif
+#endif
+
+/* Handler calls per edge while the IRQ line stays high */
+#ifndef DECA_IRQ_REENTRY_MAX
+#define DECA_IRQ_REENTRY_MAX        (4)
+#endif
+
+/* Latency samples kept for the percentiles */
+#ifndef DECA_IRQ_STATS_LEN
+#define DECA_IRQ_STATS_LEN          (128)
+#endif
+
 
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn port_set_deca_isr()
@@ -43,6 +77,35 @@ typedef void (*port_deca_isr_t)(void);
  */
 void port_set_deca_isr(port_deca_isr_t deca_isr);
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn port_set_deca_irq_priority()
+ *
+ * @brief Changes the priority of the DW1000 IRQ thread (DECA_IRQ_THREAD_PRIORITY by default).
+ *
+ * @param prio Zephyr thread priority
+ *
+ * @return none
+ */
+void port_set_deca_irq_priority(int prio);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn port_deca_irq_stats()
+ *
+ * @brief Reads the latency from the DW_IRQ edge to the entry of the handler,
+ *        in microseconds. The percentiles are over the last
+ *        DECA_IRQ_STATS_LEN edges, the maximum and count since the last reset.
+ *
+ * @param p50   median latency
+ * @param p99   99th percentile latency
+ * @param max   maximum latency
+ * @param count number of edges handled
+ * @param reset if non-zero, the statistics are cleared after being read
+ *
+ * @return none
+ */
+void port_deca_irq_stats(uint32_t * p50, uint32_t * p99, uint32_t * max,
+                         uint32_t * count, int reset);
+
 
 
 /*****************************************************************************************************************//*
@@ -53,9 +116,7 @@ void port_set_deca_isr(port_deca_isr_t deca_isr);
   *                                 Types definitions
   *
   *******************************************************************************/
-typedef uint64_t        uint64 ;
-
-typedef int64_t         int64 ;
+#include "deca_types.h"      // uint64, int64
 
 
 #ifndef FALSE
@@ -144,6 +205,7 @@ void port_wakeup_dw1000_fast(void);
 
 void port_set_dw1000_slowrate(void);
 void port_set_dw1000_fastrate(void);
+void port_set_dw1000_maxrate(void);
 
 void process_dwRSTn_irq(void);
 void process_deca_irq(void);
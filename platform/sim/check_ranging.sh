@@ -0,0 +1,66 @@
+#!/bin/sh
+#
+# Ranging check on the DW1000 model
+#    builds idmind_anchor and idmind_tag for native_posix (unless already built),
+#    runs them on the simulated air for SECS seconds, the anchor at the origin
+#    and the tag at DW1000_SIM_POS, and checks the ranges of the anchor:
+#    at least MIN_RANGES, with a median within TOL_MM of the distance
+#
+#  usage:  platform/sim/check_ranging.sh
+#     e.g. DW1000_SIM_POS=10,5,0 SECS=30 platform/sim/check_ranging.sh
+#     needs ZEPHYR_BASE, as for the other builds
+#
+#  exits with 0 if the check passed, 1 if not
+#
+ROOT=$(cd "$(dirname "$0")/../.." && pwd)
+
+POS=${DW1000_SIM_POS:-3,0,0}
+SECS=${SECS:-15}
+MIN_RANGES=${MIN_RANGES:-50}
+TOL_MM=${TOL_MM:-100}
+# Port of the simulated air, apart from the default one so that other runs are not heard
+export DW1000_SIM_PORT=${DW1000_SIM_PORT:-47100}
+
+# Builds an application for native_posix in build_sim, prints its executable
+build_sim()
+{
+    dir=$ROOT/idmind/$1
+    if [ ! -x "$dir/build_sim/zephyr/zephyr.exe" ]; then
+        cmake -S "$dir" -B "$dir/build_sim" -DBOARD=native_posix > /dev/null || return 1
+        make -C "$dir/build_sim" > /dev/null || return 1
+    fi
+    echo "$dir/build_sim/zephyr/zephyr.exe"
+}
+
+# ANCHOR and TAG may give executables built elsewhere
+ANCHOR=${ANCHOR:-$(build_sim idmind_anchor)} || exit 1
+TAG=${TAG:-$(build_sim idmind_tag)} || exit 1
+
+LOG=$(mktemp -d)
+trap 'rm -rf "$LOG"' EXIT
+
+DW1000_SIM_POS=0,0,0 DW1000_SIM_PPM=5 timeout -s INT $((SECS + 2)) "$ANCHOR" -stop_at=$((SECS + 1)) > "$LOG/anchor" 2>&1 &
+sleep 1
+DW1000_SIM_POS=$POS DW1000_SIM_PPM=-5 timeout -s INT "$SECS" "$TAG" -stop_at="$SECS" > "$LOG/tag" 2>&1
+wait
+
+# Distance to the origin (mm) and the anchor's ranges (mm), one per line
+EXPECTED=$(echo "$POS" | awk -F, '{ printf "%d\n", sqrt($1 * $1 + $2 * $2 + $3 * $3) * 1000 + 0.5 }')
+sed -n 's/^Estimated Distance: \(-\{0,1\}\)\([0-9]*\)\.\([0-9]*\)m.*/\1\2\3/p' "$LOG/anchor" | sed 's/^\(-\{0,1\}\)0*\([0-9]\)/\1\2/' | sort -n > "$LOG/ranges"
+COUNT=$(wc -l < "$LOG/ranges")
+
+if [ "$COUNT" -eq 0 ]; then
+    echo "check_ranging: no ranges, tag at $POS"
+    tail -5 "$LOG/anchor"
+    exit 1
+fi
+
+MEDIAN=$(sed -n "$(( (COUNT + 1) / 2 ))p" "$LOG/ranges")
+ERROR=$((MEDIAN - EXPECTED))
+echo "check_ranging: tag at $POS ($EXPECTED mm), $COUNT ranges, median $MEDIAN mm, min $(head -1 "$LOG/ranges") mm, max $(tail -1 "$LOG/ranges") mm"
+
+if [ "$COUNT" -lt "$MIN_RANGES" ] || [ "${ERROR#-}" -gt "$TOL_MM" ]; then
+    echo "check_ranging: FAILED (at least $MIN_RANGES ranges within $TOL_MM mm)"
+    exit 1
+fi
+echo "check_ranging: passed"
@@ -0,0 +1,370 @@
+/*! ----------------------------------------------------------------------------
+ * @file    deca_spi_sim.c
+ * @brief   SPI access functions, native_posix implementation
+ *
+ * The transactions are answered by the DW1000 model (dw1000_model.c)
+ * instead of a SPI peripheral. The asynchronous variants are in flight for
+ * their bus time with DW1000_SIM_SPI_TIME, and until the next check of
+ * their completion otherwise. DECA_SPI_SIM_STAGING brings back the staging
+ * copies of the former deca_spi.c, see deca_spi_sim.h.
+ */
+
+#include "deca_spi.h"
+#include "deca_device_api.h"
+#include "port.h"
+#include "dw1000_model.h"
+#include "deca_spi_sim.h"
+
+#include <string.h>
+#include <zephyr.h>
+#include <sys/printk.h>
+
+/* Transactions are traced as by deca_spi.c, see deca_spi_trace.c. On
+ * native_posix time stands still while the model runs: they all last 0 us. */
+#ifdef DECA_SPI_TRACE
+#define TRACE_START(v)                  uint32 v = deca_spi_trace_time()
+#define TRACE_RECORD(hdr, len, start)   deca_spi_trace_record(hdr, len, start, deca_spi_trace_tag())
+#else
+#define TRACE_START(v)
+#define TRACE_RECORD(hdr, len, start)
+#endif
+
+/*
+ *****************************************************************************
+ *
+ *                              DW1000 SPI section
+ *
+ *****************************************************************************
+ */
+
+static deca_spi_sim_stats_t sim_stats;
+
+#ifdef DECA_SPI_SIM_STAGING
+/* Larger than those of deca_spi.c, so that the longer transactions are
+ * counted instead of overflowing them */
+#define STAGING_BUF_LEN     (DECA_MAX_SPI_HEADER_LENGTH + 4096)
+
+static uint8 tx_buf [STAGING_BUF_LEN];
+static uint8 rx_buf [STAGING_BUF_LEN];
+#endif
+
+/*
+ * Function: sim_transfer()
+ *
+ * Hands one transaction to the model, through tx_buf/rx_buf with
+ * DECA_SPI_SIM_STAGING, straight from and to the caller's buffers otherwise.
+ */
+static void sim_transfer(uint16        headerLength,
+                         const uint8 * headerBuffer,
+                         uint32        bodyLength,
+                         uint8       * bodyBuffer,
+                         bool          read)
+{
+#ifdef DECA_SPI_SIM_STAGING
+    uint32 length = headerLength + bodyLength;
+
+    if (length > sizeof(tx_buf)) {
+        printk("%s: %u bytes, longer than any register file\n", __func__, length);
+        return;
+    }
+    if (length > DECA_SPI_SIM_STAGING_LEN) {
+        sim_stats.over++;
+    }
+
+    if (read) {
+        memset(tx_buf, 0, length);
+        memcpy(tx_buf, headerBuffer, headerLength);
+        dw1000_model_transfer(tx_buf, headerLength, &rx_buf[headerLength], bodyLength);
+        memcpy(bodyBuffer, &rx_buf[headerLength], bodyLength);
+        sim_stats.copied += length + headerLength + bodyLength;
+    }
+    else {
+        memcpy(tx_buf, headerBuffer, headerLength);
+        memcpy(&tx_buf[headerLength], bodyBuffer, bodyLength);
+        dw1000_model_transfer(tx_buf, headerLength, &tx_buf[headerLength], bodyLength);
+        sim_stats.copied += length;
+    }
+#else
+    ARG_UNUSED(read);
+    dw1000_model_transfer(headerBuffer, headerLength, bodyBuffer, bodyLength);
+#endif
+}
+
+void deca_spi_sim_stats(deca_spi_sim_stats_t * stats)
+{
+    *stats = sim_stats;
+}
+
+/*
+ * Function: openspi()
+ *
+ * Low level abstract function to open and initialise access to the SPI device.
+ * returns 0 for success, or -1 for error
+ */
+int openspi(void)
+{
+    if (dw1000_model_init() != 0) {
+        printk("%s: DW1000 model initialisation failed.\n", __func__);
+        return -1;
+    }
+
+    return 0;
+}
+
+#define SPI_SLOW_FREQUENCY  (2000000)
+#define SPI_MAX_FREQUENCY   (20000000)      /* DW1000 limit */
+
+static uint32 spi_fast_frequency = 8000000;
+static uint32 spi_frequency = SPI_SLOW_FREQUENCY;
+
+void set_spi_speed_slow(void)
+{
+    spi_frequency = SPI_SLOW_FREQUENCY;
+    dw1000_model_set_spi_rate(spi_frequency);
+}
+
+void set_spi_speed_fast(void)
+{
+    spi_frequency = spi_fast_frequency;
+    dw1000_model_set_spi_rate(spi_frequency);
+}
+
+uint32 get_spi_speed(void)
+{
+    return spi_frequency;
+}
+
+/*
+ * Function: set_spi_speed_negotiate()
+ *
+ * The model never corrupts a transfer: the DW1000 limit is taken as is, and
+ * the throughput is the bus time of the rate without any overhead.
+ * returns the chosen rate in Hz
+ */
+uint32 set_spi_speed_negotiate(uint32 * bytes_per_sec)
+{
+    spi_fast_frequency = SPI_MAX_FREQUENCY;
+    set_spi_speed_fast();
+
+    printk("%s: SPI at %u Hz, %u bytes/s\n", __func__, spi_fast_frequency, spi_fast_frequency / 8);
+
+    if (bytes_per_sec) {
+        *bytes_per_sec = spi_fast_frequency / 8;
+    }
+    return spi_fast_frequency;
+}
+
+/*
+ * Function: closespi()
+ *
+ * Low level abstract function to close the the SPI device.
+ * returns 0 for success, or -1 for error
+ */
+int closespi(void)
+{
+    return 0;
+}
+
+/*
+ * Function: writetospi()
+ *
+ * Low level abstract function to write to the SPI
+ * Takes two separate byte buffers for write header and write data
+ * returns 0 for success
+ */
+int writetospi(uint16           headerLength,
+               const    uint8 * headerBuffer,
+               uint32           bodyLength,
+               const    uint8 * bodyBuffer)
+{
+    decaIrqStatus_t  stat;
+
+    stat = decamutexon();
+    dw1000_model_spi_call();
+
+    TRACE_START(start);
+    sim_transfer(headerLength, headerBuffer, bodyLength, (uint8 *)bodyBuffer, false);
+    TRACE_RECORD(headerBuffer, bodyLength, start);
+
+    decamutexoff(stat);
+
+    return 0;
+}
+
+/*
+ * Function: readfromspi()
+ *
+ * Low level abstract function to read from the SPI
+ * Takes two separate byte buffers for write header and read data
+ * returns 0 for success
+ */
+int readfromspi(uint16        headerLength,
+                const uint8 * headerBuffer,
+                uint32        readLength,
+                uint8       * readBuffer)
+{
+    decaIrqStatus_t  stat;
+
+    stat = decamutexon();
+    dw1000_model_spi_call();
+
+    TRACE_START(start);
+    sim_transfer(headerLength, headerBuffer, readLength, readBuffer, true);
+    TRACE_RECORD(headerBuffer, readLength, start);
+
+    decamutexoff(stat);
+
+    return 0;
+}
+
+/*
+ * Function: transferspi()
+ *
+ * Low level abstract function to issue a list of transactions back to back.
+ * The driver time (DW1000_SIM_SPI_CALL_US) is taken once for the list, as
+ * deca_spi.c keeps the bus locked for it.
+ * returns 0 for success
+ */
+int transferspi(const deca_spi_xfer_t * xfers,
+                uint16                  count)
+{
+    decaIrqStatus_t  stat;
+
+    stat = decamutexon();
+    dw1000_model_spi_call();
+
+    for (int i = 0; i < count; i++) {
+        TRACE_START(start);
+        sim_transfer(xfers[i].headerLength, xfers[i].headerBuffer,
+                     xfers[i].bodyLength, xfers[i].bodyBuffer, xfers[i].read);
+        TRACE_RECORD(xfers[i].headerBuffer, xfers[i].bodyLength, start);
+    }
+
+    decamutexoff(stat);
+
+    return 0;
+}
+
+/*
+ *****************************************************************************
+ *
+ *                        DW1000 asynchronous SPI section
+ *
+ *****************************************************************************
+ */
+
+static bool            async_pending;
+static decaIrqStatus_t async_stat;
+
+#ifdef DECA_SPI_TRACE
+static uint8           async_header [DECA_MAX_SPI_HEADER_LENGTH];
+static uint32          async_length;
+static uint32          async_start;
+static const char *    async_tag;
+
+/* The transfer is recorded on completion, with the tag of the thread which started it */
+#define TRACE_ASYNC_START(hdr, hlen, len) do { memcpy(async_header, hdr, hlen); async_length = (len); \
+                                               async_start = deca_spi_trace_time(); async_tag = deca_spi_trace_tag(); } while (0)
+#define TRACE_ASYNC_RECORD()        deca_spi_trace_record(async_header, async_length, async_start, async_tag)
+#else
+#define TRACE_ASYNC_START(hdr, hlen, len)
+#define TRACE_ASYNC_RECORD()
+#endif
+
+/*
+ * Function: start_async()
+ *
+ * Takes the DW1000 mutex and hands the transaction to the model, which
+ * answers it when spi_async_done() finds its bus time over (see
+ * dw1000_model_transfer_start()).
+ * returns 0 for success, or -1 for error
+ */
+static int start_async(uint16        headerLength,
+                       const uint8 * headerBuffer,
+                       uint32        bodyLength,
+                       uint8       * bodyBuffer)
+{
+    if (async_pending || headerLength > DECA_MAX_SPI_HEADER_LENGTH) {
+        return -1;
+    }
+
+    async_stat = decamutexon();
+    async_pending = true;
+    dw1000_model_spi_call();
+
+    TRACE_ASYNC_START(headerBuffer, headerLength, bodyLength);
+    dw1000_model_transfer_start(headerBuffer, headerLength, bodyBuffer, bodyLength);
+
+    return 0;
+}
+
+/*
+ * Function: readfromspi_async()
+ *
+ * Low level abstract function to start a read from the SPI without waiting
+ * for its completion. See spi_async_done()/spi_async_wait().
+ * returns 0 for success, or -1 for error
+ */
+int readfromspi_async(uint16        headerLength,
+                      const uint8 * headerBuffer,
+                      uint32        readLength,
+                      uint8       * readBuffer)
+{
+    return start_async(headerLength, headerBuffer, readLength, readBuffer);
+}
+
+/*
+ * Function: writetospi_async()
+ *
+ * Low level abstract function to start a write to the SPI without waiting
+ * for its completion. See spi_async_done()/spi_async_wait().
+ * returns 0 for success, or -1 for error
+ */
+int writetospi_async(uint16        headerLength,
+                     const uint8 * headerBuffer,
+                     uint32        bodyLength,
+                     const uint8 * bodyBuffer)
+{
+    return start_async(headerLength, headerBuffer, bodyLength, (uint8 *)bodyBuffer);
+}
+
+/*
+ * Function: spi_async_done()
+ *
+ * Checks whether the pending asynchronous transfer has completed, and if so
+ * releases the DW1000 mutex taken when it was started.
+ * returns 1 if no transfer is pending, 0 if it is still in flight
+ */
+int spi_async_done(void)
+{
+    if (!async_pending) {
+        return 1;
+    }
+
+    if (!dw1000_model_transfer_done(0)) {
+        return 0;
+    }
+
+    TRACE_ASYNC_RECORD();
+    async_pending = false;
+    decamutexoff(async_stat);
+
+    return 1;
+}
+
+/*
+ * Function: spi_async_wait()
+ *
+ * Blocks until the pending asynchronous transfer has completed.
+ * returns 0 for success
+ */
+int spi_async_wait(void)
+{
+    if (async_pending) {
+        dw1000_model_transfer_done(1);
+    }
+
+    spi_async_done();
+
+    return 0;
+}
@@ -0,0 +1,42 @@
+/*! ----------------------------------------------------------------------------
+ * @file    deca_spi_sim.h
+ * @brief   Counters of the native_posix SPI backend (deca_spi_sim.c)
+ *
+ * Built with -DDECA_SPI_SIM_STAGING, the backend moves every synchronous
+ * transaction through 255-byte global buffers as deca_spi.c did before its
+ * scatter-gather lists: the header and the body are copied into tx_buf, a
+ * read clears tx_buf first and copies the body out of rx_buf afterwards.
+ * Otherwise, as deca_spi.c now, the body goes straight between the model
+ * and the caller's buffer. The counters below compare the two.
+ */
+
+#ifndef _DECA_SPI_SIM_H_
+#define _DECA_SPI_SIM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "deca_types.h"
+
+#define DECA_SPI_SIM_STAGING_LEN        (255)                   // size of the staging buffers of deca_spi.c
+
+typedef struct {
+    uint32      copied;         /* bytes copied or cleared by the CPU       */
+    uint32      over;           /* transactions longer than the staging     */
+                                /* buffers, which deca_spi.c overflowed     */
+} deca_spi_sim_stats_t;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: deca_spi_sim_stats()
+ *
+ * Copies the counters of the synchronous transactions since the start, all
+ * 0 unless built with DECA_SPI_SIM_STAGING.
+ */
+void deca_spi_sim_stats(deca_spi_sim_stats_t * stats) ;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DECA_SPI_SIM_H_ */
@@ -0,0 +1,1057 @@
+/*! ----------------------------------------------------------------------------
+ * @file    dw1000_model.c
+ * @brief   Host-side model of the DW1000 register file and radio
+ *
+ * See dw1000_model.h for an overview and the environment variables.
+ *
+ * Time
+ *  All the event times are kept in picoseconds of CLOCK_MONOTONIC ("global"
+ *  time). The device's 40-bit system time is derived from it with the
+ *  crystal offset of the device and a random origin, so that two devices
+ *  never share a time base, exactly like two real DW1000s.
+ *
+ * Air
+ *  Every process binds one UDP port of the range DW1000_SIM_PORT ..
+ *  DW1000_SIM_PORT + SIM_NODES - 1 on 127.0.0.1 and sends each transmitted
+ *  frame to all the others, together with the global time at which its
+ *  RMARKER leaves the antenna, the sender position and the PHY settings.
+ *  The receiver adds the propagation delay and checks channel and preamble
+ *  code. Frames are sent when the TX is requested, i.e. before they are "on
+ *  air", so that the receiver knows about them in time.
+ */
+
+#include "dw1000_model.h"
+#include "deca_regs.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define SIM_NODES           (16)                /* devices on the simulated air          */
+#define SIM_PORT_DEFAULT    (47000)
+#define SIM_MAGIC           (0x44573130)        /* "DW10"                                */
+#define SIM_FRAMES          (16)                /* frames in flight towards this device  */
+#define SIM_FRAME_MAX       (1023)
+
+#define MASK40              (0xFFFFFFFFFFULL)
+#define HALF40              (0x8000000000ULL)
+#define TICK_PS             (1.0e12 / (499.2e6 * 128.0))   /* 15.65 ps              */
+#define UUS_PS              (512.0e12 / 499.2e6)           /* UWB microsecond, ps   */
+#define SPEED_OF_LIGHT      (299702547.0)                  /* in air, m/s           */
+
+#define TX_START_PS         (10000000LL)        /* 10 us from TXSTRT to first symbol     */
+#define TX_POWERUP_TICKS    (300000ULL)         /* ~4.7 us, TX power up before preamble  */
+#define ANTD_TICKS          (16436)             /* actual antenna delay of the device    */
+
+/* Frame as sent on the simulated air */
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint32_t sender;                /* UDP port of the sender                    */
+    uint32_t id;                    /* per-sender frame counter                  */
+    uint8_t  cancel;                /* 1: cancels frame 'id' (TRXOFF before TX)  */
+    uint8_t  chan;
+    uint8_t  pcode;
+    uint8_t  ranging;
+    uint8_t  rate;                  /* TX_FCTRL TXBR field                       */
+    uint8_t  prf;                   /* TX_FCTRL TXPRF field                      */
+    uint16_t plen;                  /* preamble length in symbols                */
+    int64_t  rmarker;               /* global time of the RMARKER at the antenna */
+    int64_t  pre;                   /* preamble + SFD duration                   */
+    int64_t  post;                  /* PHR + data duration                       */
+    float    pos[3];
+    float    ppm;
+    uint16_t len;                   /* including the 2 bytes of FCS              */
+    uint8_t  data[SIM_FRAME_MAX];
+} air_msg_t;
+
+typedef struct
+{
+    int      used;
+    uint32_t sender;
+    uint32_t id;
+    int64_t  start;                 /* global time of the first preamble symbol  */
+    int64_t  rmarker;               /* global time of the RMARKER at the antenna */
+    int64_t  end;                   /* global time of the end of the frame       */
+    double   dist;
+    float    ppm;
+    uint8_t  chan;
+    uint8_t  pcode;
+    uint8_t  ranging;
+    uint8_t  rate;
+    uint8_t  prf;
+    uint16_t plen;
+    uint16_t len;
+    uint8_t  data[SIM_FRAME_MAX];
+} sim_frame_t;
+
+enum { RX_OFF, RX_PENDING, RX_ON };
+
+static struct
+{
+    int         ready;
+    int         sock;
+    uint16_t    port_base;
+    uint16_t    port;
+
+    uint8_t    *reg[64];            /* register files                            */
+
+    double      pos[3];
+    double      ppm;
+    long double scale;              /* device ticks per global ps                */
+    uint64_t    origin;             /* device time at global time 0              */
+    uint64_t    eui;
+    double      loss;
+    double      noise_ps;
+    int         spi_time;
+    uint32_t    spi_hz;
+    double      spi_call_us;
+
+    int         sleeping;
+
+    int         tx_active;
+    int64_t     tx_rmarker;
+    int64_t     tx_end;
+    int         tx_w4r;
+    uint32_t    tx_id;
+
+    int         rx_state;
+    int64_t     rx_on;
+    int         rx_to_en;
+    int64_t     rx_to;
+
+    sim_frame_t frames[SIM_FRAMES];
+
+    /* Transaction in flight, see dw1000_model_transfer_start() */
+    int         xfer_pending;
+    uint8_t     xfer_header[3];
+    uint16_t    xfer_headerLength;
+    uint8_t    *xfer_body;
+    uint32_t    xfer_bodyLength;
+    int64_t     xfer_end;
+
+    /* Statistics, printed at exit */
+    uint64_t    spi_calls;
+    uint64_t    spi_count;
+    uint64_t    spi_bytes;
+    double      spi_busy_us;
+    uint32_t    tx_count;
+    uint32_t    tx_late;
+    uint32_t    rx_count;
+    uint32_t    rx_missed;
+    uint32_t    rx_timeout;
+} dw;
+
+/*
+ *****************************************************************************
+ *
+ *                              Helpers
+ *
+ *****************************************************************************
+ */
+
+static int64_t now_ps(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000000LL + (int64_t)ts.tv_nsec * 1000LL;
+}
+
+/* Device system time (40-bit, in 15.65 ps units) at a global time */
+static uint64_t local_time(int64_t t)
+{
+    return ((uint64_t)((long double)t * dw.scale) + dw.origin) & MASK40;
+}
+
+/* Global time at which the device time reaches 'ticks', seen from 'now' */
+static int64_t global_time(uint64_t ticks, int64_t now, uint64_t * delta)
+{
+    *delta = (ticks - local_time(now)) & MASK40;
+    return now + (int64_t)((long double)*delta / dw.scale);
+}
+
+static uint16_t reg_size(uint8_t id)
+{
+    switch (id) {
+    case TX_BUFFER_ID:
+    case RX_BUFFER_ID:  return 1024;
+    case ACC_MEM_ID:    return 4064;
+    case LDE_IF_ID:     return 0x2808;
+    default:            return 64;
+    }
+}
+
+static uint64_t reg_get(uint8_t id, uint16_t offset, int len)
+{
+    uint64_t value = 0;
+
+    for (int i = len - 1; i >= 0; i--) {
+        value = (value << 8) | dw.reg[id][offset + i];
+    }
+    return value;
+}
+
+static void reg_set(uint8_t id, uint16_t offset, int len, uint64_t value)
+{
+    for (int i = 0; i < len; i++) {
+        dw.reg[id][offset + i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static void status_set(uint64_t bits)
+{
+    reg_set(SYS_STATUS_ID, 0, 5, reg_get(SYS_STATUS_ID, 0, 5) | bits);
+}
+
+static double gauss(void)
+{
+    double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+static uint16_t preamble_symbols(uint8_t psr_pe)
+{
+    switch (psr_pe << TX_FCTRL_TXPSR_SHFT) {
+    case TX_FCTRL_TXPSR_PE_64:   return 64;
+    case TX_FCTRL_TXPSR_PE_128:  return 128;
+    case TX_FCTRL_TXPSR_PE_256:  return 256;
+    case TX_FCTRL_TXPSR_PE_512:  return 512;
+    case TX_FCTRL_TXPSR_PE_1024: return 1024;
+    case TX_FCTRL_TXPSR_PE_1536: return 1536;
+    case TX_FCTRL_TXPSR_PE_2048: return 2048;
+    case TX_FCTRL_TXPSR_PE_4096: return 4096;
+    default:                     return 128;
+    }
+}
+
+/* Frame durations in ps: preamble + SFD (up to the RMARKER), PHR + data */
+static void frame_durations(uint8_t rate, uint8_t prf, uint16_t plen,
+                            uint16_t len, int64_t * pre, int64_t * post)
+{
+    double symbol = (prf == (TX_FCTRL_TXPRF_64M >> TX_FCTRL_TXPRF_SHFT)) ? 1017.63e3 : 993.59e3;
+    double sfd    = (rate == 0) ? 64 : 8;
+    double phr    = (rate == 0) ? 21 * 8205.13e3 : 21 * 1025.64e3;
+    double bit    = (rate == 0) ? 8205.13e3 : (rate == 1) ? 1025.64e3 : 128.21e3;
+    double bits   = len * 8.0 + 48.0 * ((len * 8 + 329) / 330); /* Reed-Solomon parity */
+
+    *pre  = (int64_t)((plen + sfd) * symbol);
+    *post = (int64_t)(phr + bits * bit);
+}
+
+/*
+ *****************************************************************************
+ *
+ *                              Reset
+ *
+ *****************************************************************************
+ */
+
+static void rxtx_off(void)
+{
+    dw.tx_active = 0;
+    dw.rx_state = RX_OFF;
+}
+
+static void reset_registers(void)
+{
+    for (int id = 0; id < 64; id++) {
+        memset(dw.reg[id], 0, reg_size(id));
+    }
+
+    reg_set(DEV_ID_ID,     0, 4, 0xDECA0130);
+    reg_set(EUI_64_ID,     0, 8, dw.eui);
+    reg_set(PANADR_ID,     0, 4, 0xFFFFFFFF);
+    reg_set(SYS_CFG_ID,    0, 4, 0x00001200);
+    reg_set(TX_FCTRL_ID,   0, 5, 0x0015400C);
+    reg_set(SYS_STATUS_ID, 0, 5, SYS_STATUS_CPLOCK);
+    reg_set(CHAN_CTRL_ID,  0, 4, 0x21040055);
+    reg_set(PMSC_ID,       0, 4, 0xF0300200);
+    reg_set(PMSC_ID,       4, 4, 0x81020740);
+
+    rxtx_off();
+    dw.sleeping = 0;
+}
+
+static void report(void)
+{
+    fprintf(stderr,
+            "dw1000 sim [port %u]: spi %llu calls, %llu transactions, %llu bytes, %.0f us bus time; "
+            "tx %u frames (%u late); rx %u frames, %u missed, %u timeouts\n",
+            dw.port, (unsigned long long)dw.spi_calls, (unsigned long long)dw.spi_count,
+            (unsigned long long)dw.spi_bytes, dw.spi_busy_us,
+            dw.tx_count, dw.tx_late, dw.rx_count, dw.rx_missed, dw.rx_timeout);
+}
+
+int dw1000_model_init(void)
+{
+    struct sockaddr_in addr;
+    const char * env;
+
+    if (dw.ready) {
+        return 0;
+    }
+
+    srand((unsigned int)(getpid() ^ now_ps()));
+
+    env = getenv("DW1000_SIM_PORT");
+    dw.port_base = env ? (uint16_t)atoi(env) : SIM_PORT_DEFAULT;
+
+    dw.sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (dw.sock < 0) {
+        perror("dw1000 sim: socket");
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    for (int i = 0; i < SIM_NODES; i++) {
+        addr.sin_port = htons(dw.port_base + i);
+        if (bind(dw.sock, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+            dw.port = dw.port_base + i;
+            break;
+        }
+    }
+    if (dw.port == 0) {
+        fprintf(stderr, "dw1000 sim: no free port in %u..%u\n",
+                dw.port_base, dw.port_base + SIM_NODES - 1);
+        close(dw.sock);
+        return -1;
+    }
+    fcntl(dw.sock, F_SETFL, fcntl(dw.sock, F_GETFL) | O_NONBLOCK);
+
+    env = getenv("DW1000_SIM_POS");
+    if (env) {
+        sscanf(env, "%lf,%lf,%lf", &dw.pos[0], &dw.pos[1], &dw.pos[2]);
+    }
+    env = getenv("DW1000_SIM_PPM");
+    dw.ppm = env ? atof(env) : (rand() / (double)RAND_MAX - 0.5) * 20.0;
+    env = getenv("DW1000_SIM_EUI");
+    dw.eui = env ? strtoull(env, NULL, 16) : (0xDECA000000000000ULL | dw.port);
+    env = getenv("DW1000_SIM_LOSS");
+    dw.loss = env ? atof(env) : 0.0;
+    env = getenv("DW1000_SIM_NOISE_PS");
+    dw.noise_ps = env ? atof(env) : 0.0;
+    env = getenv("DW1000_SIM_SPI_TIME");
+    dw.spi_time = env ? atoi(env) : 0;
+    env = getenv("DW1000_SIM_SPI_CALL_US");
+    dw.spi_call_us = env ? atof(env) : 0.0;
+
+    dw.scale  = (1.0L + dw.ppm * 1.0e-6L) / (long double)TICK_PS;
+    dw.origin = (((uint64_t)rand() << 20) ^ (uint64_t)rand()) & MASK40;
+    dw.spi_hz = 2000000;
+
+    for (int id = 0; id < 64; id++) {
+        dw.reg[id] = calloc(1, reg_size(id));
+        if (dw.reg[id] == NULL) {
+            return -1;
+        }
+    }
+
+    reset_registers();
+
+    fprintf(stderr, "dw1000 sim [port %u]: eui %016llx, pos %.2f,%.2f,%.2f m, %+.2f ppm\n",
+            dw.port, (unsigned long long)dw.eui,
+            dw.pos[0], dw.pos[1], dw.pos[2], dw.ppm);
+    atexit(report);
+
+    dw.ready = 1;
+    return 0;
+}
+
+void dw1000_model_reset(void)
+{
+    if (dw.ready) {
+        reset_registers();
+    }
+}
+
+void dw1000_model_wakeup(void)
+{
+    if (dw.sleeping) {
+        /* The configuration comes back from the AON memory */
+        dw.sleeping = 0;
+        reg_set(SYS_STATUS_ID, 0, 5, SYS_STATUS_CPLOCK | SYS_STATUS_SLP2INIT);
+    }
+}
+
+void dw1000_model_set_spi_rate(uint32_t hz)
+{
+    dw.spi_hz = hz;
+}
+
+/*
+ *****************************************************************************
+ *
+ *                              Air
+ *
+ *****************************************************************************
+ */
+
+static void air_send(const air_msg_t * msg, size_t size)
+{
+    struct sockaddr_in addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    for (int i = 0; i < SIM_NODES; i++) {
+        if (dw.port_base + i != dw.port) {
+            addr.sin_port = htons(dw.port_base + i);
+            sendto(dw.sock, msg, size, 0, (struct sockaddr *)&addr, sizeof(addr));
+        }
+    }
+}
+
+static void air_receive(void)
+{
+    air_msg_t msg;
+    ssize_t   size;
+
+    while ((size = recv(dw.sock, &msg, sizeof(msg), 0)) > 0) {
+        sim_frame_t * frame = NULL;
+
+        if ((size < (ssize_t)offsetof(air_msg_t, data)) || (msg.magic != SIM_MAGIC)) {
+            continue;
+        }
+
+        if (msg.cancel) {
+            for (int i = 0; i < SIM_FRAMES; i++) {
+                if (dw.frames[i].used && (dw.frames[i].sender == msg.sender)
+                    && (dw.frames[i].id == msg.id)) {
+                    dw.frames[i].used = 0;
+                }
+            }
+            continue;
+        }
+
+        if ((dw.loss > 0.0) && ((rand() / (double)RAND_MAX) < dw.loss)) {
+            continue;
+        }
+
+        for (int i = 0; i < SIM_FRAMES; i++) {
+            if (!dw.frames[i].used) {
+                frame = &dw.frames[i];
+                break;
+            }
+        }
+        if (frame == NULL) {
+            dw.rx_missed++;
+            continue;
+        }
+
+        frame->dist = sqrt(pow(msg.pos[0] - dw.pos[0], 2) +
+                           pow(msg.pos[1] - dw.pos[1], 2) +
+                           pow(msg.pos[2] - dw.pos[2], 2));
+        frame->rmarker = msg.rmarker + (int64_t)(frame->dist / SPEED_OF_LIGHT * 1.0e12);
+        frame->start   = frame->rmarker - msg.pre;
+        frame->end     = frame->rmarker + msg.post;
+        frame->sender  = msg.sender;
+        frame->id      = msg.id;
+        frame->ppm     = msg.ppm;
+        frame->chan    = msg.chan;
+        frame->pcode   = msg.pcode;
+        frame->ranging = msg.ranging;
+        frame->rate    = msg.rate;
+        frame->prf     = msg.prf;
+        frame->plen    = msg.plen;
+        frame->len     = (msg.len <= SIM_FRAME_MAX) ? msg.len : SIM_FRAME_MAX;
+        memcpy(frame->data, msg.data, frame->len);
+        frame->used    = 1;
+    }
+}
+
+/*
+ *****************************************************************************
+ *
+ *                              Radio
+ *
+ *****************************************************************************
+ */
+
+static void tx_start(uint32_t cmd, int64_t now)
+{
+    uint64_t  fctrl  = reg_get(TX_FCTRL_ID, 0, 5);
+    uint16_t  len    = fctrl & TX_FCTRL_FLE_MASK;
+    uint16_t  offset = (fctrl & TX_FCTRL_TXBOFFS_MASK) >> TX_FCTRL_TXBOFFS_SHFT;
+    uint32_t  chan   = (uint32_t)reg_get(CHAN_CTRL_ID, 0, 4);
+    uint64_t  raw;
+    uint64_t  delta;
+    int64_t   t_raw;
+    int64_t   pre;
+    int64_t   post;
+    air_msg_t msg;
+
+    memset(&msg, 0, offsetof(air_msg_t, data));
+    msg.rate  = (fctrl & TX_FCTRL_TXBR_MASK) >> TX_FCTRL_TXBR_SHFT;
+    msg.prf   = (fctrl & TX_FCTRL_TXPRF_MASK) >> TX_FCTRL_TXPRF_SHFT;
+    msg.plen  = preamble_symbols((fctrl & TX_FCTRL_TXPSR_PE_MASK) >> TX_FCTRL_TXPSR_SHFT);
+    frame_durations(msg.rate, msg.prf, msg.plen, len, &pre, &post);
+    msg.pre   = pre;
+    msg.post  = post;
+
+    if (cmd & SYS_CTRL_TXDLYS) {
+        raw = reg_get(DX_TIME_ID, 0, 5) & ~0x1FFULL;
+        t_raw = global_time(raw, now, &delta);
+        if (delta >= HALF40) {
+            status_set(SYS_STATUS_HPDWARN);
+            dw.tx_late++;
+            return;
+        }
+        if (delta < TX_POWERUP_TICKS + (uint64_t)(pre * dw.scale)) {
+            status_set(SYS_STATUS_TXPUTE);
+            dw.tx_late++;
+            return;
+        }
+    }
+    else {
+        raw = local_time(now + TX_START_PS + pre) & ~0x1FFULL;
+        t_raw = global_time(raw, now, &delta);
+    }
+
+    /* TX_STAMP is the raw time adjusted by the programmed antenna delay */
+    reg_set(TX_TIME_ID, 0, 5, (raw + reg_get(TX_ANTD_ID, 0, 2)) & MASK40);
+    reg_set(TX_TIME_ID, TX_TIME_TX_RAWST_OFFSET, 5, raw);
+
+    dw.rx_state   = RX_OFF;
+    dw.tx_active  = 1;
+    dw.tx_w4r     = (cmd & SYS_CTRL_WAIT4RESP) ? 1 : 0;
+    dw.tx_rmarker = t_raw + (int64_t)(ANTD_TICKS / dw.scale);
+    dw.tx_end     = dw.tx_rmarker + post;
+    dw.tx_id++;
+    dw.tx_count++;
+
+    msg.magic   = SIM_MAGIC;
+    msg.sender  = dw.port;
+    msg.id      = dw.tx_id;
+    msg.chan    = chan & CHAN_CTRL_TX_CHAN_MASK;
+    msg.pcode   = (chan & CHAN_CTRL_TX_PCOD_MASK) >> CHAN_CTRL_TX_PCOD_SHIFT;
+    msg.ranging = (fctrl & TX_FCTRL_TR) ? 1 : 0;
+    msg.rmarker = dw.tx_rmarker;
+    msg.pos[0]  = dw.pos[0];
+    msg.pos[1]  = dw.pos[1];
+    msg.pos[2]  = dw.pos[2];
+    msg.ppm     = dw.ppm;
+    msg.len     = len;
+    if (offset + len > reg_size(TX_BUFFER_ID)) {
+        len = reg_size(TX_BUFFER_ID) - offset;
+    }
+    memcpy(msg.data, &dw.reg[TX_BUFFER_ID][offset], len);
+
+    air_send(&msg, offsetof(air_msg_t, data) + len);
+}
+
+static void tx_cancel(int64_t now)
+{
+    if (dw.tx_active && (dw.tx_rmarker > now)) {
+        air_msg_t msg;
+
+        memset(&msg, 0, offsetof(air_msg_t, data));
+        msg.magic  = SIM_MAGIC;
+        msg.sender = dw.port;
+        msg.id     = dw.tx_id;
+        msg.cancel = 1;
+        air_send(&msg, offsetof(air_msg_t, data));
+    }
+    dw.tx_active = 0;
+}
+
+static void rx_start(uint32_t cmd, int64_t now)
+{
+    if (cmd & SYS_CTRL_RXDLYE) {
+        uint64_t delta;
+        int64_t  t_on = global_time(reg_get(DX_TIME_ID, 0, 5) & ~0x1FFULL, now, &delta);
+
+        if (delta >= HALF40) {
+            status_set(SYS_STATUS_HPDWARN);
+            return;
+        }
+        dw.rx_on = t_on;
+    }
+    else {
+        dw.rx_on = now;
+    }
+    dw.rx_state = RX_PENDING;
+}
+
+static int rx_filter(const uint8_t * data, uint16_t len)
+{
+    uint32_t cfg = (uint32_t)reg_get(SYS_CFG_ID, 0, 4);
+    uint16_t fc;
+    uint8_t  type;
+    uint32_t allow;
+    int      mode;
+
+    if (!(cfg & SYS_CFG_FFE) || (len < 3)) {
+        return 1;
+    }
+
+    fc = data[0] | (data[1] << 8);
+    type = fc & 0x07;
+
+    switch (type) {
+    case 0:  allow = SYS_CFG_FFAB; break;
+    case 1:  allow = SYS_CFG_FFAD; break;
+    case 2:  allow = SYS_CFG_FFAA; break;
+    case 3:  allow = SYS_CFG_FFAM; break;
+    case 4:  allow = SYS_CFG_FFA4 | SYS_CFG_FFAR; break;
+    case 5:  allow = SYS_CFG_FFA5 | SYS_CFG_FFAR; break;
+    default: allow = SYS_CFG_FFAR; break;
+    }
+    if (!(cfg & allow)) {
+        return 0;
+    }
+    if (type >= 4) {
+        return 1;                   /* blinks etc. carry no 802.15.4 addressing */
+    }
+
+    mode = (fc >> 10) & 0x03;
+    if (mode == 0) {
+        return (cfg & SYS_CFG_FFBC) ? 1 : 0;
+    }
+    if (len < 5) {
+        return 0;
+    }
+
+    uint16_t pan = data[3] | (data[4] << 8);
+    uint32_t panadr = (uint32_t)reg_get(PANADR_ID, 0, 4);
+
+    if ((pan != 0xFFFF) && (pan != (panadr >> 16))) {
+        return 0;
+    }
+    if (mode == 2) {
+        uint16_t dest = (len >= 7) ? (data[5] | (data[6] << 8)) : 0;
+
+        return (dest == 0xFFFF) || (dest == (panadr & 0xFFFF));
+    }
+    if (mode == 3) {
+        uint64_t dest = 0;
+
+        if (len < 13) {
+            return 0;
+        }
+        for (int i = 7; i >= 0; i--) {
+            dest = (dest << 8) | data[5 + i];
+        }
+        return dest == reg_get(EUI_64_ID, 0, 8);
+    }
+    return 0;
+}
+
+static void rx_deliver(sim_frame_t * frame)
+{
+    static const double carrier_hz[8] = { 0, 3494.4e6, 3993.6e6, 4492.8e6,
+                                          3993.6e6, 6489.6e6, 0, 6489.6e6 };
+    uint32_t chan = (uint32_t)reg_get(CHAN_CTRL_ID, 0, 4);
+    uint64_t raw;
+    uint64_t stamp;
+    uint32_t finfo;
+    uint16_t ampl;
+    double   mult;
+    int32_t  ci;
+
+    if ((frame->chan != ((chan & CHAN_CTRL_RX_CHAN_MASK) >> CHAN_CTRL_RX_CHAN_SHIFT))
+        || (frame->pcode != ((chan & CHAN_CTRL_RX_PCOD_MASK) >> CHAN_CTRL_RX_PCOD_SHIFT))) {
+        return;                     /* not heard at all */
+    }
+    if (!rx_filter(frame->data, frame->len)) {
+        status_set(SYS_STATUS_AFFREJ);
+        return;                     /* receiver stays on */
+    }
+
+    memcpy(dw.reg[RX_BUFFER_ID], frame->data, frame->len);
+
+    finfo = (frame->len & (RX_FINFO_RXFLEN_MASK | RX_FINFO_RXFLE_MASK))
+          | ((uint32_t)frame->rate << 13)
+          | ((uint32_t)frame->ranging << RX_FINFO_RNG_SHIFT)
+          | ((uint32_t)frame->prf << 16)
+          | ((uint32_t)(frame->plen - 8) << RX_FINFO_RXPACC_SHIFT);
+    reg_set(RX_FINFO_ID, 0, 4, finfo);
+
+    /* The raw RX time includes the antenna delay, which the programmed RX antenna delay removes */
+    raw = (local_time(frame->rmarker + (int64_t)(dw.noise_ps * gauss())) + ANTD_TICKS) & MASK40;
+    stamp = (raw - reg_get(LDE_IF_ID, LDE_RXANTD_OFFSET, 2)) & MASK40;
+    reg_set(RX_TIME_ID, 0, 5, stamp);
+    reg_set(RX_TIME_ID, RX_TIME_FP_RAWST_OFFSET, 5, raw);
+
+    /* Plausible diagnostics, the amplitudes decrease with the distance */
+    ampl = (uint16_t)(12000.0 / ((frame->dist > 1.0) ? frame->dist : 1.0));
+    reg_set(RX_TIME_ID, RX_TIME_FP_INDEX_OFFSET, 2, 746 << 6);
+    reg_set(RX_TIME_ID, RX_TIME_FP_AMPL1_OFFSET, 2, ampl);
+    reg_set(RX_FQUAL_ID, 0, 2, 40);
+    reg_set(RX_FQUAL_ID, 2, 2, ampl);
+    reg_set(RX_FQUAL_ID, 4, 2, ampl);
+    reg_set(RX_FQUAL_ID, 6, 2, ampl + 2000);
+
+    /* Carrier integrator: positive when the local clock is faster than the remote one */
+    mult = (frame->rate == 0) ? (998.4e6 / 2.0 / 8192.0 / 131072.0) : (998.4e6 / 2.0 / 1024.0 / 131072.0);
+    ci = (int32_t)lround((dw.ppm - frame->ppm) * 1.0e-6 * carrier_hz[frame->chan & 7] / mult);
+    reg_set(DRX_CONF_ID, DRX_CARRIER_INT_OFFSET, DRX_CARRIER_INT_LEN, (uint32_t)ci & DRX_CARRIER_INT_MASK);
+
+    status_set(SYS_STATUS_RXPRD | SYS_STATUS_RXSFDD | SYS_STATUS_LDEDONE |
+               SYS_STATUS_RXPHD | SYS_STATUS_RXDFR | SYS_STATUS_RXFCG);
+    dw.rx_state = RX_OFF;
+    dw.rx_count++;
+}
+
+/* Applies, in time order, all the events up to 'now' */
+static void advance(int64_t now)
+{
+    air_receive();
+
+    for (;;) {
+        enum { EV_NONE, EV_TX, EV_RXON, EV_RXTO, EV_RXFRAME } ev = EV_NONE;
+        int64_t       t = INT64_MAX;
+        sim_frame_t * frame = NULL;
+
+        if (dw.tx_active && (dw.tx_end < t)) {
+            ev = EV_TX;
+            t = dw.tx_end;
+        }
+        if ((dw.rx_state == RX_PENDING) && (dw.rx_on < t)) {
+            ev = EV_RXON;
+            t = dw.rx_on;
+        }
+        if (dw.rx_state == RX_ON) {
+            if (dw.rx_to_en && (dw.rx_to < t)) {
+                ev = EV_RXTO;
+                t = dw.rx_to;
+            }
+            for (int i = 0; i < SIM_FRAMES; i++) {
+                sim_frame_t * f = &dw.frames[i];
+
+                if (!f->used) {
+                    continue;
+                }
+                if (f->start < dw.rx_on) {
+                    /* Started before the receiver was on: the preamble is missed */
+                    f->used = 0;
+                    dw.rx_missed++;
+                    continue;
+                }
+                if (f->end < t) {
+                    ev = EV_RXFRAME;
+                    t = f->end;
+                    frame = f;
+                }
+            }
+        }
+
+        if ((ev == EV_NONE) || (t > now)) {
+            break;
+        }
+
+        switch (ev) {
+        case EV_TX:
+            dw.tx_active = 0;
+            status_set(SYS_STATUS_TXFRB | SYS_STATUS_TXPRS | SYS_STATUS_TXPHS | SYS_STATUS_TXFRS);
+            if (dw.tx_w4r) {
+                dw.rx_state = RX_PENDING;
+                dw.rx_on = dw.tx_end + (int64_t)((reg_get(ACK_RESP_T_ID, 0, 4) & ACK_RESP_T_W4R_TIM_MASK) * UUS_PS);
+            }
+            break;
+        case EV_RXON:
+            dw.rx_state = RX_ON;
+            dw.rx_to_en = (reg_get(SYS_CFG_ID, 0, 4) & SYS_CFG_RXWTOE) ? 1 : 0;
+            dw.rx_to = dw.rx_on + (int64_t)(reg_get(RX_FWTO_ID, 0, 2) * UUS_PS);
+            break;
+        case EV_RXTO:
+            dw.rx_state = RX_OFF;
+            dw.rx_timeout++;
+            status_set(SYS_STATUS_RXRFTO);
+            break;
+        case EV_RXFRAME:
+            frame->used = 0;
+            rx_deliver(frame);
+            break;
+        default:
+            break;
+        }
+    }
+
+    /* Forget the frames the receiver will never consider */
+    for (int i = 0; i < SIM_FRAMES; i++) {
+        if (dw.frames[i].used && (dw.frames[i].end < now - 1000000000000LL)) {
+            dw.frames[i].used = 0;
+        }
+    }
+}
+
+/*
+ *****************************************************************************
+ *
+ *                              SPI
+ *
+ *****************************************************************************
+ */
+
+static void write_sys_ctrl(uint32_t cmd, int64_t now)
+{
+    if (cmd & SYS_CTRL_TRXOFF) {
+        /* TRXOFF wins: dwt_configure() sets TXSTRT | TRXOFF to initialise the SFD */
+        tx_cancel(now);
+        dw.rx_state = RX_OFF;
+        return;
+    }
+    if (cmd & SYS_CTRL_TXSTRT) {
+        tx_start(cmd, now);
+    }
+    else if (cmd & SYS_CTRL_RXENAB) {
+        rx_start(cmd, now);
+    }
+}
+
+static void write_register(uint8_t id, uint16_t index, const uint8_t * body, uint32_t length, int64_t now)
+{
+    uint16_t size = reg_size(id);
+
+    if (index >= size) {
+        return;
+    }
+    if (index + length > size) {
+        length = size - index;
+    }
+
+    switch (id) {
+    case SYS_STATUS_ID:
+        for (uint32_t i = 0; i < length; i++) {
+            dw.reg[id][index + i] &= ~body[i];      /* write 1 to clear */
+        }
+        return;
+
+    case SYS_CTRL_ID: {
+        uint32_t cmd = 0;
+
+        for (uint32_t i = 0; (i < length) && (index + i < 4); i++) {
+            cmd |= (uint32_t)body[i] << (8 * (index + i));
+        }
+        write_sys_ctrl(cmd, now);
+        return;                                     /* command bits clear themselves */
+    }
+
+    case SYS_TIME_ID:
+    case DEV_ID_ID:
+        return;                                     /* read only */
+
+    default:
+        break;
+    }
+
+    memcpy(&dw.reg[id][index], body, length);
+
+    if ((id == PMSC_ID) && (index <= PMSC_CTRL0_SOFTRESET_OFFSET)
+        && (index + length > PMSC_CTRL0_SOFTRESET_OFFSET)) {
+        uint8_t soft = dw.reg[PMSC_ID][PMSC_CTRL0_SOFTRESET_OFFSET];
+
+        if (soft == PMSC_CTRL0_RESET_ALL) {
+            reset_registers();
+            dw.reg[PMSC_ID][PMSC_CTRL0_SOFTRESET_OFFSET] = soft;
+        }
+        else if (soft == PMSC_CTRL0_RESET_RX) {
+            dw.rx_state = RX_OFF;
+        }
+    }
+
+    if ((id == AON_ID) && (index <= AON_CTRL_OFFSET) && (index + length > AON_CTRL_OFFSET)
+        && (dw.reg[AON_ID][AON_CTRL_OFFSET] & AON_CTRL_SAVE)
+        && (dw.reg[AON_ID][AON_CFG0_OFFSET] & AON_CFG0_SLEEP_EN)) {
+        tx_cancel(now);
+        rxtx_off();
+        dw.sleeping = 1;
+    }
+}
+
+static void read_register(uint8_t id, uint16_t index, uint8_t * body, uint32_t length, int64_t now)
+{
+    uint16_t size = reg_size(id);
+
+    memset(body, 0, length);
+    if (index >= size) {
+        return;
+    }
+    if (index + length > size) {
+        length = size - index;
+    }
+
+    if (id == SYS_TIME_ID) {
+        reg_set(SYS_TIME_ID, 0, 5, local_time(now) & ~0x1FFULL);
+    }
+    if (id == SYS_STATUS_ID) {
+        uint32_t status = (uint32_t)reg_get(SYS_STATUS_ID, 0, 4) & ~SYS_STATUS_IRQS;
+
+        if (status & (uint32_t)reg_get(SYS_MASK_ID, 0, 4)) {
+            status |= SYS_STATUS_IRQS;
+        }
+        reg_set(SYS_STATUS_ID, 0, 4, status);
+    }
+
+    memcpy(body, &dw.reg[id][index], length);
+}
+
+/* Counts a transaction, returns its bus time (ps) */
+static int64_t spi_account(uint16_t headerLength, uint32_t bodyLength)
+{
+    double busy_us = (headerLength + bodyLength) * 8.0 * 1.0e6 / dw.spi_hz;
+
+    dw.spi_count++;
+    dw.spi_bytes += headerLength + bodyLength;
+    dw.spi_busy_us += busy_us;
+
+    return (int64_t)(busy_us * 1.0e6);
+}
+
+uint64_t dw1000_model_host_ns(void)
+{
+    return (uint64_t)(now_ps() / 1000);
+}
+
+void dw1000_model_spi_call(void)
+{
+    if (!dw.ready) {
+        return;
+    }
+
+    /* The driver runs before the transactions, once the bus is free */
+    dw1000_model_transfer_done(1);
+
+    dw.spi_calls++;
+    dw.spi_busy_us += dw.spi_call_us;
+
+    if (dw.spi_time) {
+        int64_t end = now_ps() + (int64_t)(dw.spi_call_us * 1.0e6);
+
+        while (now_ps() < end) {
+        }
+    }
+}
+
+void dw1000_model_spi_stats(dw1000_model_spi_stats_t * stats)
+{
+    stats->calls = dw.spi_calls;
+    stats->count = dw.spi_count;
+    stats->bytes = dw.spi_bytes;
+    stats->busy_us = dw.spi_busy_us;
+}
+
+/* Answers a transaction, at its end */
+static void spi_execute(const uint8_t * header, uint16_t headerLength,
+                        uint8_t * body, uint32_t bodyLength)
+{
+    int64_t  now;
+    uint8_t  id = header[0] & 0x3F;
+    uint16_t index = 0;
+
+    if (header[0] & 0x40) {
+        index = header[1] & 0x7F;
+        if ((header[1] & 0x80) && (headerLength > 2)) {
+            index |= (uint16_t)header[2] << 7;
+        }
+    }
+
+    now = now_ps();
+    advance(now);
+
+    if (dw.sleeping) {
+        /* Asleep: nothing answers, but holding CS low wakes the device up */
+        if (!(header[0] & 0x80)) {
+            memset(body, 0, bodyLength);
+        }
+        dw1000_model_wakeup();
+        return;
+    }
+
+    if (header[0] & 0x80) {
+        write_register(id, index, body, bodyLength, now);
+    }
+    else {
+        read_register(id, index, body, bodyLength, now);
+    }
+}
+
+void dw1000_model_transfer(const uint8_t * header, uint16_t headerLength,
+                           uint8_t * body, uint32_t bodyLength)
+{
+    int64_t busy_ps;
+
+    if (!dw.ready) {
+        return;
+    }
+
+    /* The bus is taken until the transaction in flight ends */
+    dw1000_model_transfer_done(1);
+
+    busy_ps = spi_account(headerLength, bodyLength);
+    if (dw.spi_time) {
+        int64_t end = now_ps() + busy_ps;
+
+        while (now_ps() < end) {
+        }
+    }
+
+    spi_execute(header, headerLength, body, bodyLength);
+}
+
+void dw1000_model_transfer_start(const uint8_t * header, uint16_t headerLength,
+                                 uint8_t * body, uint32_t bodyLength)
+{
+    int64_t busy_ps;
+
+    if (!dw.ready || (headerLength > sizeof(dw.xfer_header))) {
+        return;
+    }
+
+    dw1000_model_transfer_done(1);
+
+    busy_ps = spi_account(headerLength, bodyLength);
+
+    memcpy(dw.xfer_header, header, headerLength);
+    dw.xfer_headerLength = headerLength;
+    dw.xfer_body = body;
+    dw.xfer_bodyLength = bodyLength;
+    dw.xfer_end = now_ps() + (dw.spi_time ? busy_ps : 0);
+    dw.xfer_pending = 1;
+}
+
+int dw1000_model_transfer_done(int wait)
+{
+    if (!dw.xfer_pending) {
+        return 1;
+    }
+
+    if (now_ps() < dw.xfer_end) {
+        if (!wait) {
+            return 0;
+        }
+        while (now_ps() < dw.xfer_end) {
+        }
+    }
+
+    dw.xfer_pending = 0;
+    spi_execute(dw.xfer_header, dw.xfer_headerLength, dw.xfer_body, dw.xfer_bodyLength);
+
+    return 1;
+}
+
+int dw1000_model_irq(void)
+{
+    if (!dw.ready || dw.sleeping) {
+        return 0;
+    }
+
+    advance(now_ps());
+
+    return (reg_get(SYS_STATUS_ID, 0, 4) & reg_get(SYS_MASK_ID, 0, 4) & ~SYS_STATUS_IRQS) ? 1 : 0;
+}
@@ -0,0 +1,147 @@
+/*! ----------------------------------------------------------------------------
+ * @file    dw1000_model.h
+ * @brief   Host-side model of the DW1000 register file and radio
+ *
+ * This file only uses the host C library (no Zephyr header) so that it can
+ * be built as a native_posix "bottom" file, or in a plain Linux program.
+ *
+ * The model answers the SPI transactions issued by the driver as a DW1000
+ * would: register files are plain memory, except for the registers with a
+ * side effect (SYS_CTRL commands, SYS_STATUS write-1-to-clear, SYS_TIME,
+ * soft reset, sleep). Frames are exchanged between the processes running a
+ * model through UDP datagrams on the loopback interface, timestamps are
+ * derived from CLOCK_MONOTONIC, which all processes on the host share.
+ *
+ * Environment variables (all optional):
+ *  DW1000_SIM_PORT     UDP port of the simulated air (default 47000)
+ *  DW1000_SIM_POS      position of this device in metres, "x,y,z"
+ *  DW1000_SIM_PPM      crystal offset of this device in ppm (default random
+ *                      within +/-10)
+ *  DW1000_SIM_EUI      EUI-64 of this device, hexadecimal (default from pid)
+ *  DW1000_SIM_LOSS     frame loss probability, 0.0 to 1.0 (default 0)
+ *  DW1000_SIM_NOISE_PS standard deviation of the RX timestamp noise in ps
+ *                      (default 0)
+ *  DW1000_SIM_SPI_TIME when set to 1, each SPI transaction takes its real
+ *                      bus time (busy wait) at the configured SPI rate, and
+ *                      the asynchronous ones are in flight for that time
+ *  DW1000_SIM_SPI_CALL_US  time taken by the SPI driver for each call of the
+ *                      SPI backend (lock, configuration), in us, added to
+ *                      the bus time (default 0)
+ */
+
+#ifndef _DW1000_MODEL_H_
+#define _DW1000_MODEL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: dw1000_model_init()
+ *
+ * Opens the simulated air and puts the model in its power-on state. Called
+ * by openspi(), subsequent calls do nothing.
+ * returns 0 for success, or -1 for error
+ */
+int dw1000_model_init(void);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: dw1000_model_reset()
+ *
+ * Hard reset (RSTn pin): all registers back to their default values.
+ */
+void dw1000_model_reset(void);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: dw1000_model_wakeup()
+ *
+ * Wakes the device up from sleep (WAKEUP pin).
+ */
+void dw1000_model_wakeup(void);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: dw1000_model_set_spi_rate()
+ *
+ * Sets the SPI clock rate used for the bus time accounting.
+ */
+void dw1000_model_set_spi_rate(uint32_t hz);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: dw1000_model_transfer()
+ *
+ * Executes one SPI transaction: the DW1000 header (1 to 3 bytes, which
+ * gives the direction, register file and sub-index) followed by the body,
+ * which is written to the device or filled with the read data.
+ */
+void dw1000_model_transfer(const uint8_t *header, uint16_t headerLength,
+                           uint8_t *body, uint32_t bodyLength);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: dw1000_model_transfer_start()
+ *
+ * Starts one SPI transaction as dw1000_model_transfer() without waiting for
+ * it: the device only answers, and the body is only written or read, when
+ * dw1000_model_transfer_done() finds it complete, after its bus time with
+ * DW1000_SIM_SPI_TIME, at once otherwise. The body must stay valid until
+ * then. A transaction started while one is in flight waits for its end.
+ */
+void dw1000_model_transfer_start(const uint8_t *header, uint16_t headerLength,
+                                 uint8_t *body, uint32_t bodyLength);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: dw1000_model_transfer_done()
+ *
+ * Completes the transaction started by dw1000_model_transfer_start() if its
+ * bus time is over, or waits for it if wait is not 0.
+ * returns 1 if no transaction is in flight any more, 0 if it still is
+ */
+int dw1000_model_transfer_done(int wait);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: dw1000_model_host_ns()
+ *
+ * returns the host CLOCK_MONOTONIC in ns, to time code on native_posix,
+ * where the Zephyr clocks stand still while it runs
+ */
+uint64_t dw1000_model_host_ns(void);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: dw1000_model_spi_call()
+ *
+ * Accounts for one call of the SPI backend, which issues one or more
+ * transactions: DW1000_SIM_SPI_CALL_US of driver time, busy waited with
+ * DW1000_SIM_SPI_TIME.
+ */
+void dw1000_model_spi_call(void);
+
+/* SPI counters of the model since it was opened */
+typedef struct {
+    uint64_t    calls;          /* calls of the SPI backend                 */
+    uint64_t    count;          /* transactions                             */
+    uint64_t    bytes;          /* header and body bytes                    */
+    double      busy_us;        /* bus time at the configured SPI rates     */
+} dw1000_model_spi_stats_t;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: dw1000_model_spi_stats()
+ *
+ * Copies the SPI counters, which are also printed when the process exits.
+ */
+void dw1000_model_spi_stats(dw1000_model_spi_stats_t *stats);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * Function: dw1000_model_irq()
+ *
+ * Brings the model up to date with the current time (frames received,
+ * transmissions completed, timeouts) and returns the level of the IRQ line,
+ * i.e. 1 if any event enabled in SYS_MASK is set in SYS_STATUS.
+ */
+int dw1000_model_irq(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DW1000_MODEL_H_ */
@@ -0,0 +1,325 @@
+/*! ----------------------------------------------------------------------------
+ * @file    port_sim.c
+ * @brief   HW specific definitions and functions for portability,
+ *          native_posix implementation
+ *
+ * The DW1000 is the host-side model (dw1000_model.c). Its IRQ line is
+ * polled by a thread which calls the installed handler on each rising edge,
+ * like the GPIO interrupt of the DWM1001.
+ */
+
+#include "port.h"
+#include "deca_device_api.h"
+#include "deca_spi.h"
+#include "dw1000_model.h"
+
+#include <zephyr.h>
+#include <sys/printk.h>
+
+#ifndef DW1000_SIM_IRQ_POLL_US
+#define DW1000_SIM_IRQ_POLL_US      (100)   /* IRQ line polling period */
+#endif
+
+static port_deca_isr_t deca_isr;
+static volatile bool   irq_enabled = true;
+
+static uint32_t irq_latency [DECA_IRQ_STATS_LEN];  /* in hardware cycles */
+static uint32_t irq_latency_sorted [DECA_IRQ_STATS_LEN];  /* guarded by irq_stats_mutex */
+K_MUTEX_DEFINE(irq_stats_mutex);
+static uint32_t irq_latency_count;
+static uint32_t irq_latency_max;
+
+/****************************************************************************//**
+ *
+ *                              Time section
+ *
+ *******************************************************************************/
+
+/* @fn    portGetTickCnt
+ * @brief wrapper for to read a SysTickTimer, which is incremented with
+ *        CLOCKS_PER_SEC frequency.
+ * */
+unsigned long
+portGetTickCnt(void)
+{
+    return (unsigned long)k_uptime_get_32();
+}
+
+/* @fn    usleep
+ * @brief usleep() delay
+ * */
+int usleep(unsigned long usec)
+{
+    k_busy_wait(usec);
+    return 0;
+}
+
+/* @fn    Sleep
+ * @brief Sleep delay in ms
+ * */
+void Sleep(uint32_t x)
+{
+    k_msleep(x);
+}
+
+/****************************************************************************//**
+ *
+ *                              Configuration section
+ *
+ *******************************************************************************/
+
+/* @fn    peripherals_init
+ * */
+int peripherals_init (void)
+{
+    return 0;
+}
+
+/* @fn    spi_peripheral_init
+ * */
+void spi_peripheral_init()
+{
+    openspi();
+}
+
+/****************************************************************************//**
+ *
+ *                          DW1000 port section
+ *
+ *******************************************************************************/
+
+/* @fn      reset_DW1000
+ * @brief   hard reset of the DW1000 model
+ * */
+void reset_DW1000(void)
+{
+    dw1000_model_reset();
+
+    Sleep(2);
+}
+
+/* @fn      setup_DW1000RSTnIRQ
+ * */
+void setup_DW1000RSTnIRQ(int enable)
+{
+}
+
+/* @fn      led_off
+ * */
+void led_off (led_t led)
+{
+}
+
+/* @fn      led_on
+ * */
+void led_on (led_t led)
+{
+}
+
+/* @fn      port_wakeup_dw1000
+ * @brief   waking up of the DW1000 model
+ * */
+void port_wakeup_dw1000(void)
+{
+    dw1000_model_wakeup();
+}
+
+/* @fn      port_wakeup_dw1000_fast
+ * @brief   waking up of the DW1000 model
+ * */
+void port_wakeup_dw1000_fast(void)
+{
+    dw1000_model_wakeup();
+}
+
+/* @fn      port_set_dw1000_slowrate
+ * @brief   set 2MHz
+ * */
+void port_set_dw1000_slowrate(void)
+{
+    set_spi_speed_slow();
+}
+
+/* @fn      port_set_dw1000_fastrate
+ * @brief   set 8MHz, or the rate found by port_set_dw1000_maxrate()
+ * */
+void port_set_dw1000_fastrate(void)
+{
+    set_spi_speed_fast();
+}
+
+/* @fn      port_set_dw1000_maxrate
+ * @brief   set the fastest rate the model accepts
+ * */
+void port_set_dw1000_maxrate(void)
+{
+    static bool negotiated;
+
+    if (!negotiated) {
+        negotiated = (set_spi_speed_negotiate(NULL) != 0);
+    }
+    set_spi_speed_fast();
+}
+
+/****************************************************************************//**
+ *
+ *                              IRQ section
+ *
+ *******************************************************************************/
+
+/* @fn      process_deca_irq
+ * @brief   main call-back for processing of DW1000 IRQ
+ * */
+void process_deca_irq(void)
+{
+    int calls = 0;
+
+    if (!deca_isr) {
+        return;
+    }
+
+    do {
+        deca_isr();
+    } while (dw1000_model_irq() && (++calls < DECA_IRQ_REENTRY_MAX));
+}
+
+/* @fn      port_DisableEXT_IRQ
+ * @brief   wrapper to disable DW_IRQ pin IRQ
+ * */
+void port_DisableEXT_IRQ(void)
+{
+    irq_enabled = false;
+}
+
+/* @fn      port_EnableEXT_IRQ
+ * @brief   wrapper to enable DW_IRQ pin IRQ
+ * */
+void port_EnableEXT_IRQ(void)
+{
+    irq_enabled = true;
+}
+
+/* @fn      port_GetEXT_IRQStatus
+ * @brief   wrapper to read a DW_IRQ pin IRQ status
+ * */
+uint32_t port_GetEXT_IRQStatus(void)
+{
+    return irq_enabled ? 1 : 0;
+}
+
+/* @fn      port_CheckEXT_IRQ
+ * @brief   wrapper to read DW_IRQ input pin state
+ * */
+uint32_t port_CheckEXT_IRQ(void)
+{
+    return (uint32_t)dw1000_model_irq();
+}
+
+/*! ---------------------------------------------------------------------------
+ * @fn port_set_deca_isr()
+ *
+ * @brief This function is used to install the handling function for DW1000 IRQ.
+ *
+ * @param deca_isr function pointer to DW1000 interrupt handler to install
+ *
+ * @return none
+ */
+void port_set_deca_isr(port_deca_isr_t isr)
+{
+    printk("%s: DW1000 model IRQ line\n", __func__);
+
+    deca_isr = isr;
+}
+
+/*
+ * IRQ line of the model, edge triggered like the GPIO interrupt: an edge
+ * seen while the IRQ is disabled is latched and serviced when it is
+ * enabled again. The latency is counted from the edge detection.
+ */
+static void irq_thread(void * id, void * unused1, void * unused2)
+{
+    bool     level = false;
+    bool     pending = false;
+    uint32_t edge_time = 0;
+
+    while (1) {
+        bool line;
+
+        k_usleep(DW1000_SIM_IRQ_POLL_US);
+
+        line = dw1000_model_irq();
+        if (line && !level && !pending) {
+            pending = true;
+            edge_time = k_cycle_get_32();
+        }
+        level = line;
+
+        if (pending && irq_enabled && deca_isr) {
+            unsigned int key;
+            uint32_t     latency;
+
+            pending = false;
+
+            key = irq_lock();
+            latency = k_cycle_get_32() - edge_time;
+            irq_latency[irq_latency_count % DECA_IRQ_STATS_LEN] = latency;
+            irq_latency_count++;
+            if (latency > irq_latency_max) {
+                irq_latency_max = latency;
+            }
+            irq_unlock(key);
+
+            process_deca_irq();
+            level = dw1000_model_irq();
+        }
+    }
+}
+
+K_THREAD_DEFINE(dw1000_irq_id, DECA_IRQ_THREAD_STACKSIZE, irq_thread,
+                NULL, NULL, NULL, DECA_IRQ_THREAD_PRIORITY, 0, 0);
+
+/* @fn      port_set_deca_irq_priority
+ * @brief   changes the priority of the IRQ line thread
+ * */
+void port_set_deca_irq_priority(int prio)
+{
+    k_thread_priority_set(dw1000_irq_id, prio);
+}
+
+/* @fn      port_deca_irq_stats
+ * @brief   reads the IRQ edge to handler latency statistics, in us
+ * */
+void port_deca_irq_stats(uint32_t * p50, uint32_t * p99, uint32_t * max,
+                         uint32_t * count, int reset)
+{
+    unsigned int key;
+    uint32_t     n;
+
+    /* The sort runs outside of irq_lock(), on a buffer shared by the callers */
+    k_mutex_lock(&irq_stats_mutex, K_FOREVER);
+    key = irq_lock();
+    n = MIN(irq_latency_count, DECA_IRQ_STATS_LEN);
+    memcpy(irq_latency_sorted, irq_latency, n * sizeof(irq_latency[0]));
+    *max = k_cyc_to_us_ceil32(irq_latency_max);
+    *count = irq_latency_count;
+    if (reset) {
+        irq_latency_count = 0;
+        irq_latency_max = 0;
+    }
+    irq_unlock(key);
+
+    for (uint32_t i = 1; i < n; i++) {
+        uint32_t v = irq_latency_sorted[i];
+        uint32_t j = i;
+
+        while ((j > 0) && (irq_latency_sorted[j - 1] > v)) {
+            irq_latency_sorted[j] = irq_latency_sorted[j - 1];
+            j--;
+        }
+        irq_latency_sorted[j] = v;
+    }
+
+    *p50 = n ? k_cyc_to_us_ceil32(irq_latency_sorted[(n - 1) / 2]) : 0;
+    *p99 = n ? k_cyc_to_us_ceil32(irq_latency_sorted[((n - 1) * 99) / 100]) : 0;
+    k_mutex_unlock(&irq_stats_mutex);
+}